@@ -1,9 +1,44 @@
 #include "ast.h"
 
+#include <algorithm>
 #include <iostream>
 
 namespace ast {
 
+namespace {
+
+nlohmann::json atoms_to_json(const std::vector<atom::Atom> &atoms) {
+    std::vector<std::string> names;
+    for (auto a: atoms) {
+        names.push_back(atom::to_string(a));
+    }
+    return names;
+}
+
+}
+
+void* Arena::allocate(size_t size, size_t alignment) {
+    auto aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(next) + alignment - 1) & ~(alignment - 1));
+
+    if (next == nullptr || aligned + size > end) {
+        // anything bigger than a block gets a block of its own
+        auto capacity = std::max(block_size, size + alignment);
+        blocks.emplace_back(new char[capacity]);
+        next = blocks.back().get();
+        end = next + capacity;
+        aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(next) + alignment - 1) & ~(alignment - 1));
+    }
+
+    next = aligned + size;
+    return aligned;
+}
+
+Arena::~Arena() {
+    for (auto d = destructors.rbegin(); d != destructors.rend(); d++) {
+        d->destroy(d->object);
+    }
+}
+
 std::string operator_to_string(Operator op) {
     switch (op) {
         case Operator::Plus:
@@ -153,13 +188,18 @@ bool token_type_is_operator(lexer::TokenType token_type) {
     }
 }
 
-VariableType get_variable_type(std::string type) {
-    if (type == "var") return VariableType::Var;
-    if (type == "let") return VariableType::Let;
-    if (type == "const") return VariableType::Const;
-
-    std::cerr << "invalid variable type " << type << "\n";
-    assert(false);
+VariableType get_variable_type(lexer::Keyword keyword) {
+    switch (keyword) {
+        case lexer::Keyword::Var:
+            return VariableType::Var;
+        case lexer::Keyword::Let:
+            return VariableType::Let;
+        case lexer::Keyword::Const:
+            return VariableType::Const;
+        default:
+            std::cerr << "invalid variable type keyword\n";
+            assert(false);
+    }
 }
 
 template<typename T>
@@ -307,6 +347,11 @@ TryCatchStatement* Statement::as_trycatch() {
     return as<TryCatchStatement>();
 }
 
+LazyBlockStatement* Statement::as_lazy_block() {
+    assert(type == StatementType::LazyBlock);
+    return as<LazyBlockStatement>();
+}
+
 nlohmann::json ExpressionStatement::to_json() {
     nlohmann::json j;
     j["type"] = "ExpressionStatement";
@@ -327,13 +372,25 @@ nlohmann::json BlockStatement::to_json() {
     return j;
 }
 
+nlohmann::json LazyBlockStatement::to_json() {
+    if (block != nullptr) {
+        return block->to_json();
+    }
+
+    nlohmann::json j;
+    j["type"] = "LazyBlockStatement";
+    j["begin"] = begin;
+    j["end"] = end;
+    return j;
+}
+
 nlohmann::json IfStatement::to_json() {
     nlohmann::json j;
     j["type"] = "IfStatement";
     j["test"] = test->to_json();
     j["consequent"] = consequent->to_json();
-    if (alternative.has_value()) {
-        j["alternative"] = alternative.value()->to_json();
+    if (alternative != nullptr) {
+        j["alternative"] = alternative->to_json();
     } else {
         j["alternative"] = nullptr;
     }
@@ -353,8 +410,8 @@ nlohmann::json ForStatement::to_json() {
 nlohmann::json ReturnStatement::to_json() {
     nlohmann::json j;
     j["type"] = "ReturnStatement";
-    if (argument.has_value()) {
-        j["argument"] = argument.value()->to_json();
+    if (argument != nullptr) {
+        j["argument"] = argument->to_json();
     } else {
         j["argument"] = nullptr;
     }
@@ -364,8 +421,8 @@ nlohmann::json ReturnStatement::to_json() {
 nlohmann::json FunctionDeclarationStatement::to_json() {
     nlohmann::json j;
     j["type"] = "FunctionDeclarationStatement";
-    j["parameters"] = parameters;
-    j["identifier"] = identifier;
+    j["parameters"] = atoms_to_json(parameters);
+    j["identifier"] = atom::to_string(identifier);
     j["body"] = body->to_json();
     return j;
 }
@@ -385,12 +442,24 @@ nlohmann::json ThrowStatement::to_json() {
     return j;
 }
 
+nlohmann::json BreakStatement::to_json() {
+    nlohmann::json j;
+    j["type"] = "BreakStatement";
+    return j;
+}
+
+nlohmann::json ContinueStatement::to_json() {
+    nlohmann::json j;
+    j["type"] = "ContinueStatement";
+    return j;
+}
+
 nlohmann::json TryCatchStatement::to_json() {
     nlohmann::json j;
     j["type"] = "TryCatchStatement";
     j["try_body"] = try_body->to_json();
     j["catch_body"] = catch_body->to_json();
-    j["catch_identifier"] = catch_identifier;
+    j["catch_identifier"] = atom::to_string(catch_identifier);
     return j;
 }
 
@@ -421,7 +490,7 @@ nlohmann::json MemberExpression::to_json() {
 nlohmann::json IdentifierExpression::to_json() {
     nlohmann::json j;
     j["type"] = "IdentifierExpression";
-    j["name"] = name;
+    j["name"] = atom::to_string(name);
     return j;
 }
 
@@ -490,9 +559,9 @@ nlohmann::json AssignmentExpression::to_json() {
 nlohmann::json VariableDeclarationExpression::to_json() {
     nlohmann::json j;
     j["type"] = "VariableDeclarationExpression";
-    j["identifiers"] = identifiers;
-    if (value.has_value()) {
-        j["value"] = value.value()->to_json();
+    j["identifiers"] = atoms_to_json(identifiers);
+    if (value != nullptr) {
+        j["value"] = value->to_json();
     } else {
         j["value"] = nullptr;
     }
@@ -506,7 +575,7 @@ nlohmann::json ObjectExpression::to_json() {
     j["properties"] = nlohmann::json();
 
     for (auto p: properties) {
-        j["properties"][p.first] = p.second->to_json();
+        j["properties"][atom::to_string(p.first)] = p.second->to_json();
     }
 
     return j;
@@ -539,9 +608,9 @@ nlohmann::json TernaryExpression::to_json() {
 nlohmann::json FunctionExpression::to_json() {
     nlohmann::json j;
     j["type"] = "FunctionExpression";
-    j["parameters"] = parameters;
+    j["parameters"] = atoms_to_json(parameters);
     if (identifier.has_value()) {
-        j["identifier"] = identifier.value();
+        j["identifier"] = atom::to_string(identifier.value());
     }
     j["body"] = body->to_json();
     return j;
@@ -550,7 +619,7 @@ nlohmann::json FunctionExpression::to_json() {
 nlohmann::json ArrowFunctionExpression::to_json() {
     nlohmann::json j;
     j["type"] = "ArrowFunctionExpression";
-    j["parameters"] = parameters;
+    j["parameters"] = atoms_to_json(parameters);
     j["body"] = body->to_json();
     return j;
 }
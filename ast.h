@@ -3,7 +3,11 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <optional>
+#include <memory>
+#include <type_traits>
 
+#include "atom.h"
 #include "lexer.h"
 #include "json.hpp"
 
@@ -40,7 +44,7 @@ namespace ast {
 
 #define CREATE_ENUM(NAME) NAME,
 
-enum class Operator {
+enum class Operator : uint8_t {
     OPERATORS(CREATE_ENUM)
 };
 
@@ -54,7 +58,7 @@ enum class VariableType {
     Const
 };
 
-VariableType get_variable_type(std::string type);
+VariableType get_variable_type(lexer::Keyword keyword);
 
 #define EXPRESSIONS(MAP) \
     MAP(VariableDeclaration) \
@@ -86,7 +90,10 @@ VariableType get_variable_type(std::string type);
     MAP(For) \
     MAP(Return) \
     MAP(Throw) \
-    MAP(TryCatch)
+    MAP(TryCatch) \
+    MAP(Break) \
+    MAP(Continue) \
+    MAP(LazyBlock)
 
 enum class ExpressionType {
     EXPRESSIONS(CREATE_ENUM)
@@ -106,6 +113,73 @@ STATEMENTS(FORWARD_DECLARE_STATEMENT)
 EXPRESSIONS(FORWARD_DECLARE_EXPRESSION)
 #undef FORWARD_DECLARE_EXPRESSION
 
+// where a variable lives, filled in by the resolver. Global variables are
+// properties of the global object found by name, Local ones are a slot in the
+// frame of the function they are used in. Captured variables are used by
+// functions created in the one that declares them, they are a slot in the
+// environment `hops` environments out from the innermost one, which is that of
+// the block running, the current frame's own or the one its function was
+// created in
+struct Binding {
+    enum class Kind : uint8_t {
+        Global,
+        Local,
+        Captured
+    };
+
+    Kind kind = Kind::Global;
+    uint16_t hops = 0;
+    uint32_t slot = 0;
+};
+
+struct Scope;
+
+// a variable of a frame, whether it is captured and so where its slot is is
+// only known once the whole function has been resolved
+struct Variable {
+    bool captured = false;
+    uint32_t slot = 0;
+    // the block that declares a let or const, a captured one is in the block's
+    // environment rather than the frame's
+    Scope* block = nullptr;
+};
+
+// the variables declared by a function, the top level, a block or a catch
+// clause. variables at the top level are globals, so only catch clauses and
+// blocks add variables to the top level frame. catch clauses and blocks have
+// no frame of their own and add variables to the function around them. the
+// let and const of a block that are captured go in an environment the block
+// gets each time it runs, at the top level they all do
+struct Scope {
+    enum class Kind : uint8_t {
+        TopLevel,
+        Function,
+        Catch,
+        Block
+    };
+
+    Scope(Kind kind, Scope* parent) : kind(kind), parent(parent) {}
+
+    Kind kind;
+    Scope* parent;
+    // names declared in this scope and their index in the variables of its frame
+    std::unordered_map<atom::Atom, uint32_t> names;
+    // the variables of a function or the top level, including those of the
+    // catch clauses and blocks in it
+    std::vector<Variable> variables;
+    // the variable of each parameter
+    std::vector<uint32_t> parameters;
+    // a call has frame_size slots on the frame stack for the variables that
+    // are not captured and an environment of environment_size slots for those
+    // that are, the top level frame is all environment
+    uint32_t frame_size = 0;
+    uint32_t environment_size = 0;
+    std::optional<uint32_t> arguments_slot;
+    // whether functions are created in a block, a for loop then gives each
+    // iteration a copy of its environment for them to keep
+    bool closures = false;
+};
+
 enum class ASTNodeType {
     Statement,
     Expression
@@ -135,6 +209,7 @@ struct Statement : ASTNode {
     ReturnStatement* as_return();
     ThrowStatement* as_throw();
     TryCatchStatement* as_trycatch();
+    LazyBlockStatement* as_lazy_block();
 };
 
 struct Expression : ASTNode {
@@ -164,120 +239,166 @@ struct Expression : ASTNode {
 };
 
 struct ExpressionStatement : public Statement {
-    ExpressionStatement(std::shared_ptr<Expression> expression)
+    ExpressionStatement(Expression* expression)
             : Statement(StatementType::Expression), expression(expression) {}
-    std::shared_ptr<Expression> expression;
+    Expression* expression;
     nlohmann::json to_json() override;
 };
 
 struct BlockStatement : public Statement {
-    BlockStatement(std::vector<std::shared_ptr<Statement>> body)
+    BlockStatement(std::vector<Statement*> body)
             : Statement(StatementType::Block), body(body) {}
-    std::vector<std::shared_ptr<Statement>> body;
+    std::vector<Statement*> body;
+    // set by the resolver, null for the body of a function
+    Scope* scope = nullptr;
     nlohmann::json to_json() override;
 };
 
 struct IfStatement : public Statement {
-    IfStatement(std::shared_ptr<Expression> test,
-                std::shared_ptr<Statement> consequent,
-                std::optional<std::shared_ptr<ast::Statement>> alternative)
+    IfStatement(Expression* test,
+                Statement* consequent,
+                ast::Statement* alternative)
             : Statement(StatementType::If), test(test), consequent(consequent), alternative(alternative) {}
-    std::shared_ptr<Expression> test;
-    std::shared_ptr<Statement> consequent;
-    std::optional<std::shared_ptr<ast::Statement>> alternative;
+    Expression* test;
+    Statement* consequent;
+    ast::Statement* alternative;
     nlohmann::json to_json() override;
 };
 
 struct ForStatement : public Statement {
-    ForStatement(std::shared_ptr<Expression> init, std::shared_ptr<Expression> test, std::shared_ptr<Expression> update,
-                 std::shared_ptr<Statement> body)
+    ForStatement(Expression* init, Expression* test, Expression* update,
+                 Statement* body)
             : Statement(StatementType::For), init(init), test(test), update(update), body(body) {}
-    std::shared_ptr<Expression> init;
-    std::shared_ptr<Expression> test;
-    std::shared_ptr<Expression> update;
-    std::shared_ptr<Statement> body;
+    Expression* init;
+    Expression* test;
+    Expression* update;
+    Statement* body;
+    // where the variables declared in init are, set by the resolver
+    Scope* scope = nullptr;
     nlohmann::json to_json() override;
 };
 
 struct ReturnStatement : public Statement {
-    ReturnStatement() : Statement(StatementType::Return), argument({}) {}
-    ReturnStatement(std::optional<std::shared_ptr<Expression>> argument) :
+    ReturnStatement() : Statement(StatementType::Return), argument(nullptr) {}
+    ReturnStatement(Expression* argument) :
             Statement(StatementType::Return), argument(argument) {}
-    std::optional<std::shared_ptr<Expression>> argument;
+    Expression* argument;
     nlohmann::json to_json() override;
 };
 
 struct FunctionDeclarationStatement : public Statement {
-    FunctionDeclarationStatement(std::string identifier, std::vector<std::string> parameters,
-                                 std::shared_ptr<Statement> body)
+    FunctionDeclarationStatement(atom::Atom identifier, std::vector<atom::Atom> parameters,
+                                 Statement* body)
             : Statement(StatementType::FunctionDeclaration), identifier(identifier), parameters(parameters),
               body(body) {}
-    std::string identifier;
-    std::vector<std::string> parameters;
-    std::shared_ptr<Statement> body;
+    atom::Atom identifier;
+    Binding binding;
+    std::vector<atom::Atom> parameters;
+    Statement* body;
+    Scope* scope = nullptr;
     nlohmann::json to_json() override;
 };
 
 struct WhileStatement : public Statement {
-    WhileStatement(std::shared_ptr<Expression> test, std::shared_ptr<Statement> body)
+    WhileStatement(Expression* test, Statement* body)
             : Statement(StatementType::While), test(test), body(body) {}
-    std::shared_ptr<Expression> test;
-    std::shared_ptr<Statement> body;
+    Expression* test;
+    Statement* body;
     nlohmann::json to_json() override;
 };
 
 struct ThrowStatement : public Statement {
-    ThrowStatement(std::shared_ptr<Expression> argument)
+    ThrowStatement(Expression* argument)
             : Statement(StatementType::Throw), argument(argument) {}
-    std::shared_ptr<Expression> argument;
+    Expression* argument;
+    nlohmann::json to_json() override;
+};
+
+// without labels, they end or continue the innermost loop
+struct BreakStatement : public Statement {
+    BreakStatement() : Statement(StatementType::Break) {}
+    nlohmann::json to_json() override;
+};
+
+struct ContinueStatement : public Statement {
+    ContinueStatement() : Statement(StatementType::Continue) {}
     nlohmann::json to_json() override;
 };
 
 struct TryCatchStatement : public Statement {
-    TryCatchStatement(std::shared_ptr<Statement> try_body, std::string catch_identifier,
-                      std::shared_ptr<Statement> catch_body)
+    TryCatchStatement(Statement* try_body, atom::Atom catch_identifier,
+                      Statement* catch_body)
             :
             Statement(StatementType::TryCatch),
             try_body(try_body),
             catch_identifier(catch_identifier),
             catch_body(catch_body) {}
-    std::shared_ptr<Statement> try_body;
-    std::string catch_identifier;
-    std::shared_ptr<Statement> catch_body;
+    Statement* try_body;
+    atom::Atom catch_identifier;
+    Binding catch_binding;
+    Statement* catch_body;
+    nlohmann::json to_json() override;
+};
+
+// a function body the parser only checked the brackets of, `begin` and `end`
+// are the offsets of its braces in `source`. it is parsed into `block` the
+// first time the function is called
+struct LazyBlockStatement : public Statement {
+    LazyBlockStatement(std::string_view source, std::string_view name, lexer::Lexer::Mode mode,
+                       uint32_t begin, uint32_t end)
+            : Statement(StatementType::LazyBlock), source(source), name(name), mode(mode), begin(begin), end(end) {}
+    std::string_view source;
+    std::string_view name;
+    lexer::Lexer::Mode mode;
+    uint32_t begin;
+    uint32_t end;
+    // every name the body uses, functions around it keep any of their
+    // variables with one of these names in their environments
+    std::vector<atom::Atom> names;
+    // names used after a dot and the contents of strings, they are not
+    // variables but can still reach a global through an object
+    std::vector<atom::Atom> properties;
+    // names next to an assignment or an update, the folder does not propagate
+    // a const that the body could assign to
+    std::vector<atom::Atom> assigned;
+    BlockStatement* block = nullptr;
     nlohmann::json to_json() override;
 };
 
 struct CallExpression : public Expression {
-    CallExpression(std::shared_ptr<Expression> callee)
+    CallExpression(Expression* callee)
             : Expression(ExpressionType::Call), callee(callee) {}
-    std::shared_ptr<Expression> callee;
-    std::vector<std::shared_ptr<Expression>> arguments;
+    Expression* callee;
+    std::vector<Expression*> arguments;
     nlohmann::json to_json() override;
 };
 
 struct VariableDeclarationExpression : public Expression {
-    VariableDeclarationExpression(std::vector<std::string> identifiers,
-                                  std::optional<std::shared_ptr<Expression>> value,
+    VariableDeclarationExpression(std::vector<atom::Atom> identifiers,
+                                  Expression* value,
                                   VariableType type)
-            : Expression(ExpressionType::VariableDeclaration), identifiers(identifiers), value(value), type(type) {}
-    std::vector<std::string> identifiers;
-    std::optional<std::shared_ptr<Expression>> value;
+            : Expression(ExpressionType::VariableDeclaration), identifiers(identifiers), bindings(identifiers.size()),
+              value(value), type(type) {}
+    std::vector<atom::Atom> identifiers;
+    std::vector<Binding> bindings;
+    Expression* value;
     VariableType type;
     nlohmann::json to_json() override;
 };
 
 struct MemberExpression : public Expression {
-    MemberExpression(std::shared_ptr<Expression> object, std::shared_ptr<Expression> property, bool is_computed) :
+    MemberExpression(Expression* object, Expression* property, bool is_computed) :
             Expression(ExpressionType::Member), object(object), property(property), is_computed(is_computed) {}
-    std::shared_ptr<Expression> object;
-    std::shared_ptr<Expression> property;
+    Expression* object;
+    Expression* property;
     bool is_computed;
     nlohmann::json to_json() override;
 };
 
 struct IdentifierExpression : public Expression {
-    IdentifierExpression(std::string name) : Expression(ExpressionType::Identifier), name(name) {}
-    std::string name;
+    IdentifierExpression(atom::Atom name) : Expression(ExpressionType::Identifier), name(name) {}
+    atom::Atom name;
+    Binding binding;
     nlohmann::json to_json() override;
 };
 
@@ -305,80 +426,82 @@ struct NullLiteralExpression : public Expression {
 };
 
 struct BinaryExpression : public Expression {
-    BinaryExpression(std::shared_ptr<Expression> left, std::shared_ptr<Expression> right, Operator op)
+    BinaryExpression(Expression* left, Expression* right, Operator op)
             : Expression(ExpressionType::Binary), left(left), right(right), op(op) {}
-    std::shared_ptr<Expression> left;
-    std::shared_ptr<Expression> right;
+    Expression* left;
+    Expression* right;
     Operator op;
     nlohmann::json to_json() override;
 };
 
 struct UnaryExpression : public Expression {
-    UnaryExpression(std::shared_ptr<Expression> argument, Operator op)
+    UnaryExpression(Expression* argument, Operator op)
             : Expression(ExpressionType::Unary), argument(argument), op(op) {}
-    std::shared_ptr<Expression> argument;
+    Expression* argument;
     Operator op;
     nlohmann::json to_json() override;
 };
 
 struct UpdateExpression : public Expression {
-    UpdateExpression(std::shared_ptr<Expression> argument, Operator op, bool is_prefix)
+    UpdateExpression(Expression* argument, Operator op, bool is_prefix)
             : Expression(ExpressionType::Update), argument(argument), op(op), is_prefix(is_prefix) {}
-    std::shared_ptr<Expression> argument;
+    Expression* argument;
     Operator op;
     bool is_prefix;
     nlohmann::json to_json() override;
 };
 
 struct AssignmentExpression : public Expression {
-    AssignmentExpression(std::shared_ptr<Expression> left, std::shared_ptr<Expression> right, Operator op)
+    AssignmentExpression(Expression* left, Expression* right, Operator op)
             : Expression(ExpressionType::Assignment), left(left), right(right), op(op) {}
-    std::shared_ptr<Expression> left;
-    std::shared_ptr<Expression> right;
+    Expression* left;
+    Expression* right;
     Operator op;
     nlohmann::json to_json() override;
 };
 
 struct ObjectExpression : public Expression {
     ObjectExpression() : Expression(ExpressionType::Object) {}
-    std::unordered_map<std::string, std::shared_ptr<Expression>> properties;
+    std::unordered_map<atom::Atom, Expression*> properties;
     nlohmann::json to_json() override;
 };
 
 struct ArrayExpression : public Expression {
     ArrayExpression() : Expression(ExpressionType::Array) {}
-    std::vector<std::shared_ptr<Expression>> elements;
+    std::vector<Expression*> elements;
     nlohmann::json to_json() override;
 };
 
 struct TernaryExpression : public Expression {
-    TernaryExpression(std::shared_ptr<Expression> test, std::shared_ptr<Expression> consequent,
-                      std::shared_ptr<Expression> alternative)
+    TernaryExpression(Expression* test, Expression* consequent,
+                      Expression* alternative)
             : Expression(ExpressionType::Ternary), test(test), consequent(consequent), alternative(alternative) {}
-    std::shared_ptr<Expression> test;
-    std::shared_ptr<Expression> consequent;
-    std::shared_ptr<Expression> alternative;
+    Expression* test;
+    Expression* consequent;
+    Expression* alternative;
     nlohmann::json to_json() override;
 };
 
 struct FunctionExpression : public Expression {
-    FunctionExpression(std::optional<std::string> identifier, std::vector<std::string> parameters,
-                       std::shared_ptr<Statement> body)
+    FunctionExpression(std::optional<atom::Atom> identifier, std::vector<atom::Atom> parameters,
+                       Statement* body)
             : Expression(ExpressionType::Function), identifier(identifier), parameters(parameters),
               body(body) {}
-    std::optional<std::string> identifier;
-    std::vector<std::string> parameters;
-    std::shared_ptr<Statement> body;
+    std::optional<atom::Atom> identifier;
+    std::vector<atom::Atom> parameters;
+    Statement* body;
+    Scope* scope = nullptr;
     nlohmann::json to_json() override;
 };
 
 struct ArrowFunctionExpression : public Expression {
-    ArrowFunctionExpression(std::vector<std::string> parameters, std::shared_ptr<ASTNode> body)
+    ArrowFunctionExpression(std::vector<atom::Atom> parameters, ASTNode* body)
             : Expression(ExpressionType::ArrowFunction),
               parameters(parameters),
               body(body) {}
-    std::vector<std::string> parameters;
-    std::shared_ptr<ASTNode> body;
+    std::vector<atom::Atom> parameters;
+    ASTNode* body;
+    Scope* scope = nullptr;
     nlohmann::json to_json() override;
 };
 
@@ -388,14 +511,52 @@ struct ThisExpression : public Expression {
 };
 
 struct NewExpression : public Expression {
-    NewExpression(std::shared_ptr<Expression> callee) : Expression(ExpressionType::New), callee(callee) {}
-    std::shared_ptr<Expression> callee;
-    std::vector<std::shared_ptr<Expression>> arguments;
+    NewExpression(Expression* callee) : Expression(ExpressionType::New), callee(callee) {}
+    Expression* callee;
+    std::vector<Expression*> arguments;
     nlohmann::json to_json() override;
 };
 
+// bump allocator the nodes of a program live in, children point straight at
+// each other and everything is freed at once with the arena
+class Arena {
+    static constexpr size_t block_size = 64 * 1024;
+
+    struct Destructor {
+        void (*destroy)(void*);
+        void* object;
+    };
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* next = nullptr;
+    char* end = nullptr;
+    // nodes with members that own memory, run in reverse when the arena goes
+    std::vector<Destructor> destructors;
+
+    void* allocate(size_t size, size_t alignment);
+
+public:
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+    ~Arena();
+
+    template<typename T, typename... Args>
+    T* make(Args &&... args) {
+        auto node = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            destructors.push_back({[](void* p) { static_cast<T*>(p)->~T(); }, node});
+        }
+
+        return node;
+    }
+};
+
 struct Program {
-    std::vector<std::shared_ptr<Statement>> body;
+    std::vector<Statement*> body;
+    // one per parsed file, a program joined from several files keeps them all
+    std::vector<std::unique_ptr<Arena>> arenas;
     nlohmann::json to_json();
 };
 
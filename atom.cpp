@@ -0,0 +1,73 @@
+#include "atom.h"
+
+#include <bit>
+#include <cassert>
+
+namespace atom {
+
+AtomTable::AtomTable() {
+#define INTERN_WELL_KNOWN(NAME, TEXT) { [[maybe_unused]] auto interned = intern(TEXT); assert(interned == NAME); }
+    WELL_KNOWN_ATOMS(INTERN_WELL_KNOWN)
+#undef INTERN_WELL_KNOWN
+}
+
+Atom AtomTable::intern(std::string_view name) {
+    std::lock_guard lock(mutex);
+
+    if (auto entry = ids.find(name); entry != ids.end()) {
+        return entry->second;
+    }
+
+    auto atom = static_cast<Atom>(count++);
+    auto [chunk, offset] = locate(atom);
+    if (offset == 0) {
+        owned[chunk] = std::make_unique<std::string[]>(size_t(FirstChunk) << chunk);
+        chunks[chunk].store(owned[chunk].get(), std::memory_order_release);
+    }
+
+    auto &stored = owned[chunk][offset];
+    stored = name;
+    ids.emplace(stored, atom);
+    return atom;
+}
+
+std::pair<uint32_t, uint32_t> AtomTable::locate(Atom atom) {
+    // with the first chunk's size added, the atoms of chunk k are exactly
+    // those with their highest bit at FirstChunkBits + k
+    auto index = uint64_t(static_cast<uint32_t>(atom)) + FirstChunk;
+    auto chunk = uint32_t(std::bit_width(index)) - FirstChunkBits - 1;
+    return {chunk, uint32_t(index - (uint64_t(FirstChunk) << chunk))};
+}
+
+const std::string &AtomTable::to_string(Atom atom) const {
+    auto [chunk, offset] = locate(atom);
+    return chunks[chunk].load(std::memory_order_acquire)[offset];
+}
+
+namespace {
+
+AtomTable &table() {
+    static AtomTable atoms;
+    return atoms;
+}
+
+}
+
+Atom intern(std::string_view name) {
+    // files are parsed on several threads, each remembers the atoms it has
+    // seen so the table lock is only taken for names new to that thread
+    thread_local std::unordered_map<std::string_view, Atom> seen;
+    if (auto entry = seen.find(name); entry != seen.end()) {
+        return entry->second;
+    }
+
+    auto atom = table().intern(name);
+    seen.emplace(table().to_string(atom), atom);
+    return atom;
+}
+
+const std::string &to_string(Atom atom) {
+    return table().to_string(atom);
+}
+
+}
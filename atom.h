@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace atom {
+
+// an atom is the id of an interned name, two atoms are equal exactly when
+// the names they were interned from are equal
+enum class Atom : uint32_t {};
+
+// names the runtime looks up itself, these are interned first so they can be
+// used as constants
+#define WELL_KNOWN_ATOMS(MAP) \
+    MAP(Proto, "__proto__") \
+    MAP(Prototype, "prototype") \
+    MAP(Constructor, "constructor") \
+    MAP(Length, "length") \
+    MAP(Arguments, "arguments") \
+    MAP(Name, "name") \
+    MAP(Message, "message") \
+    MAP(ToString, "toString") \
+    MAP(Object, "Object") \
+    MAP(String, "String") \
+    MAP(Number, "Number") \
+    MAP(Boolean, "Boolean") \
+    MAP(Array, "Array")
+
+#define CREATE_INDEX(NAME, TEXT) NAME ## Index,
+
+enum WellKnownIndex : uint32_t {
+    WELL_KNOWN_ATOMS(CREATE_INDEX)
+};
+
+#undef CREATE_INDEX
+
+#define CREATE_CONSTANT(NAME, TEXT) constexpr Atom NAME{NAME ## Index};
+WELL_KNOWN_ATOMS(CREATE_CONSTANT)
+#undef CREATE_CONSTANT
+
+class AtomTable {
+    // names are stored in chunks that are never moved or freed, chunk k holds
+    // FirstChunk << k names. a name is written once before its atom is handed
+    // out, so looking it up needs no lock. the map keys are views into them
+    static constexpr uint32_t FirstChunkBits = 6;
+    static constexpr uint32_t FirstChunk = 1u << FirstChunkBits;
+    std::array<std::atomic<std::string *>, 32 - FirstChunkBits + 1> chunks{};
+    std::array<std::unique_ptr<std::string[]>, 32 - FirstChunkBits + 1> owned;
+    uint32_t count = 0;
+    std::unordered_map<std::string_view, Atom> ids;
+    // the parser can run on its own thread while the interpreter interns
+    // computed property names
+    std::mutex mutex;
+
+    static std::pair<uint32_t, uint32_t> locate(Atom atom);
+
+public:
+    AtomTable();
+    Atom intern(std::string_view name);
+    const std::string &to_string(Atom atom) const;
+};
+
+Atom intern(std::string_view name);
+const std::string &to_string(Atom atom);
+
+}
@@ -0,0 +1,410 @@
+// front-end throughput benchmark, generates javascript corpora of increasing
+// size and reports lexer and parser throughput, peak rss and allocations as json
+//
+//   bench [--sizes=1024,1048576] [--repeat=3] [--corpus=chunks|nested] [--output=results.json]
+//
+// the nested corpus nests parentheses, arrow functions and calls deeper as the
+// corpus grows, a parser that rescans ahead shows falling throughput on it
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../ast.h"
+#include "../json.hpp"
+#include "../lexer.h"
+#include "../parser.h"
+
+namespace {
+
+std::atomic<uint64_t> allocations = 0;
+std::atomic<uint64_t> allocated_bytes = 0;
+
+}
+
+namespace {
+
+// every replaced operator new counts here, so arrays and over-aligned objects
+// are not missed
+void* allocate(std::size_t size, std::size_t alignment) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    size = size == 0 ? 1 : size;
+    // aligned_alloc wants a size that is a multiple of the alignment
+    auto p = alignment <= alignof(std::max_align_t)
+             ? std::malloc(size)
+             : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+}
+
+void* operator new(std::size_t size) {
+    return allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new[](std::size_t size) {
+    return allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+// one chunk of every construct the parser understands, `n` keeps names unique
+std::string generate_chunk(size_t n) {
+    auto id = std::to_string(n);
+    std::string out;
+
+    out += "// chunk " + id + "\n";
+    out += "function fn_" + id + "(a, b) {\n";
+    out += "    let total = a + b * 2;\n";
+    out += "    if (total > 10) { return total; } else { total = total - 1; }\n";
+    out += "    for (let i = 0; i < b; i++) { total += i; }\n";
+    out += "    return [a, b, \"string " + id + "\", 0x1f, 1.5e3];\n";
+    out += "}\n";
+    out += "/* block\n   comment */\n";
+    out += "const obj_" + id + " = { name: \"item " + id + "\", value: " + id +
+           ", nested: { flag: true, list: [1, 2, 3] } };\n";
+    out += "var x_" + id + " = fn_" + id + "(" + id + ", obj_" + id + ".value) ? obj_" + id + ".name : null;\n";
+    out += "while (x_" + id + ") { x_" + id + " = false; }\n";
+    out += "try { fn_" + id + "(1, 2); } catch (e) { throw new Error(e.message); }\n";
+    out += "const arrow_" + id + " = (p) => p.value + 1;\n";
+    out += "obj_" + id + "[\"key\"] = typeof arrow_" + id + " === \"function\" && !x_" + id + ";\n";
+
+    return out;
+}
+
+std::string generate_corpus(size_t size) {
+    std::string source;
+    source.reserve(size + 1024);
+
+    for (size_t n = 0; source.size() < size; n++) {
+        source += generate_chunk(n);
+    }
+
+    return source;
+}
+
+// one statement nesting `depth` levels of parenthesised expressions and arrow
+// functions passed as call arguments
+std::string generate_nested_statement(size_t n, size_t depth) {
+    std::string out = "var nested_" + std::to_string(n) + " = ";
+
+    for (size_t i = 0; i < depth; i++) {
+        out += i % 2 == 0 ? "(x + " : "f(y => y * ";
+    }
+
+    out += "1";
+
+    for (size_t i = depth; i > 0; i--) {
+        out += (i - 1) % 2 == 0 ? " - 1)" : ", 2)";
+    }
+
+    return out + ";\n";
+}
+
+// nesting depth grows with the square root of the corpus size
+std::string generate_nested_corpus(size_t size) {
+    auto depth = std::max<size_t>(2, static_cast<size_t>(std::sqrt(static_cast<double>(size)) / 4));
+
+    std::string source;
+    source.reserve(size + 1024);
+
+    for (size_t n = 0; source.size() < size; n++) {
+        source += generate_nested_statement(n, depth);
+    }
+
+    return source;
+}
+
+size_t count_nodes(ast::ASTNode* node);
+
+template<typename T>
+size_t count_nodes(const std::vector<T*> &nodes) {
+    size_t n = 0;
+    for (auto &node: nodes) {
+        n += count_nodes(node);
+    }
+    return n;
+}
+
+size_t count_nodes(ast::ASTNode* node) {
+    if (node == nullptr) {
+        return 0;
+    }
+
+    if (node->type == ast::ASTNodeType::Statement) {
+        auto s = static_cast<ast::Statement*>(node);
+
+        switch (s->type) {
+            case ast::StatementType::Expression:
+                return 1 + count_nodes(s->as_expression_statement()->expression);
+            case ast::StatementType::Block:
+                return 1 + count_nodes(s->as_block()->body);
+            case ast::StatementType::If: {
+                auto i = s->as_if();
+                return 1 + count_nodes(i->test) + count_nodes(i->consequent) + count_nodes(i->alternative);
+            }
+            case ast::StatementType::FunctionDeclaration:
+                return 1 + count_nodes(s->as_function_declaration()->body);
+            case ast::StatementType::While:
+                return 1 + count_nodes(s->as_while()->test) + count_nodes(s->as_while()->body);
+            case ast::StatementType::For: {
+                auto f = s->as_for();
+                return 1 + count_nodes(f->init) + count_nodes(f->test) + count_nodes(f->update) + count_nodes(f->body);
+            }
+            case ast::StatementType::Return:
+                return 1 + count_nodes(s->as_return()->argument);
+            case ast::StatementType::Throw:
+                return 1 + count_nodes(s->as_throw()->argument);
+            case ast::StatementType::TryCatch:
+                return 1 + count_nodes(s->as_trycatch()->try_body) + count_nodes(s->as_trycatch()->catch_body);
+            case ast::StatementType::Break:
+            case ast::StatementType::Continue:
+            case ast::StatementType::LazyBlock:
+                return 1;
+        }
+    }
+
+    auto e = static_cast<ast::Expression*>(node);
+
+    switch (e->type) {
+        case ast::ExpressionType::VariableDeclaration:
+            return 1 + count_nodes(e->as_variable_declaration()->value);
+        case ast::ExpressionType::Call:
+            return 1 + count_nodes(e->as_call()->callee) + count_nodes(e->as_call()->arguments);
+        case ast::ExpressionType::New:
+            return 1 + count_nodes(e->as_new()->callee) + count_nodes(e->as_new()->arguments);
+        case ast::ExpressionType::Member:
+            return 1 + count_nodes(e->as_member()->object) + count_nodes(e->as_member()->property);
+        case ast::ExpressionType::Binary:
+            return 1 + count_nodes(e->as_binary()->left) + count_nodes(e->as_binary()->right);
+        case ast::ExpressionType::Assignment:
+            return 1 + count_nodes(e->as_assignment()->left) + count_nodes(e->as_assignment()->right);
+        case ast::ExpressionType::Unary:
+            return 1 + count_nodes(e->as_unary()->argument);
+        case ast::ExpressionType::Update:
+            return 1 + count_nodes(e->as_update()->argument);
+        case ast::ExpressionType::Ternary: {
+            auto t = e->as_ternary();
+            return 1 + count_nodes(t->test) + count_nodes(t->consequent) + count_nodes(t->alternative);
+        }
+        case ast::ExpressionType::Object: {
+            size_t n = 1;
+            for (auto &p: e->as_object()->properties) {
+                n += count_nodes(p.second);
+            }
+            return n;
+        }
+        case ast::ExpressionType::Array:
+            return 1 + count_nodes(e->as_array()->elements);
+        case ast::ExpressionType::Function:
+            return 1 + count_nodes(e->as_function()->body);
+        case ast::ExpressionType::ArrowFunction:
+            return 1 + count_nodes(e->as_arrow_function()->body);
+        default:
+            return 1;
+    }
+}
+
+size_t peak_rss_kb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+struct Measurement {
+    double seconds = 0;
+    size_t count = 0;
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+};
+
+// runs `f` `repeat` times and keeps the fastest run, `f` returns the number
+// of items it processed
+template<typename F>
+Measurement measure(int repeat, F f) {
+    Measurement best;
+
+    for (auto i = 0; i < repeat; i++) {
+        auto allocations_before = allocations.load();
+        auto bytes_before = allocated_bytes.load();
+        auto start = std::chrono::steady_clock::now();
+
+        auto count = f();
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (i == 0 || elapsed.count() < best.seconds) {
+            best = {elapsed.count(), count, allocations.load() - allocations_before,
+                    allocated_bytes.load() - bytes_before};
+        }
+    }
+
+    return best;
+}
+
+nlohmann::json to_json(const Measurement &m, const std::string &unit) {
+    nlohmann::json j;
+    j["seconds"] = m.seconds;
+    j[unit] = m.count;
+    j[unit + "_per_second"] = m.seconds > 0 ? m.count / m.seconds : 0;
+    j["allocations"] = m.allocations;
+    j["allocated_bytes"] = m.allocated_bytes;
+    return j;
+}
+
+std::vector<size_t> parse_sizes(const std::string &list) {
+    std::vector<size_t> sizes;
+    std::stringstream ss(list);
+    std::string size;
+
+    while (std::getline(ss, size, ',')) {
+        sizes.push_back(std::stoull(size));
+    }
+
+    return sizes;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes = {1 << 10, 64 << 10, 1 << 20, 10 << 20, 50 << 20};
+    int repeat = 3;
+    std::string output;
+    std::string corpus = "chunks";
+
+    for (auto i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg.starts_with("--sizes=")) {
+            sizes = parse_sizes(arg.substr(8));
+        } else if (arg.starts_with("--repeat=")) {
+            repeat = std::max(1, std::stoi(arg.substr(9)));
+        } else if (arg.starts_with("--corpus=")) {
+            corpus = arg.substr(9);
+        } else if (arg.starts_with("--output=")) {
+            output = arg.substr(9);
+        } else {
+            std::cerr << "unknown argument " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (corpus != "chunks" && corpus != "nested") {
+        std::cerr << "unknown corpus " << corpus << "\n";
+        return 1;
+    }
+
+    // peak rss only grows, so smaller corpora are run first
+    std::sort(sizes.begin(), sizes.end());
+
+    auto results = nlohmann::json::array();
+
+    for (auto size: sizes) {
+        auto source = corpus == "nested" ? generate_nested_corpus(size) : generate_corpus(size);
+
+        auto lex = measure(repeat, [&] {
+            lexer::Lexer l;
+            l.set_source(source);
+
+            size_t tokens = 0;
+            while (l.next_token().type != lexer::TokenType::EndOfFile) {
+                tokens++;
+            }
+
+            return tokens;
+        });
+
+        auto parse = measure(repeat, [&] {
+            lexer::TokenStream tokens(source);
+            parser::Parser p;
+            auto program = p.parse(tokens);
+            return count_nodes(program.body);
+        });
+
+        // function bodies are only pre-parsed, as when running a program
+        auto lazy_parse = measure(repeat, [&] {
+            lexer::TokenStream tokens(source);
+            parser::Parser p(true);
+            auto program = p.parse(tokens);
+            return count_nodes(program.body);
+        });
+
+        nlohmann::json result;
+        result["corpus"] = corpus;
+        result["bytes"] = source.size();
+        result["lexer"] = to_json(lex, "tokens");
+        result["parser"] = to_json(parse, "nodes");
+        result["lazy_parser"] = to_json(lazy_parse, "nodes");
+        result["peak_rss_kb"] = peak_rss_kb();
+        results.push_back(result);
+
+        std::cerr << source.size() << " bytes: " << lex.count / lex.seconds << " tokens/s, "
+                  << parse.count / parse.seconds << " nodes/s, lazy parse "
+                  << lazy_parse.seconds / parse.seconds * 100 << "% of the time\n";
+    }
+
+    if (output.empty()) {
+        std::cout << results.dump(4) << "\n";
+    } else {
+        std::ofstream(output) << results.dump(4) << "\n";
+    }
+
+    return 0;
+}
@@ -0,0 +1,759 @@
+#include "bytecode.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace bytecode {
+
+std::string opcode_to_string(Opcode opcode) {
+    switch (opcode) {
+#define OPCODE_TO_STRING(NAME) case Opcode::NAME: return #NAME;
+        OPCODES(OPCODE_TO_STRING)
+#undef OPCODE_TO_STRING
+    }
+
+    assert(false);
+    return {};
+}
+
+void Profile::print(std::ostream &out, size_t count) const {
+    std::vector<size_t> order(pairs.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+
+    count = std::min(count, order.size());
+    std::partial_sort(order.begin(), order.begin() + count, order.end(), [&](size_t x, size_t y) {
+        return pairs[x] > pairs[y];
+    });
+
+    out << "most frequent opcode pairs:\n";
+    for (size_t i = 0; i < count && pairs[order[i]] > 0; i++) {
+        auto previous = static_cast<Opcode>(order[i] / OpcodeCount);
+        auto next = static_cast<Opcode>(order[i] % OpcodeCount);
+        out << "  " << pairs[order[i]] << " " << opcode_to_string(previous) << " " << opcode_to_string(next) << "\n";
+    }
+}
+
+namespace {
+
+// whether evaluating an expression can change a local, reads of locals that
+// happen before it are then copied. functions created in it can only change
+// the variables they capture, which are not registers
+bool writes(ast::Expression* e) {
+    switch (e->type) {
+        case ast::ExpressionType::Assignment:
+        case ast::ExpressionType::Update:
+        case ast::ExpressionType::VariableDeclaration:
+            return true;
+        case ast::ExpressionType::Call: {
+            auto c = e->as_call();
+            return writes(c->callee) || std::any_of(c->arguments.begin(), c->arguments.end(), writes);
+        }
+        case ast::ExpressionType::New: {
+            auto c = e->as_new();
+            return writes(c->callee) || std::any_of(c->arguments.begin(), c->arguments.end(), writes);
+        }
+        case ast::ExpressionType::Member: {
+            auto m = e->as_member();
+            return writes(m->object) || (m->is_computed && writes(m->property));
+        }
+        case ast::ExpressionType::Binary:
+            return writes(e->as_binary()->left) || writes(e->as_binary()->right);
+        case ast::ExpressionType::Unary:
+            return writes(e->as_unary()->argument);
+        case ast::ExpressionType::Ternary: {
+            auto t = e->as_ternary();
+            return writes(t->test) || writes(t->consequent) || writes(t->alternative);
+        }
+        case ast::ExpressionType::Object:
+            return std::any_of(e->as_object()->properties.begin(), e->as_object()->properties.end(),
+                               [](auto &p) { return writes(p.second); });
+        case ast::ExpressionType::Array:
+            return std::any_of(e->as_array()->elements.begin(), e->as_array()->elements.end(), writes);
+        default:
+            return false;
+    }
+}
+
+bool is_leaf(ast::Expression* e) {
+    switch (e->type) {
+        case ast::ExpressionType::Identifier:
+        case ast::ExpressionType::NumberLiteral:
+        case ast::ExpressionType::StringLiteral:
+        case ast::ExpressionType::BooleanLiteral:
+        case ast::ExpressionType::NullLiteral:
+        case ast::ExpressionType::This:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// expressions whose only write to their destination is their last
+// instruction, so they can be compiled straight into the variable they are
+// assigned to even if they read it
+bool is_single_write(ast::Expression* e) {
+    if (is_leaf(e)) {
+        return true;
+    }
+
+    if (e->type == ast::ExpressionType::Binary) {
+        return is_leaf(e->as_binary()->left) && is_leaf(e->as_binary()->right);
+    }
+
+    if (e->type == ast::ExpressionType::Unary) {
+        return is_leaf(e->as_unary()->argument);
+    }
+
+    return false;
+}
+
+}
+
+uint32_t Program::emit(Opcode opcode, uint32_t a, uint32_t b, uint32_t c, ast::Operator op) {
+    builder.chunk.code.push_back(Instruction{opcode, op, a, b, c});
+    return builder.chunk.code.size() - 1;
+}
+
+// points a jump at the next instruction
+void Program::patch(uint32_t jump) {
+    builder.chunk.code[jump].b = builder.chunk.code.size();
+}
+
+// a break or continue of the innermost loop, patched when the loop ends
+void Program::jump_out(bool to_continue) {
+    assert(!builder.loops.empty());
+    auto &loop = builder.loops.back();
+
+    for (auto i = loop.tries; i < builder.tries; i++) {
+        emit(Opcode::LeaveTry);
+    }
+    for (auto i = loop.blocks; i < builder.blocks; i++) {
+        emit(Opcode::LeaveBlock);
+    }
+
+    auto jump = emit(Opcode::Jump);
+    (to_continue ? loop.continues : loop.breaks).push_back(jump);
+}
+
+uint32_t Program::temporary() {
+    auto r = builder.next++;
+    builder.chunk.registers = std::max(builder.chunk.registers, builder.next);
+    return r;
+}
+
+uint32_t Program::finish() {
+    emit(Opcode::ReturnUndefined);
+    chunks.push_back(std::move(builder.chunk));
+    builder = {};
+    return chunks.size() - 1;
+}
+
+// the register of an identifier that refers to a local
+std::optional<uint32_t> Program::local(ast::Expression* expression) {
+    if (expression->type != ast::ExpressionType::Identifier) {
+        return {};
+    }
+
+    auto &binding = expression->as_identifier()->binding;
+    if (binding.kind != ast::Binding::Kind::Local) {
+        return {};
+    }
+
+    return binding.slot;
+}
+
+uint32_t Program::use_local(uint32_t r, atom::Atom name) {
+    if (!builder.defined[r]) {
+        emit(Opcode::CheckDefined, r, static_cast<uint32_t>(name));
+        builder.defined[r] = true;
+    }
+
+    return r;
+}
+
+uint32_t Program::compile(ast::Statement* statement) {
+    builder = {nullptr, {}, 0, {}, {}};
+    compile_statement(statement);
+    return finish();
+}
+
+uint32_t Program::add_function(std::optional<atom::Atom> name, const std::vector<atom::Atom> &parameters,
+                               ast::Scope* scope, ast::ASTNode* body) {
+    functions.push_back(Function{name, parameters, scope, body, {}});
+    return functions.size() - 1;
+}
+
+uint32_t Program::compile_function(uint32_t index, ast::ASTNode* body) {
+    if (functions[index].chunk.has_value()) {
+        return functions[index].chunk.value();
+    }
+
+    auto scope = functions[index].scope;
+    builder = {scope, {}, scope->frame_size, std::vector<bool>(scope->frame_size), {}};
+    builder.chunk.registers = scope->frame_size;
+
+    // every call sets the parameters and arguments
+    for (auto parameter: scope->parameters) {
+        auto &variable = scope->variables[parameter];
+        if (!variable.captured) {
+            builder.defined[variable.slot] = true;
+        }
+    }
+    if (scope->arguments_slot.has_value()) {
+        builder.defined[scope->arguments_slot.value()] = true;
+    }
+
+    if (body->type == ast::ASTNodeType::Statement) {
+        compile_statement(static_cast<ast::Statement*>(body));
+    } else {
+        emit(Opcode::Return, compile_operand(static_cast<ast::Expression*>(body), true));
+    }
+
+    auto chunk = finish();
+    functions[index].chunk = chunk;
+    return chunk;
+}
+
+void Program::compile_statement(ast::Statement* statement) {
+    // temporaries only live for the statement they are used in
+    auto next = builder.next;
+
+    switch (statement->type) {
+        case ast::StatementType::Expression:
+            compile_effect(statement->as_expression_statement()->expression);
+            break;
+        case ast::StatementType::Block: {
+            auto s = statement->as_block();
+            auto environment = s->scope != nullptr ? s->scope->environment_size : 0;
+            if (environment > 0) {
+                emit(Opcode::EnterBlock, environment);
+                builder.blocks++;
+            }
+
+            for (auto child: s->body) {
+                compile_statement(child);
+            }
+
+            if (environment > 0) {
+                builder.blocks--;
+                emit(Opcode::LeaveBlock);
+            }
+            break;
+        }
+        case ast::StatementType::LazyBlock:
+            assert(statement->as_lazy_block()->block != nullptr);
+            compile_statement(statement->as_lazy_block()->block);
+            break;
+        case ast::StatementType::If: {
+            auto s = statement->as_if();
+            auto skip = compile_branch(s->test);
+
+            // what only one branch sets is not set after the if
+            auto defined = builder.defined;
+            compile_statement(s->consequent);
+            builder.defined = defined;
+
+            if (s->alternative != nullptr) {
+                auto end = emit(Opcode::Jump);
+                patch(skip);
+                compile_statement(s->alternative);
+                builder.defined = defined;
+                patch(end);
+            } else {
+                patch(skip);
+            }
+            break;
+        }
+        case ast::StatementType::FunctionDeclaration: {
+            auto s = statement->as_function_declaration();
+            auto function = add_function(s->identifier, s->parameters, s->scope, s->body);
+            auto value = s->binding.kind == ast::Binding::Kind::Local ? s->binding.slot : temporary();
+            emit(Opcode::NewFunction, value, function);
+            store(s->identifier, s->binding, value);
+            break;
+        }
+        case ast::StatementType::While: {
+            auto s = statement->as_while();
+            auto defined = builder.defined;
+
+            auto loop = builder.chunk.code.size();
+            auto exit = compile_branch(s->test);
+            builder.loops.push_back({{}, {}, builder.tries, builder.blocks});
+            compile_statement(s->body);
+            emit(Opcode::Jump, 0, loop);
+            patch(exit);
+
+            for (auto jump: builder.loops.back().continues) {
+                builder.chunk.code[jump].b = loop;
+            }
+            for (auto jump: builder.loops.back().breaks) {
+                patch(jump);
+            }
+            builder.loops.pop_back();
+
+            builder.defined = defined;
+            break;
+        }
+        case ast::StatementType::For: {
+            auto s = statement->as_for();
+            auto environment = s->scope != nullptr ? s->scope->environment_size : 0;
+            if (environment > 0) {
+                emit(Opcode::EnterBlock, environment);
+                builder.blocks++;
+            }
+
+            compile_effect(s->init);
+            auto defined = builder.defined;
+
+            auto loop = builder.chunk.code.size();
+            auto exit = compile_branch(s->test);
+            auto tested = builder.defined;
+            builder.loops.push_back({{}, {}, builder.tries, builder.blocks});
+            compile_statement(s->body);
+            builder.defined = tested;
+
+            for (auto jump: builder.loops.back().continues) {
+                patch(jump);
+            }
+            if (environment > 0 && s->scope->closures) {
+                emit(Opcode::RenewBlock);
+            }
+            compile_effect(s->update);
+            emit(Opcode::Jump, 0, loop);
+            patch(exit);
+
+            for (auto jump: builder.loops.back().breaks) {
+                patch(jump);
+            }
+            builder.loops.pop_back();
+
+            if (environment > 0) {
+                builder.blocks--;
+                emit(Opcode::LeaveBlock);
+            }
+            builder.defined = defined;
+            break;
+        }
+        case ast::StatementType::Return: {
+            auto s = statement->as_return();
+            if (s->argument == nullptr) {
+                emit(Opcode::ReturnUndefined);
+            } else {
+                emit(Opcode::Return, compile_operand(s->argument, true));
+            }
+            break;
+        }
+        case ast::StatementType::Break:
+            jump_out(false);
+            break;
+        case ast::StatementType::Continue:
+            jump_out(true);
+            break;
+        case ast::StatementType::Throw:
+            emit(Opcode::Throw, compile_operand(statement->as_throw()->argument, true));
+            break;
+        case ast::StatementType::TryCatch: {
+            auto s = statement->as_trycatch();
+            auto defined = builder.defined;
+
+            auto error = temporary();
+            auto handler = emit(Opcode::EnterTry, error);
+            builder.tries++;
+            compile_statement(s->try_body);
+            builder.tries--;
+            emit(Opcode::LeaveTry);
+            auto end = emit(Opcode::Jump);
+            builder.defined = defined;
+
+            patch(handler);
+            store(s->catch_identifier, s->catch_binding, error);
+            compile_statement(s->catch_body);
+            builder.defined = defined;
+            patch(end);
+            break;
+        }
+        default:
+            assert(false);
+    }
+
+    builder.next = next;
+}
+
+// a jump to patch that is taken when a test is false
+uint32_t Program::compile_branch(ast::Expression* test) {
+    if (test->type == ast::ExpressionType::Binary &&
+        test->as_binary()->right->type == ast::ExpressionType::NumberLiteral) {
+        auto e = test->as_binary();
+        switch (e->op) {
+            case ast::Operator::EqualTo:
+            case ast::Operator::EqualToStrict:
+            case ast::Operator::NotEqualTo:
+            case ast::Operator::NotEqualToStrict:
+            case ast::Operator::GreaterThan:
+            case ast::Operator::GreaterThanOrEqualTo:
+            case ast::Operator::LessThan:
+            case ast::Operator::LessThanOrEqualTo: {
+                // loading the number has no effects, so the left side can go first
+                auto left = compile_operand(e->left, true);
+                numbers.push_back(e->right->as_number_literal()->value);
+                return emit(Opcode::CompareJump, left, 0, numbers.size() - 1, e->op);
+            }
+            default:
+                break;
+        }
+    }
+
+    return emit(Opcode::JumpIfFalse, compile_operand(test, true));
+}
+
+// an expression whose value is not used
+void Program::compile_effect(ast::Expression* expression) {
+    switch (expression->type) {
+        case ast::ExpressionType::Update: {
+            auto e = expression->as_update();
+            if (auto r = local(e->argument); r.has_value()) {
+                emit(Opcode::UpdateLocal, use_local(r.value(), e->argument->as_identifier()->name), 0, 0, e->op);
+                return;
+            }
+            break;
+        }
+        case ast::ExpressionType::Assignment:
+            compile_assignment(expression->as_assignment(), {});
+            return;
+        case ast::ExpressionType::VariableDeclaration:
+            compile_declaration(expression->as_variable_declaration(), {});
+            return;
+        default:
+            break;
+    }
+
+    compile_expression(expression, temporary());
+}
+
+// a register holding the value of an expression. a local is used where it is
+// unless something evaluated after it and before its register is read could
+// change it
+uint32_t Program::compile_operand(ast::Expression* expression, bool in_place) {
+    if (auto r = local(expression); r.has_value() && in_place) {
+        return use_local(r.value(), expression->as_identifier()->name);
+    }
+
+    auto r = temporary();
+    compile_expression(expression, r);
+    return r;
+}
+
+// sets a variable to the value in a register
+void Program::store(atom::Atom name, const ast::Binding &binding, uint32_t value) {
+    if (binding.kind == ast::Binding::Kind::Local) {
+        if (binding.slot != value) {
+            emit(Opcode::Move, binding.slot, value);
+        }
+        builder.defined[binding.slot] = true;
+        return;
+    }
+
+    bindings.push_back(binding);
+    emit(Opcode::SetVariable, value, bindings.size() - 1, static_cast<uint32_t>(name));
+}
+
+void Program::compile_assignment(ast::AssignmentExpression* e, std::optional<uint32_t> destination) {
+    if (e->left->type == ast::ExpressionType::Identifier) {
+        auto left = e->left->as_identifier();
+        uint32_t result;
+
+        if (e->op == ast::Operator::Equals) {
+            if (auto r = local(left); r.has_value() && is_single_write(e->right)) {
+                compile_expression(e->right, r.value());
+                builder.defined[r.value()] = true;
+                result = r.value();
+            } else {
+                result = compile_operand(e->right, true);
+                store(left->name, left->binding, result);
+            }
+        } else {
+            auto right = compile_operand(e->right, true);
+            if (auto r = local(left); r.has_value()) {
+                result = use_local(r.value(), left->name);
+            } else {
+                result = temporary();
+                compile_expression(left, result);
+            }
+            emit(Opcode::Arithmetic, result, result, right, e->op);
+            store(left->name, left->binding, result);
+        }
+
+        if (destination.has_value() && destination.value() != result) {
+            emit(Opcode::Move, destination.value(), result);
+        }
+        return;
+    }
+
+    // TODO: handle arithmetic assignments
+    assert(e->left->type == ast::ExpressionType::Member);
+    assert(e->op == ast::Operator::Equals);
+
+    // the value is evaluated before the member it is assigned to
+    auto left = e->left->as_member();
+    auto right = compile_operand(e->right, !writes(left->object) && !(left->is_computed && writes(left->property)));
+    auto object = compile_operand(left->object, !left->is_computed || !writes(left->property));
+
+    if (left->is_computed) {
+        auto key = compile_operand(left->property, true);
+        emit(Opcode::SetMember, object, key, right);
+        // like the other engines, the value of the assignment is the key
+        if (destination.has_value()) {
+            emit(Opcode::Move, destination.value(), key);
+        }
+        return;
+    }
+
+    emit(Opcode::SetNamed, object, static_cast<uint32_t>(left->property->as_identifier()->name), right);
+    if (destination.has_value()) {
+        emit(Opcode::Move, destination.value(), right);
+    }
+}
+
+void Program::compile_declaration(ast::VariableDeclarationExpression* e, std::optional<uint32_t> destination) {
+    uint32_t value;
+
+    auto first = e->bindings[0];
+    if (first.kind == ast::Binding::Kind::Local && (e->value == nullptr || is_single_write(e->value))) {
+        value = first.slot;
+    } else {
+        value = temporary();
+    }
+
+    if (e->value != nullptr) {
+        compile_expression(e->value, value);
+    } else {
+        emit(Opcode::LoadUndefined, value);
+    }
+
+    for (size_t i = 0; i < e->identifiers.size(); i++) {
+        store(e->identifiers[i], e->bindings[i], value);
+    }
+
+    if (destination.has_value() && destination.value() != value) {
+        emit(Opcode::Move, destination.value(), value);
+    }
+}
+
+void Program::compile_update(ast::UpdateExpression* e, uint32_t destination) {
+    assert(e->argument->type == ast::ExpressionType::Identifier);
+    auto argument = e->argument->as_identifier();
+
+    if (auto r = local(argument); r.has_value()) {
+        emit(Opcode::Update, destination, use_local(r.value(), argument->name), e->is_prefix, e->op);
+        return;
+    }
+
+    auto value = temporary();
+    compile_expression(argument, value);
+    emit(Opcode::Update, destination, value, e->is_prefix, e->op);
+    store(argument->name, argument->binding, value);
+}
+
+void Program::compile_call(ast::CallExpression* e, uint32_t destination) {
+    auto name = NoName;
+    if (e->callee->type == ast::ExpressionType::Identifier) {
+        strings.push_back(atom::to_string(e->callee->as_identifier()->name));
+        name = strings.size() - 1;
+    } else if (e->callee->type == ast::ExpressionType::Member && !e->callee->as_member()->is_computed) {
+        auto callee = e->callee->as_member();
+        auto property = atom::to_string(callee->property->as_identifier()->name);
+        if (callee->object->type == ast::ExpressionType::Identifier) {
+            strings.push_back(atom::to_string(callee->object->as_identifier()->name) + "." + property);
+        } else {
+            strings.push_back(property);
+        }
+        name = strings.size() - 1;
+    } else {
+        strings.push_back("expression");
+        name = strings.size() - 1;
+    }
+
+    // the callee, this for a method, then the arguments in consecutive registers
+    auto is_method = e->callee->type == ast::ExpressionType::Member;
+    auto base = builder.next;
+    auto first = base + (is_method ? 2 : 1);
+    while (builder.next < first + e->arguments.size()) {
+        temporary();
+    }
+
+    if (is_method) {
+        auto callee = e->callee->as_member();
+        compile_expression(callee->object, base + 1);
+
+        // the method can only be looked up after the arguments are evaluated
+        // if they cannot change it
+        if (!callee->is_computed && std::all_of(e->arguments.begin(), e->arguments.end(), is_leaf)) {
+            for (size_t i = 0; i < e->arguments.size(); i++) {
+                compile_expression(e->arguments[i], first + i);
+            }
+
+            methods.push_back({callee->property->as_identifier()->name, name});
+            emit(Opcode::CallNamed, base, e->arguments.size(), methods.size() - 1);
+
+            if (destination != base) {
+                emit(Opcode::Move, destination, base);
+            }
+            return;
+        }
+
+        if (callee->is_computed) {
+            emit(Opcode::GetMember, base, base + 1, compile_operand(callee->property, true));
+        } else {
+            emit(Opcode::GetNamed, base, base + 1, static_cast<uint32_t>(callee->property->as_identifier()->name));
+        }
+    } else {
+        compile_expression(e->callee, base);
+    }
+
+    for (size_t i = 0; i < e->arguments.size(); i++) {
+        compile_expression(e->arguments[i], first + i);
+    }
+
+    emit(is_method ? Opcode::CallMethod : Opcode::Call, base, e->arguments.size(), name);
+
+    if (destination != base) {
+        emit(Opcode::Move, destination, base);
+    }
+}
+
+// the value of an expression in `destination`, which the expression does not read
+void Program::compile_expression(ast::Expression* expression, uint32_t destination) {
+    switch (expression->type) {
+        case ast::ExpressionType::VariableDeclaration:
+            compile_declaration(expression->as_variable_declaration(), destination);
+            return;
+        case ast::ExpressionType::Assignment:
+            compile_assignment(expression->as_assignment(), destination);
+            return;
+        case ast::ExpressionType::Update:
+            compile_update(expression->as_update(), destination);
+            return;
+        case ast::ExpressionType::Call:
+            compile_call(expression->as_call(), destination);
+            return;
+        case ast::ExpressionType::New: {
+            auto e = expression->as_new();
+            auto base = builder.next;
+            while (builder.next < base + 1 + e->arguments.size()) {
+                temporary();
+            }
+
+            compile_expression(e->callee, base);
+            for (size_t i = 0; i < e->arguments.size(); i++) {
+                compile_expression(e->arguments[i], base + 1 + i);
+            }
+
+            emit(Opcode::New, base, e->arguments.size());
+            if (destination != base) {
+                emit(Opcode::Move, destination, base);
+            }
+            return;
+        }
+        case ast::ExpressionType::Member: {
+            auto e = expression->as_member();
+            auto object = compile_operand(e->object, !e->is_computed || !writes(e->property));
+
+            if (e->is_computed) {
+                emit(Opcode::GetMember, destination, object, compile_operand(e->property, true));
+            } else {
+                emit(Opcode::GetNamed, destination, object, static_cast<uint32_t>(e->property->as_identifier()->name));
+            }
+            return;
+        }
+        case ast::ExpressionType::Identifier: {
+            auto e = expression->as_identifier();
+
+            if (auto r = local(e); r.has_value()) {
+                use_local(r.value(), e->name);
+                if (r.value() != destination) {
+                    emit(Opcode::Move, destination, r.value());
+                }
+                return;
+            }
+
+            bindings.push_back(e->binding);
+            emit(Opcode::GetVariable, destination, bindings.size() - 1, static_cast<uint32_t>(e->name));
+            return;
+        }
+        case ast::ExpressionType::NumberLiteral:
+            numbers.push_back(expression->as_number_literal()->value);
+            emit(Opcode::LoadNumber, destination, numbers.size() - 1);
+            return;
+        case ast::ExpressionType::StringLiteral:
+            strings.push_back(expression->as_string_literal()->value);
+            emit(Opcode::LoadString, destination, strings.size() - 1);
+            return;
+        case ast::ExpressionType::BooleanLiteral:
+            emit(Opcode::LoadBoolean, destination, expression->as_boolean_literal()->value);
+            return;
+        case ast::ExpressionType::NullLiteral:
+            emit(Opcode::LoadNull, destination);
+            return;
+        case ast::ExpressionType::This:
+            emit(Opcode::LoadThis, destination);
+            return;
+        case ast::ExpressionType::Object: {
+            emit(Opcode::NewObject, destination);
+            for (auto &p: expression->as_object()->properties) {
+                emit(Opcode::InitProperty, destination, static_cast<uint32_t>(p.first), compile_operand(p.second, true));
+            }
+            return;
+        }
+        case ast::ExpressionType::Array: {
+            emit(Opcode::NewArray, destination);
+            for (auto element: expression->as_array()->elements) {
+                emit(Opcode::Append, destination, compile_operand(element, true));
+            }
+            return;
+        }
+        case ast::ExpressionType::Function: {
+            auto e = expression->as_function();
+            emit(Opcode::NewFunction, destination, add_function({}, e->parameters, e->scope, e->body));
+            return;
+        }
+        case ast::ExpressionType::ArrowFunction: {
+            auto e = expression->as_arrow_function();
+            emit(Opcode::NewFunction, destination, add_function({}, e->parameters, e->scope, e->body));
+            return;
+        }
+        case ast::ExpressionType::Binary: {
+            // the right side is evaluated first
+            auto e = expression->as_binary();
+            auto right = compile_operand(e->right, !writes(e->left));
+            auto left = compile_operand(e->left, true);
+            emit(Opcode::Binary, destination, left, right, e->op);
+            return;
+        }
+        case ast::ExpressionType::Unary: {
+            auto e = expression->as_unary();
+            emit(Opcode::Unary, destination, compile_operand(e->argument, true), 0, e->op);
+            return;
+        }
+        case ast::ExpressionType::Ternary: {
+            auto e = expression->as_ternary();
+            auto skip = compile_branch(e->test);
+
+            auto defined = builder.defined;
+            compile_expression(e->consequent, destination);
+            builder.defined = defined;
+            auto end = emit(Opcode::Jump);
+
+            patch(skip);
+            compile_expression(e->alternative, destination);
+            builder.defined = defined;
+            patch(end);
+            return;
+        }
+    }
+
+    assert(false);
+}
+
+}
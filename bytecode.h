@@ -0,0 +1,235 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "atom.h"
+
+namespace bytecode {
+
+// what `a`, `b` and `c` of an instruction hold, registers are r, `registers`
+// is the first register of a run of consecutive ones:
+//
+//   LoadNumber         r[a] = numbers[b]
+//   LoadString         r[a] = strings[b]
+//   LoadBoolean        r[a] = b
+//   LoadNull           r[a] = null
+//   LoadUndefined      r[a] = undefined
+//   LoadThis           r[a] = this
+//   Move               r[a] = r[b]
+//   CheckDefined       throws a ReferenceError for atom b if the local r[a] is not set yet
+//   GetVariable        r[a] = the variable bindings[b] named by atom c
+//   SetVariable        the variable bindings[b] named by atom c = r[a]
+//   GetMember          r[a] = r[b][r[c]]
+//   GetNamed           r[a] = r[b].c where c is an atom
+//   SetMember          r[a][r[b]] = r[c]
+//   SetNamed           r[a].b = r[c] where b is an atom
+//   NewObject          r[a] = {}
+//   InitProperty       r[a].b = r[c] where b is an atom, without looking at the prototype
+//   NewArray           r[a] = []
+//   Append             r[a].push(r[b])
+//   NewFunction        r[a] = a function created from functions[b]
+//   Binary             r[a] = r[b] op r[c]
+//   Unary              r[a] = op r[b]
+//   Arithmetic         r[a] = r[b] op r[c] for the numbers of an assignment like +=
+//   Update             r[b] = r[b] op, r[a] = the new value if c is set, the old one otherwise
+//   Jump               continues at b
+//   JumpIfFalse        continues at b if r[a] is falsy
+//   Call               r[a] = r[a](r[a + 1] .. r[a + b]), strings[c] names the callee for errors
+//   CallMethod         r[a] = r[a](r[a + 2] .. r[a + b + 1]) with r[a + 1] as this
+//   New                r[a] = new r[a](r[a + 1] .. r[a + b])
+//   Throw              throws r[a]
+//   EnterTry           continues at b with the error in r[a] if anything before LeaveTry throws
+//   LeaveTry           ends the innermost try
+//   EnterBlock         runs in a new environment of a slots for the captured variables of a block
+//   LeaveBlock         goes back to the environment around the block's
+//   RenewBlock         copies the environment of a for loop for its next iteration
+//   Return             returns r[a]
+//   ReturnUndefined    returns undefined
+//
+// superinstructions for what loops and library calls do most:
+//
+//   CompareJump        continues at b unless r[a] op numbers[c], for a test comparing with a number
+//   UpdateLocal        r[a] = r[a] op for an update of a local whose value is not used
+//   CallNamed          r[a] = r[a + 1].p(r[a + 2] .. r[a + b + 1]) where methods[c] has p and the name for errors
+#define OPCODES(MAP) \
+    MAP(LoadNumber) \
+    MAP(LoadString) \
+    MAP(LoadBoolean) \
+    MAP(LoadNull) \
+    MAP(LoadUndefined) \
+    MAP(LoadThis) \
+    MAP(Move) \
+    MAP(CheckDefined) \
+    MAP(GetVariable) \
+    MAP(SetVariable) \
+    MAP(GetMember) \
+    MAP(GetNamed) \
+    MAP(SetMember) \
+    MAP(SetNamed) \
+    MAP(NewObject) \
+    MAP(InitProperty) \
+    MAP(NewArray) \
+    MAP(Append) \
+    MAP(NewFunction) \
+    MAP(Binary) \
+    MAP(Unary) \
+    MAP(Arithmetic) \
+    MAP(Update) \
+    MAP(Jump) \
+    MAP(JumpIfFalse) \
+    MAP(Call) \
+    MAP(CallMethod) \
+    MAP(New) \
+    MAP(Throw) \
+    MAP(EnterTry) \
+    MAP(LeaveTry) \
+    MAP(EnterBlock) \
+    MAP(LeaveBlock) \
+    MAP(RenewBlock) \
+    MAP(Return) \
+    MAP(ReturnUndefined) \
+    MAP(CompareJump) \
+    MAP(UpdateLocal) \
+    MAP(CallNamed)
+
+#define CREATE_OPCODE(NAME) NAME,
+
+enum class Opcode : uint8_t {
+    OPCODES(CREATE_OPCODE)
+};
+
+#undef CREATE_OPCODE
+
+#define COUNT_OPCODE(NAME) + 1
+constexpr size_t OpcodeCount = 0 OPCODES(COUNT_OPCODE);
+#undef COUNT_OPCODE
+
+std::string opcode_to_string(Opcode opcode);
+
+// c of a call whose callee has no name to report
+constexpr uint32_t NoName = UINT32_MAX;
+
+struct Instruction {
+    Opcode opcode;
+    ast::Operator op;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+};
+
+static_assert(sizeof(Instruction) == 16);
+
+// a method called by name on an object
+struct Method {
+    atom::Atom property;
+    // index into strings of the callee for errors
+    uint32_t name;
+};
+
+// the code of a function body or a top level statement. the locals of a
+// function are its first registers, at the slots the resolver gave them, the
+// temporaries come after them
+struct Chunk {
+    std::vector<Instruction> code;
+    uint32_t registers = 0;
+};
+
+// what creating a function needs, its body is compiled on its first call
+struct Function {
+    std::optional<atom::Atom> name;
+    std::vector<atom::Atom> parameters;
+    ast::Scope* scope;
+    ast::ASTNode* body;
+    std::optional<uint32_t> chunk;
+};
+
+class Program {
+    // the jumps out of a loop being compiled, patched when it ends
+    struct Loop {
+        std::vector<uint32_t> breaks;
+        std::vector<uint32_t> continues;
+        // the tries entered around the loop, the ones entered inside it are
+        // left by a jump out of it
+        uint32_t tries;
+        // the same for the blocks with environments
+        uint32_t blocks;
+    };
+
+    // the chunk being compiled
+    struct Builder {
+        ast::Scope* scope;
+        Chunk chunk;
+        // the first free temporary
+        uint32_t next;
+        // locals that are set on every path to the code being compiled, reads
+        // of the others are checked
+        std::vector<bool> defined;
+        std::vector<Loop> loops;
+        uint32_t tries = 0;
+        uint32_t blocks = 0;
+    };
+
+    Builder builder;
+
+    uint32_t emit(Opcode opcode, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, ast::Operator op = {});
+    void patch(uint32_t jump);
+    void jump_out(bool to_continue);
+    uint32_t temporary();
+    uint32_t finish();
+    std::optional<uint32_t> local(ast::Expression* expression);
+    uint32_t use_local(uint32_t r, atom::Atom name);
+
+    void compile_statement(ast::Statement* statement);
+    uint32_t compile_branch(ast::Expression* test);
+    void compile_effect(ast::Expression* expression);
+    void compile_expression(ast::Expression* expression, uint32_t destination);
+    uint32_t compile_operand(ast::Expression* expression, bool in_place);
+    void compile_assignment(ast::AssignmentExpression* e, std::optional<uint32_t> destination);
+    void compile_declaration(ast::VariableDeclarationExpression* e, std::optional<uint32_t> destination);
+    void compile_update(ast::UpdateExpression* e, uint32_t destination);
+    void compile_call(ast::CallExpression* e, uint32_t destination);
+    void store(atom::Atom name, const ast::Binding &binding, uint32_t value);
+
+public:
+    // chunks are never moved, the vm keeps running one while others are added
+    std::deque<Chunk> chunks;
+    std::vector<double> numbers;
+    std::vector<std::string> strings;
+    std::vector<ast::Binding> bindings;
+    std::vector<Function> functions;
+    std::vector<Method> methods;
+
+    // compiles a resolved top level statement into a chunk of its own, returns its index
+    uint32_t compile(ast::Statement* statement);
+
+    uint32_t add_function(std::optional<atom::Atom> name, const std::vector<atom::Atom> &parameters,
+                          ast::Scope* scope, ast::ASTNode* body);
+
+    // compiles the body of functions[index] the first time it is asked for,
+    // `body` is its parsed and resolved body
+    uint32_t compile_function(uint32_t index, ast::ASTNode* body);
+};
+
+// how often each opcode ran straight after another in the same call, to pick
+// superinstructions from
+class Profile {
+    std::vector<uint64_t> pairs;
+
+public:
+    Profile() : pairs(OpcodeCount * OpcodeCount) {}
+
+    void record(Opcode previous, Opcode next) {
+        pairs[static_cast<size_t>(previous) * OpcodeCount + static_cast<size_t>(next)]++;
+    }
+
+    // prints the `count` most frequent pairs
+    void print(std::ostream &out, size_t count) const;
+};
+
+}
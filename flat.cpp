@@ -0,0 +1,308 @@
+#include "flat.h"
+
+#include <cassert>
+
+namespace flat {
+
+bool is_statement(Kind kind) {
+    return kind <= Kind::LazyBlockStatement;
+}
+
+uint32_t Program::begin(Kind kind, uint32_t a, uint32_t b, ast::Operator op, uint8_t flags) {
+    nodes.push_back(Node{kind, op, flags, 0, a, b});
+    return nodes.size() - 1;
+}
+
+void Program::end(uint32_t index) {
+    nodes[index].size = nodes.size() - index;
+}
+
+uint32_t Program::add_names(const std::vector<atom::Atom> &list) {
+    names.push_back(list);
+    return names.size() - 1;
+}
+
+uint32_t Program::add_function(const std::vector<atom::Atom> &parameters, ast::Scope* scope,
+                               ast::Binding binding) {
+    functions.push_back(Function{parameters, scope, binding});
+    return functions.size() - 1;
+}
+
+uint32_t Program::encode(ast::Statement* statement) {
+    auto root = nodes.size();
+    encode_statement(statement);
+    return root;
+}
+
+uint32_t Program::encode_lazy(uint32_t index, ast::BlockStatement* block) {
+    assert(nodes[index].kind == Kind::LazyBlockStatement);
+
+    if (nodes[index].b == 0) {
+        auto root = encode(block);
+        nodes[index].b = root + 1;
+    }
+
+    return nodes[index].b - 1;
+}
+
+void Program::encode_node(ast::ASTNode* node) {
+    if (node->type == ast::ASTNodeType::Statement) {
+        encode_statement(static_cast<ast::Statement*>(node));
+    } else {
+        encode_expression(static_cast<ast::Expression*>(node));
+    }
+}
+
+void Program::encode_statement(ast::Statement* statement) {
+    switch (statement->type) {
+        case ast::StatementType::Expression: {
+            auto n = begin(Kind::ExpressionStatement);
+            encode_expression(statement->as_expression_statement()->expression);
+            end(n);
+            return;
+        }
+        case ast::StatementType::Block: {
+            auto s = statement->as_block();
+            auto n = begin(Kind::BlockStatement, s->body.size(), s->scope != nullptr ? s->scope->environment_size : 0);
+            for (auto child: s->body) {
+                encode_statement(child);
+            }
+            end(n);
+            return;
+        }
+        case ast::StatementType::If: {
+            auto s = statement->as_if();
+            auto n = begin(Kind::IfStatement, 0, 0, {}, s->alternative != nullptr ? HasOptional : 0);
+            encode_expression(s->test);
+            encode_statement(s->consequent);
+            if (s->alternative != nullptr) {
+                encode_statement(s->alternative);
+            }
+            end(n);
+            return;
+        }
+        case ast::StatementType::FunctionDeclaration: {
+            auto s = statement->as_function_declaration();
+            auto n = begin(Kind::FunctionDeclarationStatement, static_cast<uint32_t>(s->identifier),
+                           add_function(s->parameters, s->scope, s->binding));
+            encode_statement(s->body);
+            end(n);
+            return;
+        }
+        case ast::StatementType::While: {
+            auto s = statement->as_while();
+            auto n = begin(Kind::WhileStatement);
+            encode_expression(s->test);
+            encode_statement(s->body);
+            end(n);
+            return;
+        }
+        case ast::StatementType::For: {
+            auto s = statement->as_for();
+            auto environment = s->scope != nullptr ? s->scope->environment_size : 0;
+            auto n = begin(Kind::ForStatement, environment, 0, {},
+                           environment > 0 && s->scope->closures ? Renews : 0);
+            encode_expression(s->init);
+            encode_expression(s->test);
+            encode_expression(s->update);
+            encode_statement(s->body);
+            end(n);
+            return;
+        }
+        case ast::StatementType::Return: {
+            auto s = statement->as_return();
+            auto n = begin(Kind::ReturnStatement, 0, 0, {}, s->argument != nullptr ? HasOptional : 0);
+            if (s->argument != nullptr) {
+                encode_expression(s->argument);
+            }
+            end(n);
+            return;
+        }
+        case ast::StatementType::Throw: {
+            auto n = begin(Kind::ThrowStatement);
+            encode_expression(statement->as_throw()->argument);
+            end(n);
+            return;
+        }
+        case ast::StatementType::Break:
+            end(begin(Kind::BreakStatement));
+            return;
+        case ast::StatementType::Continue:
+            end(begin(Kind::ContinueStatement));
+            return;
+        case ast::StatementType::TryCatch: {
+            auto s = statement->as_trycatch();
+            bindings.push_back(s->catch_binding);
+            auto n = begin(Kind::TryCatchStatement, static_cast<uint32_t>(s->catch_identifier), bindings.size() - 1);
+            encode_statement(s->try_body);
+            encode_statement(s->catch_body);
+            end(n);
+            return;
+        }
+        case ast::StatementType::LazyBlock: {
+            auto s = statement->as_lazy_block();
+            if (s->block != nullptr) {
+                encode_statement(s->block);
+                return;
+            }
+
+            auto n = begin(Kind::LazyBlockStatement, lazy.size());
+            lazy.push_back(s);
+            end(n);
+            return;
+        }
+    }
+
+    assert(false);
+}
+
+void Program::encode_expression(ast::Expression* expression) {
+    switch (expression->type) {
+        case ast::ExpressionType::VariableDeclaration: {
+            auto e = expression->as_variable_declaration();
+            auto n = begin(Kind::VariableDeclarationExpression, add_names(e->identifiers), bindings.size(), {},
+                           e->value != nullptr ? HasOptional : 0);
+            bindings.insert(bindings.end(), e->bindings.begin(), e->bindings.end());
+            if (e->value != nullptr) {
+                encode_expression(e->value);
+            }
+            end(n);
+            return;
+        }
+        case ast::ExpressionType::Call: {
+            auto e = expression->as_call();
+            auto n = begin(Kind::CallExpression, e->arguments.size());
+            encode_expression(e->callee);
+            for (auto arg: e->arguments) {
+                encode_expression(arg);
+            }
+            end(n);
+            return;
+        }
+        case ast::ExpressionType::New: {
+            auto e = expression->as_new();
+            auto n = begin(Kind::NewExpression, e->arguments.size());
+            encode_expression(e->callee);
+            for (auto arg: e->arguments) {
+                encode_expression(arg);
+            }
+            end(n);
+            return;
+        }
+        case ast::ExpressionType::Member: {
+            auto e = expression->as_member();
+            auto n = begin(Kind::MemberExpression, 0, 0, {}, e->is_computed ? IsComputed : 0);
+            encode_expression(e->object);
+            encode_expression(e->property);
+            end(n);
+            return;
+        }
+        case ast::ExpressionType::Identifier: {
+            auto e = expression->as_identifier();
+            bindings.push_back(e->binding);
+            end(begin(Kind::IdentifierExpression, static_cast<uint32_t>(e->name), bindings.size() - 1));
+            return;
+        }
+        case ast::ExpressionType::NumberLiteral: {
+            numbers.push_back(expression->as_number_literal()->value);
+            end(begin(Kind::NumberLiteralExpression, numbers.size() - 1));
+            return;
+        }
+        case ast::ExpressionType::StringLiteral: {
+            strings.push_back(expression->as_string_literal()->value);
+            end(begin(Kind::StringLiteralExpression, strings.size() - 1));
+            return;
+        }
+        case ast::ExpressionType::BooleanLiteral: {
+            auto value = expression->as_boolean_literal()->value;
+            end(begin(Kind::BooleanLiteralExpression, 0, 0, {}, value ? BooleanValue : 0));
+            return;
+        }
+        case ast::ExpressionType::NullLiteral:
+            end(begin(Kind::NullLiteralExpression));
+            return;
+        case ast::ExpressionType::This:
+            end(begin(Kind::ThisExpression));
+            return;
+        case ast::ExpressionType::Binary: {
+            auto e = expression->as_binary();
+            auto n = begin(Kind::BinaryExpression, 0, 0, e->op);
+            encode_expression(e->left);
+            encode_expression(e->right);
+            end(n);
+            return;
+        }
+        case ast::ExpressionType::Assignment: {
+            auto e = expression->as_assignment();
+            auto n = begin(Kind::AssignmentExpression, 0, 0, e->op);
+            encode_expression(e->left);
+            encode_expression(e->right);
+            end(n);
+            return;
+        }
+        case ast::ExpressionType::Unary: {
+            auto e = expression->as_unary();
+            auto n = begin(Kind::UnaryExpression, 0, 0, e->op);
+            encode_expression(e->argument);
+            end(n);
+            return;
+        }
+        case ast::ExpressionType::Update: {
+            auto e = expression->as_update();
+            auto n = begin(Kind::UpdateExpression, 0, 0, e->op, e->is_prefix ? IsPrefix : 0);
+            encode_expression(e->argument);
+            end(n);
+            return;
+        }
+        case ast::ExpressionType::Ternary: {
+            auto e = expression->as_ternary();
+            auto n = begin(Kind::TernaryExpression);
+            encode_expression(e->test);
+            encode_expression(e->consequent);
+            encode_expression(e->alternative);
+            end(n);
+            return;
+        }
+        case ast::ExpressionType::Object: {
+            auto e = expression->as_object();
+            std::vector<atom::Atom> keys;
+            for (auto &p: e->properties) {
+                keys.push_back(p.first);
+            }
+
+            auto n = begin(Kind::ObjectExpression, add_names(keys));
+            for (auto &p: e->properties) {
+                encode_expression(p.second);
+            }
+            end(n);
+            return;
+        }
+        case ast::ExpressionType::Array: {
+            auto e = expression->as_array();
+            auto n = begin(Kind::ArrayExpression, e->elements.size());
+            for (auto element: e->elements) {
+                encode_expression(element);
+            }
+            end(n);
+            return;
+        }
+        case ast::ExpressionType::Function: {
+            auto e = expression->as_function();
+            auto n = begin(Kind::FunctionExpression, 0, add_function(e->parameters, e->scope));
+            encode_statement(e->body);
+            end(n);
+            return;
+        }
+        case ast::ExpressionType::ArrowFunction: {
+            auto e = expression->as_arrow_function();
+            auto n = begin(Kind::ArrowFunctionExpression, 0, add_function(e->parameters, e->scope));
+            encode_node(e->body);
+            end(n);
+            return;
+        }
+    }
+
+    assert(false);
+}
+
+}
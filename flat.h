@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "atom.h"
+
+namespace flat {
+
+// statements and expressions share one numbering in the flat encoding
+#define CREATE_STATEMENT_KIND(NAME) NAME ## Statement,
+#define CREATE_EXPRESSION_KIND(NAME) NAME ## Expression,
+
+enum class Kind : uint8_t {
+    STATEMENTS(CREATE_STATEMENT_KIND)
+    EXPRESSIONS(CREATE_EXPRESSION_KIND)
+};
+
+#undef CREATE_STATEMENT_KIND
+#undef CREATE_EXPRESSION_KIND
+
+enum Flags : uint8_t {
+    // the optional child (if alternative, return argument, declaration value) is present
+    HasOptional = 1 << 0,
+    IsComputed = 1 << 1,
+    IsPrefix = 1 << 2,
+    BooleanValue = 1 << 3,
+    // a for loop copies its environment for each iteration
+    Renews = 1 << 4,
+};
+
+// one fixed size record per ast node. children follow their parent in order,
+// `size` counts the records in the subtree so the next sibling of a node is
+// at its index plus its size. what `a` and `b` hold depends on the kind:
+//
+//   Identifier                   a: atom, b: index into bindings
+//   NumberLiteral                a: index into numbers
+//   StringLiteral                a: index into strings
+//   FunctionDeclaration          a: identifier atom, b: index into functions
+//   Function, ArrowFunction      b: index into functions
+//   TryCatch                     a: catch identifier atom, b: catch binding index
+//   VariableDeclaration          a: identifiers in names, b: first of their bindings
+//   Object                       a: property keys in names, one child per key
+//   Block                        a: number of children, b: size of its environment, 0 for none
+//   For                          a: size of its environment, 0 for none
+//   Array, Call, New             a: number of children (not counting the callee)
+//   LazyBlock                    a: index into lazy, b: index of the encoded body plus one once encoded
+struct Node {
+    Kind kind;
+    ast::Operator op;
+    uint8_t flags;
+    uint32_t size;
+    uint32_t a;
+    uint32_t b;
+};
+
+static_assert(sizeof(Node) == 16);
+
+// what creating a function needs besides its body
+struct Function {
+    std::vector<atom::Atom> parameters;
+    ast::Scope* scope;
+    // where a declaration puts the function
+    ast::Binding binding;
+};
+
+class Program {
+    uint32_t begin(Kind kind, uint32_t a = 0, uint32_t b = 0, ast::Operator op = {}, uint8_t flags = 0);
+    void end(uint32_t index);
+    uint32_t add_names(const std::vector<atom::Atom> &list);
+    uint32_t add_function(const std::vector<atom::Atom> &parameters, ast::Scope* scope, ast::Binding binding = {});
+
+    void encode_node(ast::ASTNode* node);
+    void encode_statement(ast::Statement* statement);
+    void encode_expression(ast::Expression* expression);
+
+public:
+    std::vector<Node> nodes;
+    std::vector<double> numbers;
+    std::vector<std::string> strings;
+    std::vector<std::vector<atom::Atom>> names;
+    std::vector<ast::LazyBlockStatement*> lazy;
+    std::vector<ast::Binding> bindings;
+    std::vector<Function> functions;
+
+    // appends the encoding of a top level statement, returns the index of its root
+    uint32_t encode(ast::Statement* statement);
+
+    // appends the encoding of a lazily parsed function body the first time it
+    // is asked for, returns the index of the encoded block
+    uint32_t encode_lazy(uint32_t index, ast::BlockStatement* block);
+
+    ast::LazyBlockStatement* lazy_body(uint32_t index) const {
+        return lazy[nodes[index].a];
+    }
+
+    const Node &operator[](uint32_t index) const {
+        return nodes[index];
+    }
+
+    uint32_t next_sibling(uint32_t index) const {
+        return index + nodes[index].size;
+    }
+
+    // index of the nth child, walks the siblings before it
+    uint32_t child(uint32_t index, uint32_t n) const {
+        auto c = index + 1;
+        for (uint32_t i = 0; i < n; i++) {
+            c = next_sibling(c);
+        }
+        return c;
+    }
+};
+
+bool is_statement(Kind kind);
+
+}
@@ -1,643 +1,1849 @@
 #include "interpreter.h"
 
 #include <iostream>
+#include <cmath>
 
 namespace interpreter {
 
-object::Value* Interpreter::execute(std::shared_ptr<ast::Statement> statement) {
+Interpreter::Completion Interpreter::execute(ast::Statement* statement) {
     switch (statement->type) {
         case ast::StatementType::Throw: {
             auto s = statement->as_throw();
             auto arg = execute(s->argument);
-            throw arg;
+            if (arg != nullptr) {
+                exception = arg;
+            }
+            return {Completion::Type::Throw};
         }
         case ast::StatementType::TryCatch: {
             auto s = statement->as_trycatch();
-            try {
-                return execute(s->try_body);
-            } catch (object::Value* error) {
-                om.push_scope(om.new_object());
-                om.current_scope()->set_variable(s->catch_identifier, error);
-                execute(s->catch_body);
-                om.pop_scope();
-                return om.new_undefined();
+            auto completion = execute(s->try_body);
+            if (completion.type != Completion::Type::Throw) {
+                return completion;
             }
+
+            slot(s->catch_binding) = catch_exception();
+            return execute(s->catch_body);
         }
         case ast::StatementType::Expression: {
             auto s = statement->as_expression_statement();
-            return execute(s->expression);
+            auto value = execute(s->expression);
+            if (value == nullptr) {
+                return {Completion::Type::Throw};
+            }
+
+            return {Completion::Type::Normal, value};
         }
         case ast::StatementType::If: {
             auto s = statement->as_if();
 
             auto test = execute(s->test);
-            if (test->is_truthy()) {
+            if (test == nullptr) {
+                return {Completion::Type::Throw};
+            }
+
+            if (test.is_truthy()) {
                 return execute(s->consequent);
-            } else if (s->alternative.has_value()) {
-                return execute(s->alternative.value());
+            } else if (s->alternative != nullptr) {
+                return execute(s->alternative);
             }
 
-            return om.new_undefined();
+            return {};
         }
         case ast::StatementType::While: {
             auto s = statement->as_while();
 
-            while (execute(s->test)->is_truthy()) {
-                execute(s->body);
+            while (true) {
+                auto test = execute(s->test);
+                if (test == nullptr) {
+                    return {Completion::Type::Throw};
+                }
+                if (!test.is_truthy()) {
+                    break;
+                }
+
+                auto completion = execute(s->body);
+                if (completion.type == Completion::Type::Break) {
+                    break;
+                } else if (completion.type == Completion::Type::Return || completion.type == Completion::Type::Throw) {
+                    return completion;
+                }
             }
 
-            return om.new_undefined();
+            return {};
         }
         case ast::StatementType::For: {
             auto s = statement->as_for();
 
-            for (execute(s->init); execute(s->test)->is_truthy(); execute(s->update)) {
-                execute(s->body);
+            // the captured variables of init get an environment for the loop
+            auto environment = s->scope != nullptr ? s->scope->environment_size : 0;
+            if (environment > 0) {
+                om.push_environment(environment);
             }
 
-            return om.new_undefined();
+            Completion completion;
+            if (execute(s->init) == nullptr) {
+                completion = {Completion::Type::Throw};
+            }
+
+            while (completion.type == Completion::Type::Normal) {
+                auto test = execute(s->test);
+                if (test == nullptr) {
+                    completion = {Completion::Type::Throw};
+                    break;
+                }
+                if (!test.is_truthy()) {
+                    break;
+                }
+
+                auto body = execute(s->body);
+                if (body.type == Completion::Type::Break) {
+                    break;
+                } else if (body.type == Completion::Type::Return || body.type == Completion::Type::Throw) {
+                    completion = body;
+                    break;
+                }
+
+                if (environment > 0 && s->scope->closures) {
+                    om.renew_environment();
+                }
+                if (execute(s->update) == nullptr) {
+                    completion = {Completion::Type::Throw};
+                }
+            }
+
+            if (environment > 0) {
+                om.pop_environment();
+            }
+            return completion;
         }
         case ast::StatementType::Block: {
             auto block = statement->as_block();
 
+            // captured let and const get an environment each time the block runs
+            auto environment = block->scope != nullptr ? block->scope->environment_size : 0;
+            if (environment > 0) {
+                om.push_environment(environment);
+            }
+
+            Completion completion;
             for (auto s: block->body) {
-                execute(s);
+                completion = execute(s);
+                if (completion.type != Completion::Type::Normal) {
+                    break;
+                }
+            }
+
+            if (environment > 0) {
+                om.pop_environment();
+            }
+            return completion.type == Completion::Type::Normal ? Completion{} : completion;
+        }
+        case ast::StatementType::FunctionDeclaration: {
+            auto s = statement->as_function_declaration();
+            set_variable(s->identifier, s->binding, new_function(s->identifier, s->parameters, s->body, s->scope));
+            return {};
+        }
+        case ast::StatementType::Return: {
+            auto s = statement->as_return();
+
+            if (s->argument == nullptr) {
+                return {Completion::Type::Return, om.new_undefined()};
+            }
+
+            auto value = execute(s->argument);
+            if (value == nullptr) {
+                return {Completion::Type::Throw};
+            }
+
+            return {Completion::Type::Return, value};
+        }
+        case ast::StatementType::Break:
+            return {Completion::Type::Break};
+        case ast::StatementType::Continue:
+            return {Completion::Type::Continue};
+        case ast::StatementType::LazyBlock:
+            // call_function parses a lazy body before it runs
+            break;
+    }
+
+    std::cerr << "unable to execute statement type:" << statement->to_json()["type"] << "\n";
+    assert(false);
+}
+
+object::Value Interpreter::execute(ast::Expression* expression) {
+    switch (expression->type) {
+        case ast::ExpressionType::New: {
+            auto e = expression->as_new();
+            auto constructor = execute(e->callee);
+            if (constructor == nullptr) {
+                return nullptr;
+            }
+
+            std::vector<object::Value> args;
+            for (auto arg: e->arguments) {
+                auto value = execute(arg);
+                if (value == nullptr) {
+                    return nullptr;
+                }
+                args.push_back(value);
+            }
+
+            return construct(constructor, args);
+        }
+
+        case ast::ExpressionType::This: {
+            return om.current_frame().context;
+        }
+        case ast::ExpressionType::Call: {
+            auto e = expression->as_call();
+
+            // the receiver of a method is evaluated once, for the lookup and as this
+            auto context = om.global_object();
+            object::Value func_obj;
+            if (e->callee->type == ast::ExpressionType::Member) {
+                auto callee = e->callee->as_member();
+                context = execute(callee->object);
+                if (context == nullptr) {
+                    return nullptr;
+                }
+
+                if (callee->is_computed) {
+                    auto property = execute(callee->property);
+                    if (property == nullptr) {
+                        return nullptr;
+                    }
+                    func_obj = get_member(context, property);
+                } else {
+                    func_obj = get_member(context, callee->property->as_identifier()->name);
+                }
+            } else {
+                func_obj = execute(e->callee);
+            }
+
+            if (func_obj == nullptr) {
+                return nullptr;
+            }
+
+            if (func_obj.type() == object::Value::Type::Undefined) {
+                if (e->callee->type == ast::ExpressionType::Identifier) {
+                    return throw_not_a_function(atom::to_string(e->callee->as_identifier()->name));
+                } else if (e->callee->type == ast::ExpressionType::Member && !e->callee->as_member()->is_computed) {
+                    auto callee = e->callee->as_member();
+                    auto property_id = atom::to_string(callee->property->as_identifier()->name);
+                    if (callee->object->type != ast::ExpressionType::Identifier) {
+                        return throw_not_a_function(property_id);
+                    }
+
+                    auto object_id = atom::to_string(callee->object->as_identifier()->name);
+                    return throw_not_a_function(object_id + "." + property_id);
+                }
+
+                return throw_not_a_function("expression");
+            }
+
+            std::vector<object::Value> args;
+
+            for (auto arg: e->arguments) {
+                auto value = execute(arg);
+                if (value == nullptr) {
+                    return nullptr;
+                }
+                args.push_back(value);
+            }
+
+            return call_function(context, func_obj, args);
+        }
+        case ast::ExpressionType::Member: {
+            auto e = expression->as_member();
+            auto obj = execute(e->object);
+            if (obj == nullptr) {
+                return nullptr;
+            }
+
+            if (e->is_computed) {
+                auto property = execute(e->property);
+                if (property == nullptr) {
+                    return nullptr;
+                }
+                return get_member(obj, property);
+            }
+
+            return get_member(obj, e->property->as_identifier()->name);
+        }
+        case ast::ExpressionType::VariableDeclaration: {
+            auto e = expression->as_variable_declaration();
+            object::Value value = e->value != nullptr ? execute(e->value) : om.new_undefined();
+            if (value == nullptr) {
+                return nullptr;
+            }
+
+            for (size_t i = 0; i < e->identifiers.size(); i++) {
+                set_variable(e->identifiers[i], e->bindings[i], value);
+            }
+            return value;
+        }
+        case ast::ExpressionType::Assignment: {
+            auto e = expression->as_assignment();
+
+            auto right = execute(e->right);
+            if (right == nullptr) {
+                return nullptr;
+            }
+
+            if (e->left->type == ast::ExpressionType::Identifier) {
+                auto left = e->left->as_identifier();
+                return assign_variable(e->op, left->name, left->binding, right);
+            }
+
+            if (e->left->type == ast::ExpressionType::Member) {
+                // TODO: handle arithmetic assignments
+                assert(e->op == ast::Operator::Equals);
+
+                auto left = e->left->as_member();
+                auto object = execute(left->object);
+                if (object == nullptr) {
+                    return nullptr;
+                }
+
+                if (left->is_computed) {
+                    auto property = execute(left->property);
+                    if (property == nullptr) {
+                        return nullptr;
+                    }
+                    return set_member(object, property, right);
+                }
+
+                return object.set_property(left->property->as_identifier()->name, right);
+            }
+
+            assert(false);
+        }
+        case ast::ExpressionType::Identifier: {
+            auto e = expression->as_identifier();
+            return get_variable(e->name, e->binding);
+        }
+        case ast::ExpressionType::NumberLiteral: {
+            return om.new_number(expression->as_number_literal()->value);
+        }
+        case ast::ExpressionType::StringLiteral: {
+            return om.new_string(expression->as_string_literal()->value);
+        }
+        case ast::ExpressionType::BooleanLiteral: {
+            return om.new_boolean(expression->as_boolean_literal()->value);
+        }
+        case ast::ExpressionType::NullLiteral: {
+            return om.new_null();
+        }
+        case ast::ExpressionType::Object: {
+            auto e = expression->as_object();
+            auto object = om.new_object();
+
+            for (auto p: e->properties) {
+                auto value = execute(p.second);
+                if (value == nullptr) {
+                    return nullptr;
+                }
+                object.properties()[p.first] = value;
+            }
+
+            return object;
+        }
+        case ast::ExpressionType::Array: {
+            auto e = expression->as_array();
+            auto array_value = om.new_array();
+            auto array = array_value.array();
+
+            for (auto e: e->elements) {
+                auto value = execute(e);
+                if (value == nullptr) {
+                    return nullptr;
+                }
+                array->elements.push_back(value);
+            }
+
+            return array_value;
+        }
+        case ast::ExpressionType::Function: {
+            auto e = expression->as_function();
+            return new_function({}, e->parameters, e->body, e->scope);
+        }
+        case ast::ExpressionType::ArrowFunction: {
+            auto e = expression->as_arrow_function();
+            return new_function({}, e->parameters, e->body, e->scope);
+        }
+        case ast::ExpressionType::Binary: {
+            auto e = expression->as_binary();
+
+            auto right_result = execute(e->right);
+            if (right_result == nullptr) {
+                return nullptr;
+            }
+            auto left_result = execute(e->left);
+            if (left_result == nullptr) {
+                return nullptr;
+            }
+
+            return binary_operation(e->op, left_result, right_result);
+        }
+        case ast::ExpressionType::Unary: {
+            auto e = expression->as_unary();
+            auto argument = execute(e->argument);
+            if (argument == nullptr) {
+                return nullptr;
+            }
+
+            return unary_operation(e->op, argument);
+        }
+        case ast::ExpressionType::Update: {
+            auto e = expression->as_update();
+            assert(e->argument->type == ast::ExpressionType::Identifier);
+            auto argument = e->argument->as_identifier();
+            return update_variable(e->op, argument->name, argument->binding, e->is_prefix);
+        }
+        case ast::ExpressionType::Ternary: {
+            auto e = expression->as_ternary();
+
+            auto test = execute(e->test);
+            if (test == nullptr) {
+                return nullptr;
+            }
+
+            if (test.is_truthy()) {
+                return execute(e->consequent);
+            } else {
+                return execute(e->alternative);
+            }
+        }
+    }
+
+    std::cerr << "unable to execute expression type: " << expression->to_json()["type"]
+              << "\n";
+    assert(false);
+}
+
+Interpreter::Completion Interpreter::execute_flat_statement(uint32_t index) {
+    // a copy, running a statement can append to the program and move the records
+    auto node = flat_program[index];
+    auto first = index + 1;
+
+    switch (node.kind) {
+        case flat::Kind::ExpressionStatement: {
+            auto value = execute_flat(first);
+            if (value == nullptr) {
+                return {Completion::Type::Throw};
+            }
+
+            return {Completion::Type::Normal, value};
+        }
+        case flat::Kind::BlockStatement: {
+            if (node.b > 0) {
+                om.push_environment(node.b);
+            }
+
+            Completion completion;
+            auto child = first;
+            for (uint32_t i = 0; i < node.a; i++) {
+                completion = execute_flat_statement(child);
+                if (completion.type != Completion::Type::Normal) {
+                    break;
+                }
+                child = flat_program.next_sibling(child);
+            }
+
+            if (node.b > 0) {
+                om.pop_environment();
+            }
+            return completion.type == Completion::Type::Normal ? Completion{} : completion;
+        }
+        case flat::Kind::IfStatement: {
+            auto consequent = flat_program.next_sibling(first);
+
+            auto test = execute_flat(first);
+            if (test == nullptr) {
+                return {Completion::Type::Throw};
+            }
+
+            if (test.is_truthy()) {
+                return execute_flat_statement(consequent);
+            } else if (node.flags & flat::HasOptional) {
+                return execute_flat_statement(flat_program.next_sibling(consequent));
+            }
+
+            return {};
+        }
+        case flat::Kind::FunctionDeclarationStatement: {
+            auto name = static_cast<atom::Atom>(node.a);
+            auto &function = flat_program.functions[node.b];
+            set_variable(name, function.binding, new_flat_function(name, function, first));
+            return {};
+        }
+        case flat::Kind::WhileStatement: {
+            auto body = flat_program.next_sibling(first);
+
+            while (true) {
+                auto test = execute_flat(first);
+                if (test == nullptr) {
+                    return {Completion::Type::Throw};
+                }
+                if (!test.is_truthy()) {
+                    break;
+                }
+
+                auto completion = execute_flat_statement(body);
+                if (completion.type == Completion::Type::Break) {
+                    break;
+                } else if (completion.type == Completion::Type::Return || completion.type == Completion::Type::Throw) {
+                    return completion;
+                }
+            }
+
+            return {};
+        }
+        case flat::Kind::ForStatement: {
+            auto test = flat_program.next_sibling(first);
+            auto update = flat_program.next_sibling(test);
+            auto body = flat_program.next_sibling(update);
+
+            if (node.a > 0) {
+                om.push_environment(node.a);
+            }
+
+            Completion completion;
+            if (execute_flat(first) == nullptr) {
+                completion = {Completion::Type::Throw};
+            }
+
+            while (completion.type == Completion::Type::Normal) {
+                auto test_result = execute_flat(test);
+                if (test_result == nullptr) {
+                    completion = {Completion::Type::Throw};
+                    break;
+                }
+                if (!test_result.is_truthy()) {
+                    break;
+                }
+
+                auto body_completion = execute_flat_statement(body);
+                if (body_completion.type == Completion::Type::Break) {
+                    break;
+                } else if (body_completion.type == Completion::Type::Return ||
+                           body_completion.type == Completion::Type::Throw) {
+                    completion = body_completion;
+                    break;
+                }
+
+                if (node.flags & flat::Renews) {
+                    om.renew_environment();
+                }
+                if (execute_flat(update) == nullptr) {
+                    completion = {Completion::Type::Throw};
+                }
+            }
+
+            if (node.a > 0) {
+                om.pop_environment();
+            }
+            return completion;
+        }
+        case flat::Kind::ReturnStatement: {
+            if (!(node.flags & flat::HasOptional)) {
+                return {Completion::Type::Return, om.new_undefined()};
+            }
+
+            auto value = execute_flat(first);
+            if (value == nullptr) {
+                return {Completion::Type::Throw};
+            }
+
+            return {Completion::Type::Return, value};
+        }
+        case flat::Kind::ThrowStatement: {
+            auto arg = execute_flat(first);
+            if (arg != nullptr) {
+                exception = arg;
+            }
+            return {Completion::Type::Throw};
+        }
+        case flat::Kind::TryCatchStatement: {
+            auto completion = execute_flat_statement(first);
+            if (completion.type != Completion::Type::Throw) {
+                return completion;
+            }
+
+            slot(flat_program.bindings[node.b]) = catch_exception();
+            return execute_flat_statement(flat_program.next_sibling(first));
+        }
+        case flat::Kind::BreakStatement:
+            return {Completion::Type::Break};
+        case flat::Kind::ContinueStatement:
+            return {Completion::Type::Continue};
+        default:
+            break;
+    }
+
+    std::cerr << "unable to execute flat statement kind: " << static_cast<int>(node.kind) << "\n";
+    assert(false);
+}
+
+object::Value Interpreter::execute_flat(uint32_t index) {
+    auto node = flat_program[index];
+    auto first = index + 1;
+
+    switch (node.kind) {
+        case flat::Kind::NewExpression: {
+            auto constructor = execute_flat(first);
+            if (constructor == nullptr) {
+                return nullptr;
+            }
+
+            std::vector<object::Value> args;
+            auto arg = flat_program.next_sibling(first);
+            for (uint32_t i = 0; i < node.a; i++) {
+                auto value = execute_flat(arg);
+                if (value == nullptr) {
+                    return nullptr;
+                }
+                args.push_back(value);
+                arg = flat_program.next_sibling(arg);
+            }
+
+            return construct(constructor, args);
+        }
+        case flat::Kind::ThisExpression: {
+            return om.current_frame().context;
+        }
+        case flat::Kind::CallExpression: {
+            auto callee = flat_program[first];
+
+            // the receiver of a method is evaluated once, for the lookup and as this
+            auto context = om.global_object();
+            object::Value func_obj;
+            if (callee.kind == flat::Kind::MemberExpression) {
+                context = execute_flat(first + 1);
+                if (context == nullptr) {
+                    return nullptr;
+                }
+
+                auto property = flat_program.next_sibling(first + 1);
+                if (callee.flags & flat::IsComputed) {
+                    auto key = execute_flat(property);
+                    if (key == nullptr) {
+                        return nullptr;
+                    }
+                    func_obj = get_member(context, key);
+                } else {
+                    func_obj = get_member(context, static_cast<atom::Atom>(flat_program[property].a));
+                }
+            } else {
+                func_obj = execute_flat(first);
+            }
+
+            if (func_obj == nullptr) {
+                return nullptr;
+            }
+
+            if (func_obj.type() == object::Value::Type::Undefined) {
+                if (callee.kind == flat::Kind::IdentifierExpression) {
+                    return throw_not_a_function(atom::to_string(static_cast<atom::Atom>(callee.a)));
+                } else if (callee.kind == flat::Kind::MemberExpression && !(callee.flags & flat::IsComputed)) {
+                    auto object = flat_program[first + 1];
+                    auto property = flat_program[flat_program.next_sibling(first + 1)];
+                    auto property_id = atom::to_string(static_cast<atom::Atom>(property.a));
+                    if (object.kind != flat::Kind::IdentifierExpression) {
+                        return throw_not_a_function(property_id);
+                    }
+
+                    auto object_id = atom::to_string(static_cast<atom::Atom>(object.a));
+                    return throw_not_a_function(object_id + "." + property_id);
+                }
+
+                return throw_not_a_function("expression");
+            }
+
+            std::vector<object::Value> args;
+            auto arg = flat_program.next_sibling(first);
+            for (uint32_t i = 0; i < node.a; i++) {
+                auto value = execute_flat(arg);
+                if (value == nullptr) {
+                    return nullptr;
+                }
+                args.push_back(value);
+                arg = flat_program.next_sibling(arg);
+            }
+
+            return call_function(context, func_obj, args);
+        }
+        case flat::Kind::MemberExpression: {
+            auto obj = execute_flat(first);
+            if (obj == nullptr) {
+                return nullptr;
+            }
+            auto property = flat_program.next_sibling(first);
+
+            if (node.flags & flat::IsComputed) {
+                auto key = execute_flat(property);
+                if (key == nullptr) {
+                    return nullptr;
+                }
+                return get_member(obj, key);
+            }
+
+            return get_member(obj, static_cast<atom::Atom>(flat_program[property].a));
+        }
+        case flat::Kind::VariableDeclarationExpression: {
+            auto value = node.flags & flat::HasOptional ? execute_flat(first) : om.new_undefined();
+            if (value == nullptr) {
+                return nullptr;
+            }
+
+            auto &identifiers = flat_program.names[node.a];
+            for (size_t i = 0; i < identifiers.size(); i++) {
+                set_variable(identifiers[i], flat_program.bindings[node.b + i], value);
+            }
+            return value;
+        }
+        case flat::Kind::AssignmentExpression: {
+            auto left = flat_program[first];
+            auto right = execute_flat(flat_program.next_sibling(first));
+            if (right == nullptr) {
+                return nullptr;
+            }
+
+            if (left.kind == flat::Kind::IdentifierExpression) {
+                return assign_variable(node.op, static_cast<atom::Atom>(left.a), flat_program.bindings[left.b], right);
+            }
+
+            if (left.kind == flat::Kind::MemberExpression) {
+                // TODO: handle arithmetic assignments
+                assert(node.op == ast::Operator::Equals);
+
+                auto object = execute_flat(first + 1);
+                if (object == nullptr) {
+                    return nullptr;
+                }
+                auto property = flat_program.next_sibling(first + 1);
+
+                if (left.flags & flat::IsComputed) {
+                    auto key = execute_flat(property);
+                    if (key == nullptr) {
+                        return nullptr;
+                    }
+                    return set_member(object, key, right);
+                }
+
+                return object.set_property(static_cast<atom::Atom>(flat_program[property].a), right);
+            }
+
+            assert(false);
+        }
+        case flat::Kind::IdentifierExpression: {
+            return get_variable(static_cast<atom::Atom>(node.a), flat_program.bindings[node.b]);
+        }
+        case flat::Kind::NumberLiteralExpression: {
+            return om.new_number(flat_program.numbers[node.a]);
+        }
+        case flat::Kind::StringLiteralExpression: {
+            return om.new_string(flat_program.strings[node.a]);
+        }
+        case flat::Kind::BooleanLiteralExpression: {
+            return om.new_boolean(node.flags & flat::BooleanValue);
+        }
+        case flat::Kind::NullLiteralExpression: {
+            return om.new_null();
+        }
+        case flat::Kind::ObjectExpression: {
+            auto object = om.new_object();
+
+            auto value = first;
+            for (size_t i = 0; i < flat_program.names[node.a].size(); i++) {
+                auto property = execute_flat(value);
+                if (property == nullptr) {
+                    return nullptr;
+                }
+                object.properties()[flat_program.names[node.a][i]] = property;
+                value = flat_program.next_sibling(value);
+            }
+
+            return object;
+        }
+        case flat::Kind::ArrayExpression: {
+            auto array_value = om.new_array();
+            auto array = array_value.array();
+
+            auto element = first;
+            for (uint32_t i = 0; i < node.a; i++) {
+                auto value = execute_flat(element);
+                if (value == nullptr) {
+                    return nullptr;
+                }
+                array->elements.push_back(value);
+                element = flat_program.next_sibling(element);
+            }
+
+            return array_value;
+        }
+        case flat::Kind::FunctionExpression:
+        case flat::Kind::ArrowFunctionExpression: {
+            return new_flat_function({}, flat_program.functions[node.b], first);
+        }
+        case flat::Kind::BinaryExpression: {
+            auto right_result = execute_flat(flat_program.next_sibling(first));
+            if (right_result == nullptr) {
+                return nullptr;
+            }
+            auto left_result = execute_flat(first);
+            if (left_result == nullptr) {
+                return nullptr;
+            }
+
+            return binary_operation(node.op, left_result, right_result);
+        }
+        case flat::Kind::UnaryExpression: {
+            auto argument = execute_flat(first);
+            if (argument == nullptr) {
+                return nullptr;
+            }
+
+            return unary_operation(node.op, argument);
+        }
+        case flat::Kind::UpdateExpression: {
+            auto argument = flat_program[first];
+            assert(argument.kind == flat::Kind::IdentifierExpression);
+            return update_variable(node.op, static_cast<atom::Atom>(argument.a), flat_program.bindings[argument.b],
+                                   node.flags & flat::IsPrefix);
+        }
+        case flat::Kind::TernaryExpression: {
+            auto consequent = flat_program.next_sibling(first);
+
+            auto test = execute_flat(first);
+            if (test == nullptr) {
+                return nullptr;
+            }
+
+            if (test.is_truthy()) {
+                return execute_flat(consequent);
+            } else {
+                return execute_flat(flat_program.next_sibling(consequent));
+            }
+        }
+    }
+
+    std::cerr << "unable to execute flat node kind: " << static_cast<int>(node.kind) << "\n";
+    assert(false);
+}
+
+object::Value Interpreter::execute_bytecode(uint32_t index) {
+    if (profile.has_value()) {
+        return run_bytecode<true>(index);
+    }
+
+    return run_bytecode<false>(index);
+}
+
+// labels as values are a gnu extension, other compilers dispatch with a switch
+#if defined(__GNUC__) && !defined(JS_SWITCH_DISPATCH)
+#define THREADED_DISPATCH
+#endif
+
+template<bool profiling>
+object::Value Interpreter::run_bytecode(uint32_t index) {
+    // chunks are not moved when more are compiled, calls made from here can add some
+    auto code = bytecode_program.chunks[index].code.data();
+    auto r = om.current_frame().locals;
+    uint32_t pc = 0;
+    const bytecode::Instruction* i;
+    std::optional<bytecode::Opcode> previous;
+
+    // the tries entered in this call that have not been left
+    struct Handler {
+        uint32_t target;
+        uint32_t error;
+        // left by the blocks thrown out of
+        object::Environment* environment;
+    };
+    std::vector<Handler> handlers;
+
+#define PROFILE() \
+    if constexpr (profiling) { \
+        if (previous.has_value()) { \
+            profile->record(previous.value(), i->opcode); \
+        } \
+        previous = i->opcode; \
+    }
+
+#ifdef THREADED_DISPATCH
+#define CASE(NAME) op_ ## NAME:
+#define NEXT() \
+    i = &code[pc++]; \
+    PROFILE() \
+    goto *labels[static_cast<uint8_t>(i->opcode)]
+#else
+#define CASE(NAME) case bytecode::Opcode::NAME:
+#define NEXT() continue
+#endif
+
+// continues at the innermost handler if an operation threw
+#define CHECK_EXCEPTION(VALUE) \
+    if ((VALUE) == nullptr) { \
+        goto unwind; \
+    }
+
+#ifdef THREADED_DISPATCH
+#define LABEL_ADDRESS(NAME) &&op_ ## NAME,
+    static void* labels[] = {OPCODES(LABEL_ADDRESS)};
+#undef LABEL_ADDRESS
+    NEXT();
+#else
+    while (true) {
+        i = &code[pc++];
+        PROFILE()
+
+        switch (i->opcode) {
+#endif
+            CASE(LoadNumber)
+                r[i->a] = om.new_number(bytecode_program.numbers[i->b]);
+                NEXT();
+            CASE(LoadString)
+                r[i->a] = om.new_string(bytecode_program.strings[i->b]);
+                NEXT();
+            CASE(LoadBoolean)
+                r[i->a] = om.new_boolean(i->b);
+                NEXT();
+            CASE(LoadNull)
+                r[i->a] = om.new_null();
+                NEXT();
+            CASE(LoadUndefined)
+                r[i->a] = om.new_undefined();
+                NEXT();
+            CASE(LoadThis)
+                r[i->a] = om.current_frame().context;
+                NEXT();
+            CASE(Move)
+                r[i->a] = r[i->b];
+                NEXT();
+            CASE(CheckDefined)
+                if (r[i->a] == nullptr) {
+                    // declared in this function but not reached yet
+                    throw_error("ReferenceError", atom::to_string(static_cast<atom::Atom>(i->b)) +
+                                                  " is not defined\n");
+                    goto unwind;
+                }
+                NEXT();
+            CASE(GetVariable) {
+                auto value = get_variable(static_cast<atom::Atom>(i->c), bytecode_program.bindings[i->b]);
+                CHECK_EXCEPTION(value)
+                r[i->a] = value;
+                NEXT();
+            }
+            CASE(SetVariable)
+                set_variable(static_cast<atom::Atom>(i->c), bytecode_program.bindings[i->b], r[i->a]);
+                NEXT();
+            CASE(GetMember) {
+                auto value = get_member(r[i->b], r[i->c]);
+                CHECK_EXCEPTION(value)
+                r[i->a] = value;
+                NEXT();
+            }
+            CASE(GetNamed) {
+                auto value = get_member(r[i->b], static_cast<atom::Atom>(i->c));
+                CHECK_EXCEPTION(value)
+                r[i->a] = value;
+                NEXT();
+            }
+            CASE(SetMember) {
+                auto value = set_member(r[i->a], r[i->b], r[i->c]);
+                CHECK_EXCEPTION(value)
+                NEXT();
+            }
+            CASE(SetNamed)
+                r[i->a].set_property(static_cast<atom::Atom>(i->b), r[i->c]);
+                NEXT();
+            CASE(NewObject)
+                r[i->a] = om.new_object();
+                NEXT();
+            CASE(InitProperty)
+                r[i->a].properties()[static_cast<atom::Atom>(i->b)] = r[i->c];
+                NEXT();
+            CASE(NewArray)
+                r[i->a] = om.new_array();
+                NEXT();
+            CASE(Append)
+                r[i->a].array()->elements.push_back(r[i->b]);
+                NEXT();
+            CASE(NewFunction)
+                r[i->a] = new_bytecode_function(i->b);
+                NEXT();
+            CASE(Binary) {
+                auto value = binary_operation(i->op, r[i->b], r[i->c]);
+                CHECK_EXCEPTION(value)
+                r[i->a] = value;
+                NEXT();
+            }
+            CASE(Unary) {
+                auto value = unary_operation(i->op, r[i->b]);
+                CHECK_EXCEPTION(value)
+                r[i->a] = value;
+                NEXT();
+            }
+            CASE(Arithmetic) {
+                auto value = arithmetic(i->op, r[i->b], r[i->c]);
+                CHECK_EXCEPTION(value)
+                r[i->a] = value;
+                NEXT();
+            }
+            CASE(Update) {
+                auto old_value = r[i->b];
+                assert(old_value.type() == object::Value::Type::Number);
+                auto delta = i->op == ast::Operator::Increment ? 1 : -1;
+                r[i->b] = om.new_number(old_value.number() + delta);
+                r[i->a] = i->c ? r[i->b] : old_value;
+                NEXT();
+            }
+            CASE(Jump)
+                pc = i->b;
+                NEXT();
+            CASE(JumpIfFalse)
+                if (!r[i->a].is_truthy()) {
+                    pc = i->b;
+                }
+                NEXT();
+            CASE(Call)
+            CASE(CallMethod) {
+                auto callee = r[i->a];
+                if (callee.type() == object::Value::Type::Undefined) {
+                    assert(i->c != bytecode::NoName);
+                    throw_not_a_function(bytecode_program.strings[i->c]);
+                    goto unwind;
+                }
+
+                auto is_method = i->opcode == bytecode::Opcode::CallMethod;
+                auto first = r + i->a + (is_method ? 2 : 1);
+                auto context = is_method ? r[i->a + 1] : om.global_object();
+                auto value = call_function(context, callee, std::vector<object::Value>(first, first + i->b));
+                CHECK_EXCEPTION(value)
+                r[i->a] = value;
+                NEXT();
+            }
+            CASE(New) {
+                auto first = r + i->a + 1;
+                auto value = construct(r[i->a], std::vector<object::Value>(first, first + i->b));
+                CHECK_EXCEPTION(value)
+                r[i->a] = value;
+                NEXT();
+            }
+            CASE(Throw)
+                exception = r[i->a];
+                goto unwind;
+            CASE(EnterTry)
+                handlers.push_back({i->b, i->a, om.current_frame().environment});
+                NEXT();
+            CASE(LeaveTry)
+                handlers.pop_back();
+                NEXT();
+            CASE(EnterBlock)
+                om.push_environment(i->a);
+                NEXT();
+            CASE(LeaveBlock)
+                om.pop_environment();
+                NEXT();
+            CASE(RenewBlock)
+                om.renew_environment();
+                NEXT();
+            CASE(Return)
+                return r[i->a];
+            CASE(ReturnUndefined)
+                return om.new_undefined();
+            CASE(CompareJump) {
+                auto left = r[i->a];
+                auto right = bytecode_program.numbers[i->c];
+                bool result;
+
+                if (left.type() != object::Value::Type::Number) {
+                    auto value = binary_operation(i->op, left, om.new_number(right));
+                    CHECK_EXCEPTION(value)
+                    result = value.is_truthy();
+                } else {
+                    auto number = left.number();
+                    switch (i->op) {
+                        case ast::Operator::EqualTo:
+                        case ast::Operator::EqualToStrict:
+                            result = number == right;
+                            break;
+                        case ast::Operator::NotEqualTo:
+                        case ast::Operator::NotEqualToStrict:
+                            result = number != right;
+                            break;
+                        case ast::Operator::GreaterThan:
+                            result = number > right;
+                            break;
+                        case ast::Operator::GreaterThanOrEqualTo:
+                            result = number >= right;
+                            break;
+                        case ast::Operator::LessThan:
+                            result = number < right;
+                            break;
+                        case ast::Operator::LessThanOrEqualTo:
+                            result = number <= right;
+                            break;
+                        default:
+                            assert(false);
+                    }
+                }
+
+                if (!result) {
+                    pc = i->b;
+                }
+                NEXT();
+            }
+            CASE(UpdateLocal) {
+                auto value = r[i->a];
+                assert(value.type() == object::Value::Type::Number);
+                auto delta = i->op == ast::Operator::Increment ? 1 : -1;
+                r[i->a] = om.new_number(value.number() + delta);
+                NEXT();
+            }
+            CASE(CallNamed) {
+                auto &method = bytecode_program.methods[i->c];
+                auto callee = get_member(r[i->a + 1], method.property);
+                CHECK_EXCEPTION(callee)
+                if (callee.type() == object::Value::Type::Undefined) {
+                    assert(method.name != bytecode::NoName);
+                    throw_not_a_function(bytecode_program.strings[method.name]);
+                    goto unwind;
+                }
+
+                auto first = r + i->a + 2;
+                auto value = call_function(r[i->a + 1], callee, std::vector<object::Value>(first, first + i->b));
+                CHECK_EXCEPTION(value)
+                r[i->a] = value;
+                NEXT();
+            }
+            unwind: {
+                // calls return with a pending exception, so the frames they pushed are gone
+                if (handlers.empty()) {
+                    return nullptr;
+                }
+
+                auto handler = handlers.back();
+                handlers.pop_back();
+                om.current_frame().environment = handler.environment;
+                r[handler.error] = catch_exception();
+                pc = handler.target;
+                NEXT();
+            }
+#ifndef THREADED_DISPATCH
+        }
+    }
+#endif
+
+#undef PROFILE
+#undef CHECK_EXCEPTION
+#undef CASE
+#undef NEXT
+}
+
+object::Value Interpreter::construct(object::Value constructor, std::vector<object::Value> args) {
+    assert(constructor.type() == object::Value::Type::Function);
+
+    auto instance = om.new_object();
+
+    auto prototype = constructor.get_property(om, atom::Prototype);
+    assert(prototype.has_value());
+    instance.set_property(atom::Proto, prototype.value());
+
+    auto result = call_function(instance, constructor, args);
+    if (result == nullptr) {
+        return nullptr;
+    }
+
+    if (!result.is_undefined()) {
+        return result;
+    }
+
+    return instance;
+}
+
+object::Value Interpreter::get_member(object::Value object, object::Value key) {
+    std::optional<object::Value> property;
+
+    if (key.type() == object::Value::Type::Number) {
+        property = object.get_property(om, key.number());
+    } else {
+        assert(key.type() == object::Value::Type::String);
+        property = object.get_property(om, atom::intern(key.string()));
+    }
+
+    if (property.has_value()) {
+        return property.value();
+    }
+
+    return om.new_undefined();
+}
+
+object::Value Interpreter::get_member(object::Value object, atom::Atom name) {
+    auto property = object.get_property(om, name);
+
+    if (property.has_value()) {
+        return property.value();
+    }
+
+    return om.new_undefined();
+}
+
+object::Value Interpreter::set_member(object::Value object, object::Value key, object::Value value) {
+    if (key.type() == object::Value::Type::Number) {
+        object.set_property(key.number(), value);
+        return key;
+    }
+
+    if (key.type() == object::Value::Type::String) {
+        object.set_property(atom::intern(key.string()), value);
+        return key;
+    }
+
+    assert(false);
+}
+
+object::Value Interpreter::assign_variable(ast::Operator op, atom::Atom name, const ast::Binding &binding,
+                                           object::Value right) {
+    if (op == ast::Operator::Equals) {
+        return set_variable(name, binding, right);
+    }
+
+    auto left = get_variable(name, binding);
+    if (left == nullptr) {
+        return nullptr;
+    }
+
+    return set_variable(name, binding, arithmetic(op, left, right));
+}
+
+// the numbers of an assignment like +=
+object::Value Interpreter::arithmetic(ast::Operator op, object::Value left, object::Value right) {
+    auto left_number = left.number();
+    auto right_number = right.number();
+
+    switch (op) {
+        case ast::Operator::AdditionAssignment:
+            return om.new_number(left_number + right_number);
+        case ast::Operator::SubtractionAssignment:
+            return om.new_number(left_number - right_number);
+        case ast::Operator::MultiplicationAssignment:
+            return om.new_number(left_number * right_number);
+        case ast::Operator::DivisionAssignment:
+            return om.new_number(left_number / right_number);
+        default:
+            assert(false);
+    }
+}
+
+object::Value Interpreter::update_variable(ast::Operator op, atom::Atom name, const ast::Binding &binding,
+                                           bool is_prefix) {
+    assert(op == ast::Operator::Increment || op == ast::Operator::Decrement);
+
+    auto value_object = get_variable(name, binding);
+    if (value_object == nullptr) {
+        return nullptr;
+    }
+    assert(value_object.type() == object::Value::Type::Number);
+    auto new_value = op == ast::Operator::Increment ? value_object.number() + 1 : value_object.number() - 1;
+
+    set_variable(name, binding, om.new_number(new_value));
+
+    return om.new_number(is_prefix ? new_value : value_object.number());
+}
+
+object::Value Interpreter::unary_operation(ast::Operator op, object::Value argument) {
+    switch (op) {
+        case ast::Operator::Not:
+            return om.new_boolean(!argument.is_truthy());
+        case ast::Operator::Typeof:
+            return om.new_string(argument.type_of());
+        default:
+            assert(false);
+    }
+}
+
+object::Value Interpreter::binary_operation(ast::Operator op, object::Value left_result, object::Value right_result) {
+    switch (left_result.type()) {
+        case object::Value::Type::Number: {
+            switch (op) {
+                case ast::Operator::Plus: {
+                    if (right_result.type() == object::Value::Type::String) {
+                        return om.new_string(left_result.to_string() + right_result.string());
+                    }
+
+                    assert(right_result.type() == object::Value::Type::Number);
+                    return om.new_number(left_result.number() + right_result.number());
+                }
+                case ast::Operator::Minus: {
+                    assert(right_result.type() == object::Value::Type::Number);
+                    return om.new_number(left_result.number() - right_result.number());
+                }
+                case ast::Operator::Multiply: {
+                    assert(right_result.type() == object::Value::Type::Number);
+                    return om.new_number(left_result.number() * right_result.number());
+                }
+                case ast::Operator::Divide: {
+                    assert(right_result.type() == object::Value::Type::Number);
+                    return om.new_number(left_result.number() / right_result.number());
+                }
+                case ast::Operator::Modulo: {
+                    assert(right_result.type() == object::Value::Type::Number);
+                    return om.new_number(std::fmod(left_result.number(), right_result.number()));
+                }
+                case ast::Operator::Exponentiation: {
+                    assert(right_result.type() == object::Value::Type::Number);
+                    return om.new_number(std::pow(left_result.number(), right_result.number()));
+                }
+                case ast::Operator::EqualTo: {
+                    if (right_result.type() == object::Value::Type::Number) {
+                        return om.new_boolean(left_result.number() == right_result.number());
+                    }
+
+                    // TODO: this should attempt conversion to number for non number values
+                    return om.new_boolean(false);
+                }
+                case ast::Operator::EqualToStrict: {
+                    if (right_result.type() == object::Value::Type::Number) {
+                        return om.new_boolean(left_result.number() == right_result.number());
+                    }
+
+                    return om.new_boolean(false);
+                }
+                case ast::Operator::And: {
+                    return om.new_boolean(left_result.is_truthy() && right_result.is_truthy());
+                }
+                case ast::Operator::Or: {
+                    return om.new_boolean(left_result.is_truthy() || right_result.is_truthy());
+                }
+                case ast::Operator::NotEqualTo: {
+                    assert(right_result.type() == object::Value::Type::Number);
+                    return om.new_boolean(left_result.number() != right_result.number());
+                }
+                case ast::Operator::NotEqualToStrict: {
+                    assert(right_result.type() == object::Value::Type::Number);
+                    return om.new_boolean(left_result.number() != right_result.number());
+                }
+                case ast::Operator::GreaterThan: {
+                    assert(right_result.type() == object::Value::Type::Number);
+                    return om.new_boolean(left_result.number() > right_result.number());
+                }
+                case ast::Operator::GreaterThanOrEqualTo: {
+                    assert(right_result.type() == object::Value::Type::Number);
+                    return om.new_boolean(left_result.number() >= right_result.number());
+                }
+                case ast::Operator::LessThan: {
+                    assert(right_result.type() == object::Value::Type::Number);
+                    return om.new_boolean(left_result.number() < right_result.number());
+                }
+                case ast::Operator::LessThanOrEqualTo: {
+                    assert(right_result.type() == object::Value::Type::Number);
+                    return om.new_boolean(left_result.number() <= right_result.number());
+                }
+                case ast::Operator::BitwiseAnd: {
+                    auto left_int = static_cast<int>(left_result.number());
+                    auto right_int = static_cast<int>(right_result.number());
+                    return om.new_number(left_int & right_int);
+                }
+                case ast::Operator::BitwiseOr: {
+                    auto left_int = static_cast<int>(left_result.number());
+                    auto right_int = static_cast<int>(right_result.number());
+                    return om.new_number(left_int | right_int);
+                }
+                case ast::Operator::Equals:
+                case ast::Operator::AdditionAssignment:
+                case ast::Operator::SubtractionAssignment:
+                case ast::Operator::MultiplicationAssignment:
+                case ast::Operator::DivisionAssignment:
+                case ast::Operator::Increment:
+                case ast::Operator::Decrement:
+                case ast::Operator::Not:
+                case ast::Operator::Typeof: {
+                    assert(false);
+                }
             }
 
-            return om.new_undefined();
+            assert(false);
         }
-        case ast::StatementType::FunctionDeclaration: {
-            auto s = statement->as_function_declaration();
-
-            auto func_value = om.new_function(s->identifier);
-            auto func = func_value->function();
-            func->is_builtin = false;
-            func->parameters = s->parameters;
-            func->body = s->body;
+        case object::Value::Type::String: {
+            if (op == ast::Operator::Plus) {
+                if (right_result.type() == object::Value::Type::String) {
+                    return om.new_string(left_result.string() + right_result.string());
+                }
 
-            return declare_variable(s->identifier, func_value);
+                return om.new_string(left_result.string() + right_result.to_string());
+            }
+            // intentionally fall through here
         }
-        case ast::StatementType::Return: {
-            auto s = statement->as_return();
+        case object::Value::Type::Object:
+        case object::Value::Type::Array:
+        case object::Value::Type::Function:
+        case object::Value::Type::Undefined:
+        case object::Value::Type::Null:
+        case object::Value::Type::Boolean: {
+            switch (op) {
+                case ast::Operator::EqualTo: {
+                    return om.new_boolean(left_result.is_truthy() == right_result.is_truthy());
+                }
+                case ast::Operator::EqualToStrict: {
+                    return om.new_boolean(left_result.is_truthy() == right_result.is_truthy());
+                }
+                case ast::Operator::And: {
+                    return om.new_boolean(left_result.is_truthy() && right_result.is_truthy());
+                }
+                case ast::Operator::Or: {
+                    return om.new_boolean(left_result.is_truthy() || right_result.is_truthy());
+                }
+                case ast::Operator::NotEqualTo: {
+                    return om.new_boolean(left_result.is_truthy() != right_result.is_truthy());
+                }
+                case ast::Operator::NotEqualToStrict: {
+                    return om.new_boolean(left_result.is_truthy() != right_result.is_truthy());
+                }
+                case ast::Operator::GreaterThan: {
+                    return om.new_boolean(left_result.is_truthy() > right_result.is_truthy());
+                }
+                case ast::Operator::GreaterThanOrEqualTo: {
+                    return om.new_boolean(left_result.is_truthy() >= right_result.is_truthy());
+                }
+                case ast::Operator::LessThan: {
+                    return om.new_boolean(left_result.is_truthy() < right_result.is_truthy());
+                }
+                case ast::Operator::LessThanOrEqualTo: {
+                    return om.new_boolean(left_result.is_truthy() <= right_result.is_truthy());
+                }
+                case ast::Operator::Plus:
+                    if (right_result.type() == object::Value::Type::String) {
+                        return om.new_string(left_result.to_string() + right_result.string());
+                    }
 
-            if (!s->argument.has_value()) {
-                throw Return{om.new_undefined()};
+                    return om.new_string(left_result.to_string() + right_result.to_string());
+                case ast::Operator::BitwiseAnd:
+                case ast::Operator::BitwiseOr:
+                case ast::Operator::Minus:
+                case ast::Operator::Multiply:
+                case ast::Operator::Divide:
+                case ast::Operator::Modulo:
+                case ast::Operator::Equals:
+                case ast::Operator::AdditionAssignment:
+                case ast::Operator::SubtractionAssignment:
+                case ast::Operator::MultiplicationAssignment:
+                case ast::Operator::DivisionAssignment:
+                case ast::Operator::Increment:
+                case ast::Operator::Decrement:
+                case ast::Operator::Exponentiation:
+                case ast::Operator::Not:
+                case ast::Operator::Typeof: {
+                    assert(false);
+                }
             }
-
-            auto value = execute(s->argument.value());
-            throw Return{value};
         }
     }
 
-    std::cerr << "unable to execute statement type:" << statement->to_json()["type"] << "\n";
     assert(false);
 }
 
-object::Value* Interpreter::execute(std::shared_ptr<ast::Expression> expression) {
-    switch (expression->type) {
-        case ast::ExpressionType::New: {
-            auto e = expression->as_new();
-            auto constructor = execute(e->callee);
-            assert(constructor->type == object::Value::Type::Function);
+object::Value
+Interpreter::call_function(object::Value context, object::Value func_value, std::vector<object::Value> args) {
+    assert(func_value.type() == object::Value::Type::Function);
 
-            auto instance = om.new_object();
+    auto func = func_value.function();
 
-            auto prototype = constructor->get_property(om, "prototype");
-            assert(prototype.has_value());
-            instance->set_property("__proto__", prototype.value());
+    if (func->is_builtin) {
+        return func->builtin_func(context, args);
+    }
 
-            std::vector<object::Value*> args;
-            for (auto arg: e->arguments) {
-                args.push_back(execute(arg));
-            }
+    // the scope of a lazily parsed body only knows its parameters until it is parsed
+    if (func->flat_body.has_value() && flat_program[func->flat_body.value()].kind == flat::Kind::LazyBlockStatement) {
+        auto body = func->flat_body.value();
+        func->flat_body = flat_program.encode_lazy(body, parse_lazy_body(flat_program.lazy_body(body), func->scope));
+    } else if (func->body != nullptr && func->body->type == ast::ASTNodeType::Statement &&
+               static_cast<ast::Statement*>(func->body)->type == ast::StatementType::LazyBlock) {
+        func->body = parse_lazy_body(static_cast<ast::Statement*>(func->body)->as_lazy_block(), func->scope);
+    }
 
-            auto result = call_function(instance, constructor, args);
-            if (!result->is_undefined()) {
-                return result;
+    auto scope = func->scope;
+    auto size = scope->frame_size;
+
+    // registers for temporaries follow the locals
+    std::optional<uint32_t> chunk;
+    if (func->bytecode_function.has_value()) {
+        auto index = func->bytecode_function.value();
+        chunk = bytecode_program.functions[index].chunk;
+        if (!chunk.has_value()) {
+            auto body = bytecode_program.functions[index].body;
+            if (body->type == ast::ASTNodeType::Statement &&
+                static_cast<ast::Statement*>(body)->type == ast::StatementType::LazyBlock) {
+                body = parse_lazy_body(static_cast<ast::Statement*>(body)->as_lazy_block(), scope);
             }
-
-            return instance;
+            chunk = bytecode_program.compile_function(index, body);
         }
+        size = bytecode_program.chunks[chunk.value()].registers;
+    }
 
-        case ast::ExpressionType::This: {
-            return om.current_scope()->this_context();
+    auto frame = om.push_frame(context, size, scope->environment_size, func->environment);
+    if (frame == nullptr) {
+        return throw_error("RangeError", "Maximum call stack size exceeded");
+    }
+
+    auto locals = frame->locals;
+    for (size_t i = 0; i < func->parameters.size(); i++) {
+        auto value = i < args.size() ? args[i] : om.new_undefined();
+        auto &variable = scope->variables[scope->parameters[i]];
+        if (variable.captured) {
+            frame->environment->slots[variable.slot] = value;
+        } else {
+            locals[variable.slot] = value;
         }
-        case ast::ExpressionType::Call: {
-            auto e = expression->as_call();
+    }
 
-            auto func_obj = execute(e->callee);
-            if (func_obj->type == object::Value::Type::Undefined) {
-                if (e->callee->type == ast::ExpressionType::Identifier) {
-                    auto callee = e->callee->as_identifier();
-                    throw_error("TypeError", callee->name + " is not a function");
-                } else if (e->callee->type == ast::ExpressionType::Member) {
-                    auto callee = e->callee->as_member();
-                    assert(callee->object->type == ast::ExpressionType::Identifier);
-                    assert(callee->property->type == ast::ExpressionType::Identifier);
-                    assert(callee->is_computed == false);
+    if (scope->arguments_slot.has_value()) {
+        auto arguments_object = om.new_array();
 
-                    auto object_id = callee->object->as_identifier()->name;
-                    auto property_id = callee->property->as_identifier()->name;
-                    throw_error("TypeError", object_id + "." + property_id + " is not a function");
-                }
+        for (auto arg: args) {
+            arguments_object.array()->elements.push_back(arg);
+        }
 
-                assert(false);
-            }
+        locals[scope->arguments_slot.value()] = arguments_object;
+    }
 
-            std::vector<object::Value*> args;
+    auto return_value = om.new_undefined();
 
-            for (auto arg: e->arguments) {
-                args.push_back(execute(arg));
+    if (chunk.has_value()) {
+        return_value = execute_bytecode(chunk.value());
+    } else if (func->flat_body.has_value()) {
+        auto body = func->flat_body.value();
+        if (flat::is_statement(flat_program[body].kind)) {
+            auto completion = execute_flat_statement(body);
+            if (completion.type == Completion::Type::Return) {
+                return_value = completion.value;
+            } else if (completion.type == Completion::Type::Throw) {
+                return_value = nullptr;
             }
+        } else {
+            return_value = execute_flat(body);
+        }
+    } else if (func->body->type == ast::ASTNodeType::Statement) {
+        auto completion = execute(static_cast<ast::Statement*>(func->body));
+        if (completion.type == Completion::Type::Return) {
+            return_value = completion.value;
+        } else if (completion.type == Completion::Type::Throw) {
+            return_value = nullptr;
+        }
+    } else {
+        return_value = execute(static_cast<ast::Expression*>(func->body));
+    }
 
-            if (e->callee->type == ast::ExpressionType::Member) {
-                auto object = execute(e->callee->as_member()->object);
-                return call_function(object, func_obj, args);
-            }
+    om.pop_frame();
 
-            return call_function(om.global_object(), func_obj, args);
-        }
-        case ast::ExpressionType::Member: {
-            auto e = expression->as_member();
-            auto obj = execute(e->object);
+    return return_value;
+}
 
-            if (e->is_computed) {
-                std::optional<object::Value*> property;
-                auto right = execute(e->property);
+object::Value Interpreter::throw_not_a_function(const std::string &callee) {
+    return throw_error("TypeError", callee + " is not a function");
+}
 
-                if (right->type == object::Value::Type::Number) {
-                    property = obj->get_property(om, right->number());
-                } else {
-                    assert(right->type == object::Value::Type::String);
-                    property = obj->get_property(om, right->string());
-                }
+object::Value Interpreter::throw_error(std::string error_type, std::string message) {
+    auto error_constructor_value = get_variable(atom::intern(error_type));
+    auto error_instance = call_function(om.new_object(), error_constructor_value, {om.new_string(message)});
 
-                if (property.has_value()) {
-                    return property.value();
-                }
+    auto prototype = error_constructor_value.get_property(om, atom::Prototype);
+    assert(prototype.has_value());
+    error_instance.set_property(atom::Proto, prototype.value());
 
-                return om.new_undefined();
-            } else {
-                auto right = e->property->as_identifier();
+    exception = error_instance;
+    return nullptr;
+}
 
-                auto property = obj->get_property(om, right->name);
+object::Value Interpreter::catch_exception() {
+    assert(exception != nullptr);
+    auto error = exception;
+    exception = nullptr;
+    return error;
+}
 
-                if (property.has_value()) {
-                    return property.value();
-                }
+object::Value Interpreter::new_function(std::optional<atom::Atom> name, const std::vector<atom::Atom> &parameters,
+                                        ast::ASTNode* body, ast::Scope* scope) {
+    auto func_value = om.new_function(name);
+    auto func = func_value.function();
+    func->is_builtin = false;
+    func->parameters = parameters;
+    func->body = body;
+    func->scope = scope;
+    func->environment = current_environment();
+    return func_value;
+}
 
-                return om.new_undefined();
-            }
+object::Value Interpreter::new_flat_function(std::optional<atom::Atom> name, const flat::Function &function,
+                                             uint32_t body) {
+    auto func_value = om.new_function(name);
+    auto func = func_value.function();
+    func->is_builtin = false;
+    func->parameters = function.parameters;
+    func->flat_body = body;
+    func->scope = function.scope;
+    func->environment = current_environment();
+    return func_value;
+}
 
-            assert(false);
+object::Value Interpreter::new_bytecode_function(uint32_t function) {
+    auto &f = bytecode_program.functions[function];
+    auto func_value = om.new_function(f.name);
+    auto func = func_value.function();
+    func->is_builtin = false;
+    func->parameters = f.parameters;
+    func->bytecode_function = function;
+    func->scope = f.scope;
+    func->environment = current_environment();
+    return func_value;
+}
+
+ast::BlockStatement* Interpreter::parse_lazy_body(ast::LazyBlockStatement* body, ast::Scope* scope) {
+    if (body->block == nullptr) {
+        lazy_parser.parse_lazy_body(body, nodes);
+        if (optimizations.fold_constants || optimizations.inline_budget > 0) {
+            folder.fold_body(body);
         }
-        case ast::ExpressionType::VariableDeclaration: {
-            auto e = expression->as_variable_declaration();
-            object::Value* value = e->value.has_value() ? execute(e->value.value()) : om.new_undefined();
-            for (auto id: e->identifiers) {
-                declare_variable(id, value);
-            }
-            return value;
+        if (optimizations.shake_tree) {
+            ast::Statement* block = body->block;
+            shaker.eliminate_dead_code(block);
         }
-        case ast::ExpressionType::Assignment: {
-            auto e = expression->as_assignment();
+        resolver.resolve_body(body->block, scope);
+    }
 
-            auto right = execute(e->right);
+    return body->block;
+}
 
-            if (e->left->type == ast::ExpressionType::Identifier) {
-                auto left = e->left->as_identifier();
-                auto right = execute(e->right);
+// a dead branch at the top level is replaced
+void Interpreter::optimize_top_level(ast::Statement* &statement) {
+    if (optimizations.fold_constants || optimizations.inline_budget > 0) {
+        folder.fold_top_level(statement);
+    }
+    if (optimizations.shake_tree) {
+        shaker.eliminate_dead_code(statement);
+    }
+}
 
-                if (e->op == ast::Operator::Equals) {
-                    return set_variable(left->name, right);
-                }
+void Interpreter::resolve_top_level(ast::Statement* statement) {
+    resolver.resolve_top_level(statement);
 
-                auto left_number = get_variable(left->name)->number();
-                auto right_number = right->number();
+    // catch clauses at the top level can add slots to the top level frame
+    if (om.global_frame().environment->slots.size() < resolver.top_level->environment_size) {
+        om.resize_global_environment(resolver.top_level->environment_size);
+    }
+}
 
-                auto result = om.new_number(0);
+void Interpreter::execute_top_level(ast::Statement* statement) {
+    if (engine == Engine::Flat) {
+        execute_flat_statement(flat_program.encode(statement));
+        return;
+    }
 
-                switch (e->op) {
-                    case ast::Operator::AdditionAssignment:
-                        result->value = left_number + right_number;
-                        break;
-                    case ast::Operator::SubtractionAssignment:
-                        result->value = left_number - right_number;
-                        break;
-                    case ast::Operator::MultiplicationAssignment:
-                        result->value = left_number * right_number;
-                        break;
-                    case ast::Operator::DivisionAssignment:
-                        result->value = left_number / right_number;
-                        break;
-                    default:
-                        assert(false);
-                }
+    if (engine == Engine::Bytecode) {
+        // the temporaries of a top level statement get a frame that sees the top level variables
+        auto chunk = bytecode_program.compile(statement);
+        auto frame = om.push_frame(om.global_object(), bytecode_program.chunks[chunk].registers, 0, nullptr);
+        if (frame == nullptr) {
+            throw_error("RangeError", "Maximum call stack size exceeded");
+            return;
+        }
+        frame->environment = om.global_frame().environment;
 
-                return set_variable(left->name, result);
-            }
+        execute_bytecode(chunk);
+        om.pop_frame();
+        return;
+    }
 
-            if (e->left->type == ast::ExpressionType::Member) {
-                // TODO: handle arithmetic assignments
-                assert(e->op == ast::Operator::Equals);
+    execute(statement);
+}
 
-                auto left = e->left->as_member();
+void Interpreter::hoist(ast::Statement* statement) {
+    if (statement->type != ast::StatementType::FunctionDeclaration) {
+        return;
+    }
 
-                if (left->is_computed) {
-                    auto object = execute(left->object);
+    auto s = statement->as_function_declaration();
 
-                    auto property = execute(left->property);
-                    if (property->type == object::Value::Type::Number) {
-                        object->set_property(property->number(), right);
-                        return property;
-                    }
+    object::Value func_value;
+    if (engine == Engine::Flat) {
+        // the body record directly follows the declaration's
+        auto root = flat_program.encode(statement);
+        func_value = new_flat_function(s->identifier, flat_program.functions[flat_program[root].b], root + 1);
+    } else if (engine == Engine::Bytecode) {
+        func_value = new_bytecode_function(
+                bytecode_program.add_function(s->identifier, s->parameters, s->scope, s->body));
+    } else {
+        func_value = new_function(s->identifier, s->parameters, s->body, s->scope);
+    }
 
-                    if (property->type == object::Value::Type::String) {
-                        object->set_property(property->string(), right);
-                        return property;
-                    }
+    // reading ahead can happen inside a call, hoisted functions always belong to the top level
+    func_value.function()->environment = om.global_frame().environment;
+    om.set_variable(s->identifier, func_value);
+    hoisted.insert(statement);
+}
 
-                    assert(false);
-                } else {
-                    auto object = execute(left->object);
-                    auto property = left->property->as_identifier();
-                    return object->set_property(property->name, right);
-                }
-            }
+bool Interpreter::hoist_from_read_ahead(atom::Atom name) {
+    if (!statement_source) {
+        return false;
+    }
 
-            assert(false);
-        }
-        case ast::ExpressionType::Identifier: {
-            return get_variable(expression->as_identifier()->name);
-        }
-        case ast::ExpressionType::NumberLiteral: {
-            return om.new_number(expression->as_number_literal()->value);
-        }
-        case ast::ExpressionType::StringLiteral: {
-            return om.new_string(expression->as_string_literal()->value);
-        }
-        case ast::ExpressionType::BooleanLiteral: {
-            return om.new_boolean(expression->as_boolean_literal()->value);
-        }
-        case ast::ExpressionType::NullLiteral: {
-            return om.new_null();
+    while (auto s = statement_source()) {
+        optimize_top_level(s);
+        resolve_top_level(s);
+        read_ahead.push_back(s);
+        hoist(s);
+
+        if (s->type == ast::StatementType::FunctionDeclaration &&
+            s->as_function_declaration()->identifier == name) {
+            return true;
         }
-        case ast::ExpressionType::Object: {
-            auto e = expression->as_object();
-            auto object = om.new_object();
+    }
 
-            for (auto p: e->properties) {
-                object->properties[p.first] = execute(p.second);
-            }
+    return false;
+}
 
-            return object;
-        }
-        case ast::ExpressionType::Array: {
-            auto e = expression->as_array();
-            auto array_value = om.new_array();
-            auto array = array_value->array();
+void Interpreter::report_uncaught_error() {
+    auto error = catch_exception();
+    auto error_to_string = error.get_property(om, atom::ToString);
+    auto string_value = call_function(error, error_to_string.value(), {});
+    std::cerr << string_value.string() << "\n";
+}
 
-            for (auto e: e->elements) {
-                array->elements.push_back(execute(e));
-            }
+void Interpreter::run(ast::Program &program) {
+    // a stream is never seen whole, so its top level consts are not propagated
+    if (optimizations.fold_constants || optimizations.inline_budget > 0) {
+        folder.see_program(program.body);
+    }
 
-            return array_value;
-        }
-        case ast::ExpressionType::Function: {
-            auto e = expression->as_function();
+    for (auto &s: program.body) {
+        optimize_top_level(s);
+    }
 
-            auto func_value = om.new_function();
-            auto func = func_value->function();
-            func->is_builtin = false;
-            func->parameters = e->parameters;
-            func->body = e->body;
+    // only the whole program shows which functions are never used
+    if (optimizations.shake_tree) {
+        shaker.shake(program.body);
+    }
 
-            return func_value;
-        }
-        case ast::ExpressionType::ArrowFunction: {
-            auto e = expression->as_arrow_function();
+    for (auto s: program.body) {
+        resolve_top_level(s);
+    }
 
-            auto func_value = om.new_function();
-            auto func = func_value->function();
-            func->is_builtin = false;
-            func->parameters = e->parameters;
-            func->body = e->body;
+    for (auto s: program.body) {
+        hoist(s);
+    }
 
-            return func_value;
+    for (auto s: program.body) {
+        if (!hoisted.contains(s)) {
+            execute_top_level(s);
         }
-        case ast::ExpressionType::Binary: {
-            auto e = expression->as_binary();
 
-            auto right_result = execute(e->right);
-            auto left_result = execute(e->left);
+        if (exception != nullptr) {
+            report_uncaught_error();
+            break;
+        }
+    }
 
-            switch (left_result->type) {
-                case object::Value::Type::Number: {
-                    switch (e->op) {
-                        case ast::Operator::Plus: {
-                            if (right_result->type == object::Value::Type::String) {
-                                return om.new_string(left_result->to_string() + right_result->string());
-                            }
-
-                            assert(right_result->type == object::Value::Type::Number);
-                            return om.new_number(left_result->number() + right_result->number());
-                        }
-                        case ast::Operator::Minus: {
-                            assert(right_result->type == object::Value::Type::Number);
-                            return om.new_number(left_result->number() - right_result->number());
-                        }
-                        case ast::Operator::Multiply: {
-                            assert(right_result->type == object::Value::Type::Number);
-                            return om.new_number(left_result->number() * right_result->number());
-                        }
-                        case ast::Operator::Divide: {
-                            assert(right_result->type == object::Value::Type::Number);
-                            return om.new_number(left_result->number() / right_result->number());
-                        }
-                        case ast::Operator::Modulo: {
-                            assert(right_result->type == object::Value::Type::Number);
-                            return om.new_number(std::fmod(left_result->number(), right_result->number()));
-                        }
-                        case ast::Operator::Exponentiation: {
-                            assert(right_result->type == object::Value::Type::Number);
-                            return om.new_number(std::powf(left_result->number(), right_result->number()));
-                        }
-                        case ast::Operator::EqualTo: {
-                            if (right_result->type == object::Value::Type::Number) {
-                                return om.new_boolean(left_result->number() == right_result->number());
-                            }
-
-                            // TODO: this should attempt conversion to number for non number values
-                            return om.new_boolean(false);
-                        }
-                        case ast::Operator::EqualToStrict: {
-                            if (right_result->type == object::Value::Type::Number) {
-                                return om.new_boolean(left_result->number() == right_result->number());
-                            }
-
-                            return om.new_boolean(false);
-                        }
-                        case ast::Operator::And: {
-                            return om.new_boolean(left_result->is_truthy() && right_result->is_truthy());
-                        }
-                        case ast::Operator::Or: {
-                            return om.new_boolean(left_result->is_truthy() || right_result->is_truthy());
-                        }
-                        case ast::Operator::NotEqualTo: {
-                            assert(right_result->type == object::Value::Type::Number);
-                            return om.new_boolean(left_result->number() != right_result->number());
-                        }
-                        case ast::Operator::NotEqualToStrict: {
-                            assert(right_result->type == object::Value::Type::Number);
-                            return om.new_boolean(left_result->number() != right_result->number());
-                        }
-                        case ast::Operator::GreaterThan: {
-                            assert(right_result->type == object::Value::Type::Number);
-                            return om.new_boolean(left_result->number() > right_result->number());
-                        }
-                        case ast::Operator::GreaterThanOrEqualTo: {
-                            assert(right_result->type == object::Value::Type::Number);
-                            return om.new_boolean(left_result->number() >= right_result->number());
-                        }
-                        case ast::Operator::LessThan: {
-                            assert(right_result->type == object::Value::Type::Number);
-                            return om.new_boolean(left_result->number() < right_result->number());
-                        }
-                        case ast::Operator::LessThanOrEqualTo: {
-                            assert(right_result->type == object::Value::Type::Number);
-                            return om.new_boolean(left_result->number() <= right_result->number());
-                        }
-                        case ast::Operator::BitwiseAnd: {
-                            auto left_int = static_cast<int>(left_result->number());
-                            auto right_int = static_cast<int>(right_result->number());
-                            return om.new_number(left_int & right_int);
-                        }
-                        case ast::Operator::BitwiseOr: {
-                            auto left_int = static_cast<int>(left_result->number());
-                            auto right_int = static_cast<int>(right_result->number());
-                            return om.new_number(left_int | right_int);
-                        }
-                        case ast::Operator::Equals:
-                        case ast::Operator::AdditionAssignment:
-                        case ast::Operator::SubtractionAssignment:
-                        case ast::Operator::MultiplicationAssignment:
-                        case ast::Operator::DivisionAssignment:
-                        case ast::Operator::Increment:
-                        case ast::Operator::Decrement:
-                        case ast::Operator::Not:
-                        case ast::Operator::Typeof: {
-                            assert(false);
-                        }
-                    }
+    if (optimizations.report) {
+        shaker.report.print(std::cerr);
+    }
+    if (profile.has_value()) {
+        profile->print(std::cerr, 20);
+    }
 
-                    assert(false);
-                }
-                case object::Value::Type::String: {
-                    if (e->op == ast::Operator::Plus) {
-                        if (right_result->type == object::Value::Type::String) {
-                            return om.new_string(left_result->string() + right_result->string());
-                        }
+    hoisted.clear();
+}
 
-                        return om.new_string(left_result->string() + right_result->to_string());
-                    }
-                    // intentionally fall through here
-                }
-                case object::Value::Type::Object:
-                case object::Value::Type::Array:
-                case object::Value::Type::Function:
-                case object::Value::Type::Undefined:
-                case object::Value::Type::Null:
-                case object::Value::Type::Boolean: {
-                    switch (e->op) {
-                        case ast::Operator::EqualTo: {
-                            return om.new_boolean(left_result->is_truthy() == right_result->is_truthy());
-                        }
-                        case ast::Operator::EqualToStrict: {
-                            return om.new_boolean(left_result->is_truthy() == right_result->is_truthy());
-                        }
-                        case ast::Operator::And: {
-                            return om.new_boolean(left_result->is_truthy() && right_result->is_truthy());
-                        }
-                        case ast::Operator::Or: {
-                            return om.new_boolean(left_result->is_truthy() || right_result->is_truthy());
-                        }
-                        case ast::Operator::NotEqualTo: {
-                            return om.new_boolean(left_result->is_truthy() != right_result->is_truthy());
-                        }
-                        case ast::Operator::NotEqualToStrict: {
-                            return om.new_boolean(left_result->is_truthy() != right_result->is_truthy());
-                        }
-                        case ast::Operator::GreaterThan: {
-                            return om.new_boolean(left_result->is_truthy() > right_result->is_truthy());
-                        }
-                        case ast::Operator::GreaterThanOrEqualTo: {
-                            return om.new_boolean(left_result->is_truthy() >= right_result->is_truthy());
-                        }
-                        case ast::Operator::LessThan: {
-                            return om.new_boolean(left_result->is_truthy() < right_result->is_truthy());
-                        }
-                        case ast::Operator::LessThanOrEqualTo: {
-                            return om.new_boolean(left_result->is_truthy() <= right_result->is_truthy());
-                        }
-                        case ast::Operator::Plus:
-                            if (right_result->type == object::Value::Type::String) {
-                                return om.new_string(left_result->to_string() + right_result->string());
-                            }
-
-                            return om.new_string(left_result->to_string() + right_result->to_string());
-                        case ast::Operator::BitwiseAnd:
-                        case ast::Operator::BitwiseOr:
-                        case ast::Operator::Minus:
-                        case ast::Operator::Multiply:
-                        case ast::Operator::Divide:
-                        case ast::Operator::Modulo:
-                        case ast::Operator::Equals:
-                        case ast::Operator::AdditionAssignment:
-                        case ast::Operator::SubtractionAssignment:
-                        case ast::Operator::MultiplicationAssignment:
-                        case ast::Operator::DivisionAssignment:
-                        case ast::Operator::Increment:
-                        case ast::Operator::Decrement:
-                        case ast::Operator::Exponentiation:
-                        case ast::Operator::Not:
-                        case ast::Operator::Typeof: {
-                            assert(false);
-                        }
-                    }
-                }
-            }
+void Interpreter::run(StatementSource next_statement) {
+    statement_source = next_statement;
 
-            assert(false);
-        }
-        case ast::ExpressionType::Unary: {
-            auto e = expression->as_unary();
-            switch (e->op) {
-                case ast::Operator::Not:
-                    return om.new_boolean(!execute(e->argument)->is_truthy());
-                case ast::Operator::Typeof: {
-                    auto result = execute(e->argument);
-                    return om.new_string(result->type_of());
-                }
-                default:
-                    assert(false);
+    while (true) {
+        ast::Statement* s = nullptr;
+        if (!read_ahead.empty()) {
+            s = read_ahead.front();
+            read_ahead.pop_front();
+        } else {
+            s = statement_source();
+            if (s != nullptr) {
+                optimize_top_level(s);
+                resolve_top_level(s);
             }
-
         }
-        case ast::ExpressionType::Update: {
-            auto e = expression->as_update();
-            assert(e->op == ast::Operator::Increment || e->op == ast::Operator::Decrement);
-            assert(e->argument->type == ast::ExpressionType::Identifier);
 
-            auto identifier = e->argument->as_identifier();
-            auto value_object = get_variable(identifier->name);
-            assert(value_object->type == object::Value::Type::Number);
-            auto new_value =
-                    e->op == ast::Operator::Increment ? value_object->number() + 1 : value_object->number() - 1;
-
-            set_variable(identifier->name, om.new_number(new_value));
+        if (s == nullptr) {
+            break;
+        }
 
-            return om.new_number(e->is_prefix ? new_value : value_object->number());
+        if (hoisted.erase(s) == 0) {
+            execute_top_level(s);
         }
-        case ast::ExpressionType::Ternary: {
-            auto e = expression->as_ternary();
 
-            if (execute(e->test)->is_truthy()) {
-                return execute(e->consequent);
-            } else {
-                return execute(e->alternative);
-            }
+        if (exception != nullptr) {
+            report_uncaught_error();
+            break;
         }
     }
 
-    std::cerr << "unable to execute expression type: " << expression->to_json()["type"]
-              << "\n";
-    assert(false);
-}
-
-object::Value*
-Interpreter::call_function(object::Value* context, object::Value* func_value, std::vector<object::Value*> args) {
-    assert(func_value->type == object::Value::Type::Function);
-
-    auto func = func_value->function();
-
-    if (func->is_builtin) {
-        return func->builtin_func(context, args);
+    if (optimizations.report) {
+        shaker.report.print(std::cerr);
     }
-
-    // construct "arguments" object
-    om.push_scope(context);
-    auto arguments_object = om.new_array();
-
-    for (auto arg: args) {
-        arguments_object->array()->elements.push_back(arg);
+    if (profile.has_value()) {
+        profile->print(std::cerr, 20);
     }
 
-    set_variable("arguments", arguments_object);
+    statement_source = nullptr;
+    read_ahead.clear();
+}
 
-    // assign arguments to function parameters
-    for (auto i = 0; i < func->parameters.size(); i++) {
-        auto has_arg = i < args.size();
-        auto value = has_arg ? args[i] : om.new_undefined();
-        set_variable(func->parameters[i], value);
+object::Value &Interpreter::slot(const ast::Binding &binding) {
+    auto &frame = om.current_frame();
+    if (binding.kind == ast::Binding::Kind::Local) {
+        return frame.locals[binding.slot];
     }
 
-    auto return_value = om.new_undefined();
-
-    if (func->body->type == ast::ASTNodeType::Statement) {
-        try {
-            execute(std::static_pointer_cast<ast::Statement>(func->body));
-        } catch (Return ret) {
-            return_value = ret.value;
-        }
-    } else {
-        return_value = execute(std::static_pointer_cast<ast::Expression>(func->body));
+    auto environment = frame.environment != nullptr ? frame.environment : frame.outer;
+    for (uint16_t i = 0; i < binding.hops; i++) {
+        environment = environment->parent;
     }
 
-    om.pop_scope();
-
-    return return_value;
+    return environment->slots[binding.slot];
 }
 
-void Interpreter::throw_error(std::string error_type, std::string message) {
-    auto error_constructor_value = get_variable(error_type);
-    auto error_instance = call_function(om.new_object(), error_constructor_value, {om.new_string(message)});
-
-    auto prototype = error_constructor_value->get_property(om, "prototype");
-    assert(prototype.has_value());
-    error_instance->set_property("__proto__", prototype.value());
-
-    throw error_instance;
+// functions created here see the variables captured in this call and the calls around it
+object::Environment* Interpreter::current_environment() {
+    auto &frame = om.current_frame();
+    return frame.environment != nullptr ? frame.environment : frame.outer;
 }
 
-void Interpreter::run(ast::Program &program) {
-    try {
-        for (auto s: program.body) {
-            execute(s);
+object::Value Interpreter::get_variable(atom::Atom name, const ast::Binding &binding) {
+    if (binding.kind != ast::Binding::Kind::Global) {
+        auto value = slot(binding);
+        if (value == nullptr) {
+            // declared in this function but not reached yet
+            return throw_error("ReferenceError", atom::to_string(name) + " is not defined\n");
         }
+
+        return value;
     }
-    catch (object::Value* error) {
-        auto error_to_string = error->get_property(om, "toString");
-        auto string_value = call_function(error, error_to_string.value(), {});
-        std::cerr << string_value->string() << "\n";
-        return;
-    }
-}
 
-object::Value* Interpreter::get_variable(std::string name) {
     auto v = om.get_variable(name);
+    if (!v.has_value() && hoist_from_read_ahead(name)) {
+        v = om.get_variable(name);
+    }
+
     if (!v.has_value()) {
-        throw_error("ReferenceError", name + " is not defined\n");
-        assert(false);
+        return throw_error("ReferenceError", atom::to_string(name) + " is not defined\n");
     }
 
     return v.value();
 }
 
-object::Value* Interpreter::declare_variable(std::string name, object::Value* value) {
-    return om.set_variable(name, value);
-}
+object::Value Interpreter::set_variable(atom::Atom name, const ast::Binding &binding, object::Value value) {
+    if (binding.kind != ast::Binding::Kind::Global) {
+        return slot(binding) = value;
+    }
 
-object::Value* Interpreter::set_variable(std::string name, object::Value* value) {
     return om.set_variable(name, value);
 }
 
@@ -646,45 +1852,43 @@ void Interpreter::create_builtin_objects() {
 
     // Built in prototypes
     auto object_prototype = om.new_object();
-    auto proto = new object::Value{};
-    proto->type = object::Value::Type::Undefined;
-    object_prototype->set_property("__proto__", proto);
-    global->set_property("Object", object_prototype);
-    global->set_property("String", om.new_object());
-    global->set_property("Number", om.new_object());
-    global->set_property("Boolean", om.new_object());
-    object_prototype->register_native_method(om, "toString", [&](object::Value* value, std::vector<object::Value*>) {
-        return om.new_string(value->to_string());
+    object_prototype.set_property(atom::Proto, om.new_undefined());
+    global.set_property(atom::Object, object_prototype);
+    global.set_property(atom::String, om.new_object());
+    global.set_property(atom::Number, om.new_object());
+    global.set_property(atom::Boolean, om.new_object());
+    object_prototype.register_native_method(om, "toString", [&](object::Value value, std::vector<object::Value>) {
+        return om.new_string(value.to_string());
     });
 
-    global->set_property("undefined", om.new_undefined());
+    global.set_property(atom::intern("undefined"), om.new_undefined());
 
     // built in functions
-    global->register_native_method(om, "parseInt", [&](object::Value*, std::vector<object::Value*> args) {
+    global.register_native_method(om, "parseInt", [&](object::Value, std::vector<object::Value> args) {
         auto num_arg = args[0];
 
         std::string input;
-        if (num_arg->type != object::Value::Type::String) {
-            input = num_arg->to_string();
+        if (num_arg.type() != object::Value::Type::String) {
+            input = num_arg.to_string();
         } else {
-            input = num_arg->string();
+            input = num_arg.string();
         }
 
         auto radix = 10;
         if (args.size() > 1) {
-            radix = args[1]->number();
+            radix = args[1].number();
         }
         auto result = std::stoi(input, nullptr, radix);
         return om.new_number(result);
     });
 
-    global->register_native_method(om, "parseFloat", [&](object::Value*, std::vector<object::Value*> args) {
+    global.register_native_method(om, "parseFloat", [&](object::Value, std::vector<object::Value> args) {
         auto num_arg = args[0];
         std::string input;
-        if (num_arg->type != object::Value::Type::String) {
-            input = num_arg->to_string();
+        if (num_arg.type() != object::Value::Type::String) {
+            input = num_arg.to_string();
         } else {
-            input = num_arg->string();
+            input = num_arg.string();
         }
 
         return om.new_number(std::stof(input));
@@ -692,13 +1896,13 @@ void Interpreter::create_builtin_objects() {
 
     // console
     auto console = om.new_object();
-    om.global_object()->set_property("console", console);
+    om.global_object().set_property(atom::intern("console"), console);
 
-    console->register_native_method(om, "log", [&](object::Value*, std::vector<object::Value*> args) {
+    console.register_native_method(om, "log", [&](object::Value, std::vector<object::Value> args) {
         std::string out;
 
         for (auto arg: args) {
-            out += arg->to_json().dump(4) + " ";
+            out += arg.to_json().dump(4) + " ";
         }
 
         std::cout << out << "\n";
@@ -708,35 +1912,35 @@ void Interpreter::create_builtin_objects() {
 
     // Math
     auto Math = om.new_object();
-    om.global_object()->set_property("Math", Math);
-    Math->register_native_method(om, "abs", [&](object::Value*, std::vector<object::Value*> args) {
-        return om.new_number(std::fabs(args[0]->number()));
+    om.global_object().set_property(atom::intern("Math"), Math);
+    Math.register_native_method(om, "abs", [&](object::Value, std::vector<object::Value> args) {
+        return om.new_number(std::fabs(args[0].number()));
     });
-    Math->register_native_method(om, "round", [&](object::Value*, std::vector<object::Value*> args) {
-        return om.new_number(std::roundf(args[0]->number()));
+    Math.register_native_method(om, "round", [&](object::Value, std::vector<object::Value> args) {
+        return om.new_number(std::roundf(args[0].number()));
     });
-    Math->register_native_method(om, "sqrt", [&](object::Value*, std::vector<object::Value*> args) {
-        return om.new_number(std::sqrtf(args[0]->number()));
+    Math.register_native_method(om, "sqrt", [&](object::Value, std::vector<object::Value> args) {
+        return om.new_number(std::sqrt(args[0].number()));
     });
 
     // Array
-    auto array_constructor_handler = [&](object::Value* context, std::vector<object::Value*> args) {
+    auto array_constructor_handler = [&](object::Value context, std::vector<object::Value> args) {
         if (args.size() == 0) {
             return om.new_array();
         }
 
-        auto length = args[0]->number();
+        auto length = args[0].number();
         return om.new_array(length);
     };
-    auto Array = global->register_native_method(om, "Array", array_constructor_handler);
+    auto Array = global.register_native_method(om, "Array", array_constructor_handler);
 
-    Array->register_native_method(om, "fill", [&](object::Value* context, std::vector<object::Value*> args) {
+    Array.register_native_method(om, "fill", [&](object::Value context, std::vector<object::Value> args) {
         auto value = om.new_undefined();
         if (args.size() > 0) {
             value = args[0];
         }
 
-        auto array = context->array();
+        auto array = context.array();
         for (auto &el: array->elements) {
             el = value;
         }
@@ -744,45 +1948,49 @@ void Interpreter::create_builtin_objects() {
         return context;
     });
 
-    Array->register_native_method(om, "from", [&](object::Value* context, std::vector<object::Value*> args) {
-        if (args.size() == 0 || args[0]->type != object::Value::Type::Array) {
-            throw_error("TypeError", args[0]->to_string() + " is not iterable");
+    Array.register_native_method(om, "from", [&](object::Value context,
+                                                  std::vector<object::Value> args) -> object::Value {
+        if (args.size() == 0 || args[0].type() != object::Value::Type::Array) {
+            return throw_error("TypeError", args[0].to_string() + " is not iterable");
         }
 
-        std::optional<object::Value*> map_func;
+        std::optional<object::Value> map_func;
         if (args.size() > 1) {
             map_func = args[1];
         }
 
-        auto old_array = args[0]->array();
+        auto old_array = args[0].array();
         auto new_array = om.new_array();
 
         for (auto &el: old_array->elements) {
             if (map_func.has_value()) {
                 auto mapped = call_function(context, map_func.value(), {el});
-                new_array->array()->elements.push_back(mapped);
+                if (mapped == nullptr) {
+                    return nullptr;
+                }
+                new_array.array()->elements.push_back(mapped);
             } else {
-                new_array->array()->elements.push_back(el);
+                new_array.array()->elements.push_back(el);
             }
         }
 
         return new_array;
     });
 
-    Array->register_native_method(om, "push", [&](object::Value* context, std::vector<object::Value*> args) {
-        auto array = context->array();
+    Array.register_native_method(om, "push", [&](object::Value context, std::vector<object::Value> args) {
+        auto array = context.array();
 
         for (auto arg: args) {
             array->elements.push_back(arg);
         }
 
-        auto length = context->get_property(om, "length");
+        auto length = context.get_property(om, atom::Length);
         assert(length.has_value());
         return length.value();
     });
 
-    Array->register_native_method(om, "pop", [&](object::Value* context, std::vector<object::Value*> args) {
-        auto array = context->array();
+    Array.register_native_method(om, "pop", [&](object::Value context, std::vector<object::Value> args) {
+        auto array = context.array();
 
         if (array->elements.size() == 0) {
             return om.new_undefined();
@@ -793,45 +2001,56 @@ void Interpreter::create_builtin_objects() {
         return value;
     });
 
-    Array->register_native_method(om, "forEach", [&](object::Value* context, std::vector<object::Value*> args) {
-        auto caller_obj = context->array();
+    Array.register_native_method(om, "forEach", [&](object::Value context,
+                                                     std::vector<object::Value> args) -> object::Value {
+        auto caller_obj = context.array();
         auto callback = args[0];
 
         for (auto i = 0; i < caller_obj->elements.size(); i++) {
-            auto args = std::vector<object::Value*>{caller_obj->elements[i], om.new_number(i)};
-            call_function(context, callback, args);
+            auto args = std::vector<object::Value>{caller_obj->elements[i], om.new_number(i)};
+            if (call_function(context, callback, args) == nullptr) {
+                return nullptr;
+            }
         }
 
         return om.new_undefined();
     });
 
-    Array->register_native_method(om, "map", [&](object::Value* context, std::vector<object::Value*> args) {
-        auto caller_obj = context->array();
+    Array.register_native_method(om, "map", [&](object::Value context,
+                                                 std::vector<object::Value> args) -> object::Value {
+        auto caller_obj = context.array();
         auto callback = args[0];
 
         auto result_value = om.new_array();
-        auto result = result_value->array();
+        auto result = result_value.array();
 
         for (auto i = 0; i < caller_obj->elements.size(); i++) {
-            auto args = std::vector<object::Value*>{caller_obj->elements[i], om.new_number(i)};
+            auto args = std::vector<object::Value>{caller_obj->elements[i], om.new_number(i)};
             auto v = call_function(context, callback, args);
+            if (v == nullptr) {
+                return nullptr;
+            }
             result->elements.push_back(v);
         }
 
         return result_value;
     });
 
-    Array->register_native_method(om, "filter", [&](object::Value* context, std::vector<object::Value*> args) {
-        auto caller_obj = context->array();
+    Array.register_native_method(om, "filter", [&](object::Value context,
+                                                    std::vector<object::Value> args) -> object::Value {
+        auto caller_obj = context.array();
         auto callback = args[0];
 
         auto result_value = om.new_array();
-        auto result = result_value->array();
+        auto result = result_value.array();
 
         for (auto i = 0; i < caller_obj->elements.size(); i++) {
-            auto args = std::vector<object::Value*>{caller_obj->elements[i], om.new_number(i)};
+            auto args = std::vector<object::Value>{caller_obj->elements[i], om.new_number(i)};
             auto v = call_function(context, callback, args);
-            if (v->is_truthy()) {
+            if (v == nullptr) {
+                return nullptr;
+            }
+            if (v.is_truthy()) {
                 result->elements.push_back(v);
             }
         }
@@ -839,62 +2058,72 @@ void Interpreter::create_builtin_objects() {
         return result_value;
     });
 
-    Array->register_native_method(om, "reduce", [&](object::Value* context, std::vector<object::Value*> args) {
-        auto caller_obj = context->array();
+    Array.register_native_method(om, "reduce", [&](object::Value context,
+                                                    std::vector<object::Value> args) -> object::Value {
+        auto caller_obj = context.array();
         auto callback = args[0];
         auto initial_value = args[1];
 
         auto prev = initial_value;
 
         for (auto i = 0; i < caller_obj->elements.size(); i++) {
-            auto args = std::vector<object::Value*>{prev, caller_obj->elements[i], om.new_number(i)};
+            auto args = std::vector<object::Value>{prev, caller_obj->elements[i], om.new_number(i)};
             prev = call_function(context, callback, args);
+            if (prev == nullptr) {
+                return nullptr;
+            }
         }
 
         return prev;
     });
 
     // Error
-    auto error_constructor_handler = [&](object::Value* context, std::vector<object::Value*> args) {
+    auto error_constructor_handler = [&](object::Value context, std::vector<object::Value> args) {
         auto message = args.size() > 0 ? args[0] : om.new_undefined();
-        context->set_property("message", message);
-        context->set_property("name", om.new_string("Error"));
+        context.set_property(atom::Message, message);
+        context.set_property(atom::Name, om.new_string("Error"));
         return context;
     };
 
-    auto error_constructor = global->register_native_method(om, "Error", error_constructor_handler);
-    auto error_constructor_prototype = error_constructor->get_property(om, "prototype");
+    auto error_constructor = global.register_native_method(om, "Error", error_constructor_handler);
+    auto error_constructor_prototype = error_constructor.get_property(om, atom::Prototype);
     assert(error_constructor_prototype.has_value());
 
-    auto error_constructor_to_string_handler = [&](object::Value* context, std::vector<object::Value*>) {
-        auto name = context->get_property(om, "name");
+    auto error_constructor_to_string_handler = [&](object::Value context, std::vector<object::Value>) {
+        auto name = context.get_property(om, atom::Name);
         assert(name.has_value());
-        auto message = context->get_property(om, "message");
+        auto message = context.get_property(om, atom::Message);
         assert(message.has_value());
-        if (message.value()->is_undefined()) {
-            return om.new_string(name.value()->string() + ": undefined\n");
+        if (message.value().is_undefined()) {
+            return om.new_string(name.value().string() + ": undefined\n");
         }
 
-        return om.new_string(name.value()->string() + ": " + message.value()->string());
+        return om.new_string(name.value().string() + ": " + message.value().string());
     };
-    error_constructor_prototype.value()->register_native_method(om, "toString", error_constructor_to_string_handler);
+    error_constructor_prototype.value().register_native_method(om, "toString", error_constructor_to_string_handler);
 
 
-    std::vector<std::string> builtin_error_names{"ReferenceError", "TypeError"};
+    std::vector<std::string> builtin_error_names{"ReferenceError", "TypeError", "RangeError"};
 
     for (auto name: builtin_error_names) {
-        auto handler = [&](object::Value* context, std::vector<object::Value*> args) {
-            context->set_property("message", args[0]);
-            context->set_property("name", om.new_string(name));
+        auto handler = [&, name](object::Value context, std::vector<object::Value> args) {
+            context.set_property(atom::Message, args[0]);
+            context.set_property(atom::Name, om.new_string(name));
             return context;
         };
 
-        auto reference_error_constructor = global->register_native_method(om, name, handler);
-        reference_error_constructor->set_property("prototype", error_constructor_prototype.value());
+        auto reference_error_constructor = global.register_native_method(om, name, handler);
+        reference_error_constructor.set_property(atom::Prototype, error_constructor_prototype.value());
     }
 }
 
-Interpreter::Interpreter() {
+void Interpreter::profile_opcodes() {
+    profile.emplace();
+}
+
+Interpreter::Interpreter(Engine engine, Optimizations optimizations) : engine(engine), optimizations(optimizations) {
+    folder.fold_literals = optimizations.fold_constants;
+    folder.inline_budget = optimizations.inline_budget;
     create_builtin_objects();
 }
 
@@ -1,33 +1,140 @@
 #pragma once
 
+#include <deque>
+#include <functional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "ast.h"
+#include "bytecode.h"
+#include "flat.h"
 #include "object.h"
+#include "optimizer.h"
+#include "parser.h"
+#include "resolver.h"
 
 namespace interpreter {
 
+// passes run over the ast before it is resolved. tree shaking only removes
+// unused functions when the whole program is run at once
+struct Optimizations {
+    bool fold_constants = true;
+    bool shake_tree = true;
+    // the most ast nodes a function can return to be inlined, 0 turns it off
+    uint32_t inline_budget = 16;
+    // prints what tree shaking removed once the program has run
+    bool report = false;
+};
+
 class Interpreter {
-    struct Return {
-        object::Value* value;
+public:
+    // Tree walks the ast nodes, Flat walks the pre-order records of flat::Program,
+    // Bytecode runs the register code of bytecode::Program
+    enum class Engine {
+        Tree,
+        Flat,
+        Bytecode
+    };
+
+    // yields the top level statements of a program in order, nullptr once
+    // there are no more
+    using StatementSource = std::function<ast::Statement*()>;
+
+private:
+    // how a statement finished, a return carries its value out to the call. a
+    // throw leaves the thrown value in `exception`
+    struct Completion {
+        enum class Type {
+            Normal,
+            Return,
+            Break,
+            Continue,
+            Throw
+        };
+
+        Type type = Type::Normal;
+        object::Value value = nullptr;
     };
 
     object::ObjectManager om;
+    Engine engine;
+    // the value being thrown, from the throw until a catch clause takes it.
+    // functions that can throw return nullptr while it is set
+    object::Value exception = nullptr;
+    Optimizations optimizations;
+    // top level statements are appended as they are run by the flat engine
+    flat::Program flat_program;
+    // top level statements and functions are compiled as they are first run by the bytecode engine
+    bytecode::Program bytecode_program;
+    std::optional<bytecode::Profile> profile;
+    // scopes, and function bodies that were only pre-parsed, which are parsed
+    // when they are first called
+    ast::Arena nodes;
+    parser::Parser lazy_parser{true};
+    resolver::Resolver resolver{nodes};
+    optimizer::ConstantFolder folder{nodes};
+    optimizer::TreeShaker shaker{nodes};
+
+    // top level statements read past the one being executed while looking
+    // for a function declaration to hoist
+    StatementSource statement_source;
+    std::deque<ast::Statement*> read_ahead;
+    std::unordered_set<ast::Statement*> hoisted;
+
+    object::Value new_function(std::optional<atom::Atom> name, const std::vector<atom::Atom> &parameters,
+                               ast::ASTNode* body, ast::Scope* scope);
+    object::Value new_flat_function(std::optional<atom::Atom> name, const flat::Function &function, uint32_t body);
+    object::Value new_bytecode_function(uint32_t function);
+    ast::BlockStatement* parse_lazy_body(ast::LazyBlockStatement* body, ast::Scope* scope);
+    void optimize_top_level(ast::Statement* &statement);
+    void resolve_top_level(ast::Statement* statement);
+    void execute_top_level(ast::Statement* statement);
+    void hoist(ast::Statement* statement);
+    bool hoist_from_read_ahead(atom::Atom name);
+    void report_uncaught_error();
+
+    // names are only used for globals and errors, locals are found by their binding
+    object::Value &slot(const ast::Binding &binding);
+    object::Environment* current_environment();
+    object::Value get_variable(atom::Atom name, const ast::Binding &binding = {});
+    object::Value set_variable(atom::Atom name, const ast::Binding &binding, object::Value value);
 
-    object::Value* get_variable(std::string name);
-    object::Value* set_variable(std::string name, object::Value* value);
-    object::Value* declare_variable(std::string name, object::Value* value);
+    object::Value call_function(object::Value caller, object::Value func_value, std::vector<object::Value> args);
+    Completion execute(ast::Statement* statement);
+    object::Value execute(ast::Expression* expression);
+    Completion execute_flat_statement(uint32_t index);
+    object::Value execute_flat(uint32_t index);
+    object::Value execute_bytecode(uint32_t chunk);
+    template<bool profiling>
+    object::Value run_bytecode(uint32_t chunk);
 
-    object::Value* call_function(object::Value* caller, object::Value* func_value, std::vector<object::Value*> args);
-    object::Value* execute(std::shared_ptr<ast::Statement> statement);
-    object::Value* execute(std::shared_ptr<ast::Expression> expression);
-    void throw_error(std::string type, std::string message);
+    // semantics shared by the engines
+    object::Value construct(object::Value constructor, std::vector<object::Value> args);
+    object::Value get_member(object::Value object, object::Value key);
+    object::Value get_member(object::Value object, atom::Atom name);
+    object::Value set_member(object::Value object, object::Value key, object::Value value);
+    object::Value assign_variable(ast::Operator op, atom::Atom name, const ast::Binding &binding,
+                                  object::Value right);
+    object::Value arithmetic(ast::Operator op, object::Value left, object::Value right);
+    object::Value update_variable(ast::Operator op, atom::Atom name, const ast::Binding &binding, bool is_prefix);
+    object::Value unary_operation(ast::Operator op, object::Value argument);
+    object::Value binary_operation(ast::Operator op, object::Value left, object::Value right);
+    // set the exception and return nullptr for the caller to return
+    object::Value throw_not_a_function(const std::string &callee);
+    object::Value throw_error(std::string type, std::string message);
+    object::Value catch_exception();
 
     void create_builtin_objects();
 public:
-    Interpreter();
+    Interpreter(Engine engine = Engine::Tree, Optimizations optimizations = {});
     void run(ast::Program &program);
+    // runs each statement as soon as it is produced, declarations later in
+    // the program are hoisted by reading ahead when a name is not found
+    void run(StatementSource next_statement);
+    // counts which opcodes the bytecode engine runs after each other and
+    // prints the most frequent pairs once a program has run
+    void profile_opcodes();
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+let lateName = null;
+try {
+  readLate();
+} catch (e) {
+  lateName = e.name;
+}
+const late = 5;
+function readLate() {
+  return late;
+}
+
+section("constant expressions", (test) => {
+  test("numbers concatenated to strings print as at runtime", () => {
+    const n = 2;
+    const folded = "v" + 2;
+    const unfolded = "v" + n * [1][0];
+    assert(folded === unfolded, "expected: " + unfolded + ", got: " + folded);
+  });
+
+  test("consts are seen by functions created after them", () => {
+    const scale = 60 * 60;
+    const hours = (n) => n * scale;
+    const result = hours(2);
+    assert(result === 7200, "expected: 7200, got: " + result);
+  });
+
+  test("parameters hide consts of the same name", () => {
+    const value = 1;
+    const identity = (value) => value;
+    const result = identity(5);
+    assert(result === 5, "expected: 5, got: " + result);
+  });
+
+  test("catch parameters hide consts of the same name", () => {
+    const e = "const";
+    let result;
+    try {
+      throw "thrown";
+    } catch (e) {
+      result = e;
+    }
+    assert(result === "thrown", "expected: thrown, got: " + result);
+  });
+
+  test("conditionals with a constant test pick a branch", () => {
+    const debug = 0;
+    const result = debug ? "debug" : "release";
+    assert(result === "release", "expected: release, got: " + result);
+  });
+
+  test("hoisted functions called before a const do not see it", () => {
+    assert(lateName === "ReferenceError", "expected: ReferenceError, got: " + lateName);
+
+    let name = null;
+    try {
+      read();
+    } catch (e) {
+      name = e.name;
+    }
+    const value = 5;
+    function read() {
+      return value;
+    }
+    assert(name === "ReferenceError", "expected: ReferenceError, got: " + name);
+  });
+
+  test("a const in a block is not propagated past the block", () => {
+    const limit = 1;
+    let inner;
+    {
+      const limit = 2;
+      inner = () => limit;
+    }
+    const result = limit * 10 + inner();
+    assert(result === 12, "expected: 12, got: " + result);
+  });
+});
@@ -0,0 +1,107 @@
+section("exceptions", (test) => {
+  test("throws are caught through calls", () => {
+    const fail = (value) => {
+      throw value;
+    };
+    const call = (value) => fail(value) + 1;
+    let caught = null;
+    try {
+      call("error");
+    } catch (e) {
+      caught = e;
+    }
+    assert(caught === "error", "expected: error, got: " + caught);
+  });
+
+  test("errors of the engine are caught", () => {
+    let name = null;
+    try {
+      missing();
+    } catch (e) {
+      name = e.name;
+    }
+    assert(name === "ReferenceError", "expected: ReferenceError, got: " + name);
+
+    const object = {};
+    try {
+      object.method();
+    } catch (e) {
+      name = e.name;
+    }
+    assert(name === "TypeError", "expected: TypeError, got: " + name);
+
+    name = null;
+    try {
+      [object][0].method();
+    } catch (e) {
+      name = e.name;
+    }
+    assert(name === "TypeError", "expected: TypeError, got: " + name);
+
+    name = null;
+    try {
+      object["method"]();
+    } catch (e) {
+      name = e.name;
+    }
+    assert(name === "TypeError", "expected: TypeError, got: " + name);
+  });
+
+  test("throws leave library callbacks", () => {
+    let caught = 0;
+    try {
+      [1, 2, 3].map((x) => {
+        if (x === 2) {
+          throw x;
+        }
+        return x;
+      });
+    } catch (e) {
+      caught = e;
+    }
+    assert(caught === 2, "expected: 2, got: " + caught);
+  });
+
+  test("catch clauses can throw again", () => {
+    let caught = null;
+    try {
+      try {
+        throw "inner";
+      } catch (e) {
+        throw e + "outer";
+      }
+    } catch (e) {
+      caught = e;
+    }
+    assert(caught === "innerouter", "expected: innerouter, got: " + caught);
+  });
+
+  test("a throw in a loop ends it", () => {
+    let count = 0;
+    try {
+      for (let i = 0; i < 10; i++) {
+        count++;
+        if (i === 3) {
+          throw i;
+        }
+      }
+    } catch (e) {
+      count += e;
+    }
+    assert(count === 7, "expected: 7, got: " + count);
+  });
+
+  test("code after a try that caught runs", () => {
+    let errors = 0;
+    for (let i = 0; i < 100; i++) {
+      try {
+        if (i % 2 === 0) {
+          throw i;
+        }
+      } catch (e) {
+        errors++;
+      }
+    }
+    assert(errors === 50, "expected: 50, got: " + errors);
+  });
+});
@@ -1,3 +1,8 @@
+function reachedByKey() {
+  return "reached";
+}
+const keyOfReached = "reachedByKey";
+
 section("functions", (test) => {
   test("function returns expected value", () => {
     function func() {
@@ -20,4 +25,27 @@ section("functions", (test) => {
 
     func(1, 2, 3);
   });
+
+  test("top level function only reached through a computed key", () => {
+    const result = this[keyOfReached]();
+    assert(result === "reached", "expected: reached, got: " + result);
+  });
+
+  test("the receiver of a method call is evaluated once", () => {
+    let calls = 0;
+    const target = {
+      m: function () {
+        return this === target;
+      },
+    };
+    const o = {
+      get: () => {
+        calls++;
+        return target;
+      },
+    };
+    const result = o.get().m();
+    assert(result === true, "expected: true, got: " + result);
+    assert(calls === 1, "expected: 1, got: " + calls);
+  });
 });
@@ -0,0 +1,16 @@
+declaredLater.marked = true;
+
+section("hoisting", (test) => {
+  test("top level function can be called before its declaration", () => {
+    const result = declaredLater(2);
+    assert(result === 42, "expected: 42, got: " + result);
+  });
+
+  test("hoisted function is not redeclared when reached", () => {
+    assert(declaredLater.marked === true, "expected the hoisted function object");
+  });
+});
+
+function declaredLater(n) {
+  return 21 * n;
+}
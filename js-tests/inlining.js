@@ -0,0 +1,73 @@
+section("inlining", (test) => {
+  test("small const functions give the same result inlined", () => {
+    const add = (a, b) => a + b;
+    let sum = 0;
+    for (let i = 0; i < 5; i++) {
+      sum = add(sum, i);
+    }
+    assert(sum === 10, "expected: 10, got: " + sum);
+  });
+
+  test("parameters used more than once read the argument once", () => {
+    const square = function (x) {
+      return x * x;
+    };
+    const side = 3;
+    let n = side + 1;
+    const result = square(n);
+    assert(result === 16, "expected: 16, got: " + result);
+  });
+
+  test("recursive functions are still called", () => {
+    const fact = (n) => (n < 2 ? 1 : n * fact(n - 1));
+    const result = fact(5);
+    assert(result === 120, "expected: 120, got: " + result);
+  });
+
+  test("arguments are evaluated once", () => {
+    const twice = (x) => x + x;
+    let calls = 0;
+    const next = () => {
+      calls++;
+      return calls;
+    };
+    const result = twice(next());
+    assert(result === 2, "expected: 2, got: " + result);
+    assert(calls === 1, "expected: 1, got: " + calls);
+  });
+
+  test("members and calls on parameters", () => {
+    const first = (list) => list[0];
+    const size = (list) => list.length;
+    const apply = (f, x) => f(x);
+    const list = [4, 5];
+    const result = first(list) + size(list) + apply(first, list);
+    assert(result === 10, "expected: 10, got: " + result);
+  });
+
+  test("arguments for unused parameters are still evaluated", () => {
+    const first = (a, b) => a;
+    let name = null;
+    try {
+      first(1, undefinedName);
+    } catch (e) {
+      name = e.name;
+    }
+    assert(name === "ReferenceError", "expected: ReferenceError, got: " + name);
+  });
+
+  test("arguments are read before the body calls anything", () => {
+    let n = 1;
+    const bump = () => {
+      n = 10;
+      return 0;
+    };
+    const before = (a, f) => a + f();
+    const twice = (a, f) => a + f() + a;
+    const result = before(n, bump);
+    assert(result === 1, "expected: 1, got: " + result);
+    n = 1;
+    const again = twice(n, bump);
+    assert(again === 2, "expected: 2, got: " + again);
+  });
+});
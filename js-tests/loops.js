@@ -0,0 +1,88 @@
+section("loops", (test) => {
+  test("break ends the innermost loop", () => {
+    let count = 0;
+    for (let i = 0; i < 3; i++) {
+      let j = 0;
+      while (true) {
+        if (j === 2) {
+          break;
+        }
+        j++;
+        count++;
+      }
+    }
+    assert(count === 6, "expected: 6, got: " + count);
+  });
+
+  test("continue runs the update of a for loop", () => {
+    let sum = 0;
+    for (let i = 0; i < 10; i++) {
+      if (i % 2 === 0) {
+        continue;
+      }
+      sum += i;
+    }
+    assert(sum === 25, "expected: 25, got: " + sum);
+  });
+
+  test("continue tests a while loop again", () => {
+    let i = 0;
+    let odd = 0;
+    while (i < 5) {
+      i++;
+      if (i % 2 === 0) continue;
+      odd++;
+    }
+    assert(odd === 3, "expected: 3, got: " + odd);
+  });
+
+  test("break and continue leave a try inside the loop", () => {
+    let caught = 0;
+    let i = 0;
+    while (true) {
+      i++;
+      try {
+        if (i === 2) continue;
+        if (i === 4) break;
+      } catch (e) {
+        caught++;
+      }
+    }
+    try {
+      throw "after";
+    } catch (e) {
+      caught++;
+    }
+    assert(i === 4, "expected: 4, got: " + i);
+    assert(caught === 1, "expected: 1, got: " + caught);
+  });
+
+  test("return from inside a loop", () => {
+    const find = (list, value) => {
+      for (let i = 0; i < list.length; i++) {
+        while (true) {
+          if (list[i] === value) {
+            return i;
+          }
+          break;
+        }
+      }
+      return null;
+    };
+    assert(find([3, 4, 5], 5) === 2, "expected: 2");
+    assert(find([3, 4, 5], 6) === null, "expected: null");
+  });
+
+  test("return from a catch", () => {
+    const f = () => {
+      try {
+        throw "error";
+      } catch (e) {
+        return e;
+      }
+      return "after";
+    };
+    const result = f();
+    assert(result === "error", "expected: error, got: " + result);
+  });
+});
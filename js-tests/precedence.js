@@ -0,0 +1,34 @@
+section("operator precedence", (test) => {
+  test("multiplication binds tighter than addition", () => {
+    const result = 2 * 3 + 1;
+    assert(result === 7, "expected: 7, got: " + result);
+  });
+
+  test("subtraction is left associative", () => {
+    const result = 10 - 4 - 3;
+    assert(result === 3, "expected: 3, got: " + result);
+  });
+
+  test("exponentiation is right associative", () => {
+    const result = 2 ** 3 ** 2;
+    assert(result === 512, "expected: 512, got: " + result);
+  });
+
+  test("conditional binds looser than comparison", () => {
+    const result = 1 === 1 ? "yes" : "no";
+    assert(result === "yes", "expected: yes, got: " + result);
+  });
+
+  test("prefix increment returns the new value", () => {
+    let i = 1;
+    const result = ++i + i++;
+    assert(result === 4, "expected: 4, got: " + result);
+    assert(i === 3, "expected: 3, got: " + i);
+  });
+
+  test("arrow functions as call arguments", () => {
+    const add = (f, a, b) => f(a, b);
+    const result = add((x, y) => x * y, 3, 4);
+    assert(result === 12, "expected: 12, got: " + result);
+  });
+});
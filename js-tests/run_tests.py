@@ -1,19 +1,23 @@
 from os import listdir
-from os.path import isfile, join
+from os.path import isfile, join, dirname, abspath
+import argparse
 import subprocess
 import json
 
 import sys
 
-use_file_filter = False
-filter = ""
-if(len(sys.argv) > 1):
-    use_file_filter = True
-    filter = sys.argv[1]
+arg_parser = argparse.ArgumentParser()
+arg_parser.add_argument("filter", nargs="?", default="")
+arg_parser.add_argument("--cli", default=join(dirname(abspath(__file__)), "..", "cmake-build-debug", "js"))
+arg_parser.add_argument("--test-dir", default=dirname(abspath(__file__)))
+arg_parser.add_argument("--cli-arg", action="append", default=[])
+args = arg_parser.parse_args()
 
+use_file_filter = args.filter != ""
+filter = args.filter
 
-test_dir = "/Users/andrewesterhuizen/dev/js/js-tests"
-cli_path = "/Users/andrewesterhuizen/dev/js/cmake-build-debug/js"
+test_dir = args.test_dir
+cli_path = args.cli
 
 exluded_files = ["assert.js"]
 
@@ -24,7 +28,7 @@ def is_test_file(file_name):
 
 def run_test_file(file_name):
     arg = f"--files={test_dir}/assert.js,{test_dir}/{file_name}"
-    result = subprocess.run([cli_path, arg], capture_output=True)
+    result = subprocess.run([cli_path, arg, *args.cli_arg], capture_output=True)
     if result.stderr:
         sys.exit(f"failed with error: {result.stderr}")
 
@@ -79,3 +83,6 @@ for file_result in file_results:
             print_red(f"      reason: {failed_reason}")
 
     print()
+
+if any(not result["passed"] for file_result in file_results for result in file_result["results"]):
+    sys.exit(1)
@@ -0,0 +1,202 @@
+section("scope", (test) => {
+  test("a call does not see its caller's locals", () => {
+    const readsHidden = () => {
+      try {
+        return hidden;
+      } catch (error) {
+        return error.name;
+      }
+    };
+    const caller = () => {
+      let hidden = 1;
+      return readsHidden();
+    };
+    const result = caller();
+    assert(result === "ReferenceError", "expected: ReferenceError, got: " + result);
+  });
+
+  test("closures keep the variables of the function they were created in", () => {
+    const counter = () => {
+      let count = 0;
+      return () => {
+        count += 1;
+        return count;
+      };
+    };
+    const next = counter();
+    next();
+    const result = next();
+    assert(result === 2, "expected: 2, got: " + result);
+  });
+
+  test("assignment reaches a variable declared in an enclosing function", () => {
+    let total = 0;
+    const add = (n) => {
+      total = total + n;
+    };
+    add(2);
+    add(3);
+    assert(total === 5, "expected: 5, got: " + total);
+  });
+
+  test("variables declared after their first use belong to the function", () => {
+    const f = () => {
+      x = 1;
+      var x = x + 1;
+      return x;
+    };
+    const result = f();
+    assert(result === 2, "expected: 2, got: " + result);
+  });
+
+  test("catch parameters do not clobber locals of the same name", () => {
+    let e = "local";
+    try {
+      throw "thrown";
+    } catch (e) {
+      assert(e === "thrown", "expected: thrown, got: " + e);
+    }
+    assert(e === "local", "expected: local, got: " + e);
+  });
+
+  test("arguments belongs to the function it is used in", () => {
+    function count() {
+      return arguments.length;
+    }
+    const result = count(1, 2, 3);
+    assert(result === 3, "expected: 3, got: " + result);
+  });
+
+  test("locals are intact after catching a throw from a nested call", () => {
+    let depth = 0;
+    const fail = (n) => {
+      let local = n;
+      if (n === 0) {
+        throw "bottom";
+      }
+      return fail(n - 1) + local;
+    };
+    const before = "before";
+    try {
+      fail(5);
+    } catch (e) {
+      depth = e;
+    }
+    assert(before === "before", "expected: before, got: " + before);
+    assert(depth === "bottom", "expected: bottom, got: " + depth);
+  });
+
+  test("recursive calls each get their own locals", () => {
+    function sum(n) {
+      let half = n;
+      if (n === 0) {
+        return 0;
+      }
+      const rest = sum(n - 1);
+      return half + rest;
+    }
+    const result = sum(10);
+    assert(result === 55, "expected: 55, got: " + result);
+  });
+
+  test("closures capture parameters and catch parameters", () => {
+    const keep = (value) => () => value;
+    let caught;
+    try {
+      throw "error";
+    } catch (e) {
+      caught = () => e;
+    }
+    const kept = keep(4)();
+    assert(kept === 4, "expected: 4, got: " + kept);
+    const result = caught();
+    assert(result === "error", "expected: error, got: " + result);
+  });
+
+  test("each call captures its own variables", () => {
+    function counter() {
+      let count = 0;
+      return () => {
+        count = count + 1;
+        return count;
+      };
+    }
+    const a = counter();
+    const b = counter();
+    a();
+    a();
+    const result = b();
+    assert(result === 1, "expected: 1, got: " + result);
+    const again = a();
+    assert(again === 3, "expected: 3, got: " + again);
+  });
+
+  test("closures reach through functions that capture nothing", () => {
+    function outer() {
+      let x = "outer";
+      function middle() {
+        let unused = 1;
+        return function inner() {
+          return x + unused;
+        };
+      }
+      function skip() {
+        return () => x;
+      }
+      return [middle()(), skip()()];
+    }
+    const result = outer();
+    assert(result[0] === "outer1", "expected: outer1, got: " + result[0]);
+    assert(result[1] === "outer", "expected: outer, got: " + result[1]);
+  });
+
+  test("let and const in a block do not clobber the ones outside it", () => {
+    const f = () => {
+      let x = 1;
+      {
+        let x = 2;
+      }
+      return x;
+    };
+    const result = f();
+    assert(result === 1, "expected: 1, got: " + result);
+  });
+
+  test("closures created in a loop keep the variables of their iteration", () => {
+    const f = () => {
+      const fs = [];
+      for (let i = 0; i < 3; i++) {
+        let j = i;
+        fs.push(() => j);
+      }
+      return fs[0]() + fs[1]() + fs[2]();
+    };
+    const result = f();
+    assert(result === 3, "expected: 3, got: " + result);
+  });
+
+  test("each iteration of a for loop has its own copy of the loop variable", () => {
+    const fs = [];
+    for (let i = 0; i < 3; i++) {
+      fs.push(() => i);
+      if (i === 1) {
+        break;
+      }
+    }
+    const result = fs[0]() * 10 + fs[1]();
+    assert(result === 1, "expected: 1, got: " + result);
+  });
+
+  test("throwing out of a block leaves its variables", () => {
+    let caught;
+    const outside = "outside";
+    try {
+      let inside = "inside";
+      const keep = () => inside;
+      throw keep;
+    } catch (e) {
+      caught = e() + (() => outside)();
+    }
+    assert(caught === "insideoutside", "expected: insideoutside, got: " + caught);
+  });
+});
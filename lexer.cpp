@@ -1,7 +1,36 @@
 #include "lexer.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+
 namespace lexer {
 
+// every keyword has to be classified as itself by get_keyword
+#define CHECK_KEYWORD(NAME, TEXT) static_assert(get_keyword(TEXT) == Keyword::NAME);
+KEYWORDS(CHECK_KEYWORD)
+#undef CHECK_KEYWORD
+
+namespace {
+
+bool is_identifier_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$';
+}
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool is_hex_digit(char c) {
+    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+bool is_identifier_part(char c) {
+    return is_identifier_start(c) || is_digit(c);
+}
+
+}
+
 #define CREATE_STRING_CASE(NAME) \
     case TokenType::NAME: return #NAME;
 
@@ -14,88 +43,249 @@ std::string token_type_to_string(TokenType type) {
     }
 }
 
-nlohmann::json Token::to_json() {
-    nlohmann::json j;
-    j["type"] = token_type_to_string(type);
-    j["value"] = value;
-    j["line"] = line;
-    j["column"] = column;
-    return j;
-}
+Location get_location(std::string_view source, uint32_t offset) {
+    Location location{1, 0};
+
+    for (size_t i = 0; i < offset && i < source.length(); i++) {
+        location.column++;
+        if (source[i] == '\n') {
+            location.line++;
+            location.column = 0;
+        }
+    }
 
-void Lexer::emit_token(TokenType type, std::string value) {
-    tokens.push_back(Token{type, value, line, column});
+    return location;
 }
 
-char Lexer::next_char() {
-    if (index + 1 > source.length()) {
-        return 0;
+std::string format_location(std::string_view source_name, Location location) {
+    auto position = std::to_string(location.line) + ":" + std::to_string(location.column);
+    if (source_name.empty()) {
+        return position;
     }
 
-    return source[++index];
+    return std::string(source_name) + ":" + position;
 }
 
-std::string Lexer::get_rest_of_line() {
-    std::string text;
+nlohmann::json tokens_to_json(std::string_view source, const std::vector<Token> &tokens) {
+    std::vector<nlohmann::json> out;
 
-    auto i = index;
+    Location location{1, 0};
+    uint32_t i = 0;
 
-    auto c = source[i];
-    while (c != '\n') {
-        text += c;
-        i++;
-        c = source[i];
+    for (auto &t: tokens) {
+        for (; i < t.offset; i++) {
+            location.column++;
+            if (source[i] == '\n') {
+                location.line++;
+                location.column = 0;
+            }
+        }
 
-        if (c == '\0') break;
+        nlohmann::json j;
+        j["type"] = token_type_to_string(t.type);
+        j["value"] = t.text(source);
+        j["line"] = location.line;
+        j["column"] = location.column;
+        out.push_back(j);
     }
 
-    return text;
+    return out;
 }
 
-void Lexer::skip_whitespace() {
-    auto c = source[index];
-    while (c == ' ' || c == '\n') {
-        column++;
-        if (c == '\n') {
-            line++;
-            column = 0;
+double decode_number(std::string_view text) {
+    auto begin = text.data();
+    auto end = text.data() + text.size();
+
+    if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        uint64_t value = 0;
+        auto [ptr, error] = std::from_chars(begin + 2, end, value, 16);
+        if (error == std::errc()) {
+            return static_cast<double>(value);
         }
 
-        c = next_char();
-        if (c == '\0') break;
+        // too large for 64 bits
+        double large = 0;
+        for (auto c: text.substr(2)) {
+            large = large * 16 + (is_digit(c) ? c - '0' : (c | 0x20) - 'a' + 10);
+        }
+        return large;
+    }
+
+    // like stod this stops at the first character that doesn't fit, the
+    // regex lexer's number pattern is looser than the grammar
+    double value = 0;
+    auto [ptr, error] = std::from_chars(begin, end, value);
+    if (error == std::errc::result_out_of_range) {
+        // from_chars leaves the value alone, strtod gives HUGE_VAL for too
+        // large and the nearest value, down to 0, for too small
+        return std::strtod(std::string(begin, ptr).c_str(), nullptr);
     }
+    return value;
 }
 
-void Lexer::skip_multi_line_comment() {
-    auto c = source[index];
-    auto s = source.substr(index, 2);
+void Lexer::emit_token(TokenType type, uint32_t offset, uint32_t length, Keyword keyword) {
+    token = Token{type, keyword, offset, length, {}};
 
-    while (s != "*/") {
-        column++;
-        if (c == '\n') {
-            line++;
-            column = 0;
-        }
+    if (type == TokenType::Identifier) {
+        token.atom = atom::intern(source.substr(offset, length));
+    } else if (type == TokenType::Number) {
+        token.number = first_number + numbers.size();
+        numbers.push_back(decode_number(source.substr(offset, length)));
+    }
+
+    has_token = true;
+}
+
+void Lexer::unexpected_character() {
+    auto location = get_location(source, index);
+    std::cerr << "unexpected token: " << get_rest_of_line() << " at " << format_location(source_name, location)
+              << "\n";
+    assert(false);
+}
 
+char Lexer::next_char() {
+    index++;
 
+    if (index >= source.length()) {
+        return 0;
+    }
+
+    return source[index];
+}
+
+std::string Lexer::get_rest_of_line() {
+    auto end = source.find('\n', index);
+    if (end == std::string::npos) {
+        end = source.length();
+    }
+
+    return std::string(source.substr(index, end - index));
+}
+
+void Lexer::skip_whitespace() {
+    if (index >= source.length()) {
+        return;
+    }
+
+    auto c = source[index];
+    while (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
         c = next_char();
         if (c == '\0') break;
+    }
+}
 
-        s = source.substr(index, 2);
+void Lexer::skip_multi_line_comment() {
+    while (index < source.length() && source.substr(index, 2) != "*/") {
+        index++;
     }
 
-    index += 2;
+    // an unterminated comment runs to the end of the source
+    index = std::min<uint32_t>(index + 2, source.length());
+}
+
+const std::vector<Pattern> &Lexer::patterns() {
+    static const std::string keywords_regex = "^("
+                                              "break|"
+                                              "case|"
+                                              "catch|"
+                                              "class|"
+                                              "const|"
+                                              "continue|"
+                                              "debugger|"
+                                              "default|"
+                                              "delete|"
+                                              "do|"
+                                              "else|"
+                                              "export|"
+                                              "extends|"
+                                              "false|"
+                                              "finally|"
+                                              "for|"
+                                              "function|"
+                                              "if|"
+                                              "import|"
+                                              "in|"
+                                              "instanceof|"
+                                              "let|"
+                                              "new|"
+                                              "null|"
+                                              "return|"
+                                              "super|"
+                                              "switch|"
+                                              "this|"
+                                              "throw|"
+                                              "true|"
+                                              "try|"
+                                              "typeof|"
+                                              "var|"
+                                              "void|"
+                                              "while|"
+                                              "with|"
+                                              "yield)"
+                                              "(?!\\w)";
+
+    static const std::vector<Pattern> patterns = {
+            {keywords_regex,          TokenType::Keyword},
+            {"^(_|\\$|[a-zA-Z])\\w*", TokenType::Identifier},
+            {"^\"[^\"]*\"",           TokenType::String},
+            {"^'[^']*'",              TokenType::String},
+            {"^0[xX][0-9a-fA-F]+",    TokenType::Number},
+            {"^\\d[.\\d+]*",          TokenType::Number},
+            {"^=>",                   TokenType::Arrow},
+            {"^===",                  TokenType::EqualToStrict},
+            {"^==",                   TokenType::EqualTo},
+            {"^=",                    TokenType::Equals},
+            {"^>=",                   TokenType::GreaterThanOrEqualTo},
+            {"^>",                    TokenType::GreaterThan},
+            {"^<=",                   TokenType::LessThanOrEqualTo},
+            {"^<",                    TokenType::LessThan},
+            {"^&&",                   TokenType::And},
+            {"^&",                    TokenType::Ampersand},
+            {"^\\|\\|",               TokenType::Or},
+            {"^\\|",                  TokenType::Pipe},
+            {"^!==",                  TokenType::NotEqualToStrict},
+            {"^!=",                   TokenType::NotEqualTo},
+            {"^!",                    TokenType::Not},
+            {"^\\+=",                 TokenType::AdditionAssignment},
+            {"^\\+\\+",               TokenType::Increment},
+            {"^\\+",                  TokenType::Plus},
+            {"^-=",                   TokenType::SubtractionAssignment},
+            {"^--",                   TokenType::Decrement},
+            {"^-",                    TokenType::Minus},
+            {"^;",                    TokenType::Semicolon},
+            {"^:",                    TokenType::Colon},
+            {"^,",                    TokenType::Comma},
+            {"^\\*=",                 TokenType::MultiplicationAssignment},
+            {"^\\*\\*",               TokenType::Exponentiation},
+            {"^\\*",                  TokenType::Asterisk},
+            {"^/=",                   TokenType::DivisionAssignment},
+            {"^/",                    TokenType::Slash},
+            {"^%",                    TokenType::Percent},
+            {"^\\(",                  TokenType::LeftParen},
+            {"^\\)",                  TokenType::RightParen},
+            {"^\\{",                  TokenType::LeftBrace},
+            {"^\\}",                  TokenType::RightBrace},
+            {"^\\[",                  TokenType::LeftBracket},
+            {"^\\]",                  TokenType::RightBracket},
+            {"^\\.",                  TokenType::Dot},
+            {"^\\?",                  TokenType::QuestionMark},
+            {"^\n",                   TokenType::NewLine},
+    };
+
+    return patterns;
 }
 
 void Lexer::get_token() {
     skip_whitespace();
 
+    if (index >= source.length()) {
+        return;
+    }
+
     auto text = get_rest_of_line();
 
     if (text.starts_with("//")) {
         index += text.length();
-        line++;
-        column = 0;
         return;
     }
 
@@ -106,48 +296,420 @@ void Lexer::get_token() {
 
     std::smatch match;
 
-    for (auto p: patterns) {
+    for (auto &p: patterns()) {
         auto is_match = std::regex_search(text, match, p.pattern);
         if (is_match) {
-            auto matched_text = match.str();
-            auto match_length = matched_text.length();
+            uint32_t match_length = match.length();
 
             if (p.token_type == TokenType::String) {
-                matched_text = matched_text.substr(1, match_length - 2);
+                emit_token(p.token_type, index + 1, match_length - 2);
+            } else if (p.token_type == TokenType::Keyword) {
+                emit_token(p.token_type, index, match_length, get_keyword(match.str()));
+            } else {
+                emit_token(p.token_type, index, match_length);
             }
 
-            column += match_length;
+            index += match_length;
+            return;
+        }
+    }
 
-            emit_token(p.token_type, matched_text);
+    unexpected_character();
+}
 
-            if (p.token_type == TokenType::NewLine) {
-                line++;
-                column = 0;
+char Lexer::peek_char(int offset) {
+    if (index + offset >= source.length()) {
+        return 0;
+    }
+
+    return source[index + offset];
+}
+
+void Lexer::skip_whitespace_and_comments() {
+    while (index < source.length()) {
+        auto c = source[index];
+
+        switch (c) {
+            case '\n':
+            case ' ':
+            case '\t':
+            case '\r':
+                index++;
+                break;
+            case '/': {
+                auto next = peek_char(1);
+
+                if (next == '/') {
+                    while (index < source.length() && source[index] != '\n') {
+                        index++;
+                    }
+                    break;
+                }
+
+                if (next == '*') {
+                    index += 2;
+                    while (index < source.length() && !(source[index] == '*' && peek_char(1) == '/')) {
+                        index++;
+                    }
+                    index = std::min<uint32_t>(index + 2, source.length());
+                    break;
+                }
+
+                return;
             }
+            default:
+                return;
+        }
+    }
+}
 
-            index += match_length;
-            return;
+void Lexer::scan_identifier() {
+    auto start = index;
+
+    while (is_identifier_part(peek_char())) {
+        index++;
+    }
+
+    auto keyword = get_keyword(source.substr(start, index - start));
+    auto type = keyword == Keyword::None ? TokenType::Identifier : TokenType::Keyword;
+
+    emit_token(type, start, index - start, keyword);
+}
+
+void Lexer::scan_number() {
+    auto start = index;
+
+    if (peek_char() == '0' && (peek_char(1) == 'x' || peek_char(1) == 'X') && is_hex_digit(peek_char(2))) {
+        index += 2;
+        while (is_hex_digit(peek_char())) {
+            index++;
+        }
+    } else {
+        while (is_digit(peek_char())) {
+            index++;
+        }
+
+        if (peek_char() == '.' && is_digit(peek_char(1))) {
+            index++;
+            while (is_digit(peek_char())) {
+                index++;
+            }
+        }
+
+        auto e = peek_char();
+        if (e == 'e' || e == 'E') {
+            auto sign = peek_char(1);
+            auto has_sign = sign == '+' || sign == '-';
+            if (is_digit(peek_char(has_sign ? 2 : 1))) {
+                index += has_sign ? 2 : 1;
+                while (is_digit(peek_char())) {
+                    index++;
+                }
+            }
         }
     }
 
-    std::cerr << "unexpected token: " << text << " at " << line << ":" << column << "\n";
-    assert(false);
+    emit_token(TokenType::Number, start, index - start);
+}
+
+void Lexer::scan_string() {
+    auto start = index;
+    auto quote = source[index++];
+
+    while (index < source.length() && source[index] != quote) {
+        if (source[index] == '\n') {
+            break;
+        }
+        index++;
+    }
+
+    if (index >= source.length() || source[index] != quote) {
+        auto location = get_location(source, start);
+        std::cerr << "unterminated string literal at " << format_location(source_name, location) << "\n";
+        assert(false);
+    }
+
+    index++;
+
+    emit_token(TokenType::String, start + 1, index - start - 2);
+}
+
+void Lexer::scan_punctuator() {
+    auto c = source[index];
+    auto next = peek_char(1);
+    auto after_next = peek_char(2);
+
+    TokenType type;
+    int length = 1;
+
+    switch (c) {
+        case '=':
+            if (next == '>') {
+                type = TokenType::Arrow;
+                length = 2;
+            } else if (next == '=' && after_next == '=') {
+                type = TokenType::EqualToStrict;
+                length = 3;
+            } else if (next == '=') {
+                type = TokenType::EqualTo;
+                length = 2;
+            } else {
+                type = TokenType::Equals;
+            }
+            break;
+        case '!':
+            if (next == '=' && after_next == '=') {
+                type = TokenType::NotEqualToStrict;
+                length = 3;
+            } else if (next == '=') {
+                type = TokenType::NotEqualTo;
+                length = 2;
+            } else {
+                type = TokenType::Not;
+            }
+            break;
+        case '>':
+            if (next == '=') {
+                type = TokenType::GreaterThanOrEqualTo;
+                length = 2;
+            } else {
+                type = TokenType::GreaterThan;
+            }
+            break;
+        case '<':
+            if (next == '=') {
+                type = TokenType::LessThanOrEqualTo;
+                length = 2;
+            } else {
+                type = TokenType::LessThan;
+            }
+            break;
+        case '&':
+            if (next == '&') {
+                type = TokenType::And;
+                length = 2;
+            } else {
+                type = TokenType::Ampersand;
+            }
+            break;
+        case '|':
+            if (next == '|') {
+                type = TokenType::Or;
+                length = 2;
+            } else {
+                type = TokenType::Pipe;
+            }
+            break;
+        case '+':
+            if (next == '=') {
+                type = TokenType::AdditionAssignment;
+                length = 2;
+            } else if (next == '+') {
+                type = TokenType::Increment;
+                length = 2;
+            } else {
+                type = TokenType::Plus;
+            }
+            break;
+        case '-':
+            if (next == '=') {
+                type = TokenType::SubtractionAssignment;
+                length = 2;
+            } else if (next == '-') {
+                type = TokenType::Decrement;
+                length = 2;
+            } else {
+                type = TokenType::Minus;
+            }
+            break;
+        case '*':
+            if (next == '=') {
+                type = TokenType::MultiplicationAssignment;
+                length = 2;
+            } else if (next == '*') {
+                type = TokenType::Exponentiation;
+                length = 2;
+            } else {
+                type = TokenType::Asterisk;
+            }
+            break;
+        case '/':
+            if (next == '=') {
+                type = TokenType::DivisionAssignment;
+                length = 2;
+            } else {
+                type = TokenType::Slash;
+            }
+            break;
+        case '%':
+            type = TokenType::Percent;
+            break;
+        case ';':
+            type = TokenType::Semicolon;
+            break;
+        case ':':
+            type = TokenType::Colon;
+            break;
+        case ',':
+            type = TokenType::Comma;
+            break;
+        case '(':
+            type = TokenType::LeftParen;
+            break;
+        case ')':
+            type = TokenType::RightParen;
+            break;
+        case '{':
+            type = TokenType::LeftBrace;
+            break;
+        case '}':
+            type = TokenType::RightBrace;
+            break;
+        case '[':
+            type = TokenType::LeftBracket;
+            break;
+        case ']':
+            type = TokenType::RightBracket;
+            break;
+        case '.':
+            type = TokenType::Dot;
+            break;
+        case '?':
+            type = TokenType::QuestionMark;
+            break;
+        default:
+            unexpected_character();
+    }
+
+    emit_token(type, index, length);
+    index += length;
+}
+
+void Lexer::scan_token() {
+    skip_whitespace_and_comments();
+
+    if (index >= source.length()) {
+        return;
+    }
+
+    auto c = source[index];
+
+    if (is_identifier_start(c)) {
+        scan_identifier();
+    } else if (is_digit(c)) {
+        scan_number();
+    } else if (c == '"' || c == '\'') {
+        scan_string();
+    } else {
+        scan_punctuator();
+    }
 }
 
-std::vector<Token> Lexer::get_tokens(std::string src) {
+void Lexer::set_source(std::string_view src, std::string_view name, uint32_t start) {
     source = src;
-    index = 0;
+    source_name = name;
+    numbers.clear();
+    first_number = 0;
+    index = start;
+}
 
-    if (src.size() == 0) {
-        emit_token(TokenType::EndOfFile, "\0");
-        return tokens;
+void Lexer::discard_numbers(uint32_t before) {
+    if (before <= first_number) {
+        return;
     }
 
-    while (index < source.length()) {
-        get_token();
+    auto count = std::min<size_t>(before - first_number, numbers.size());
+    numbers.erase(numbers.begin(), numbers.begin() + count);
+    first_number += count;
+}
+
+Token Lexer::next_token() {
+    has_token = false;
+
+    while (!has_token) {
+        if (index >= source.length()) {
+            emit_token(TokenType::EndOfFile, source.length(), 0);
+            break;
+        }
+
+        if (mode == Mode::Regex) {
+            get_token();
+        } else {
+            scan_token();
+        }
     }
 
+    return token;
+}
+
+std::vector<Token> Lexer::get_tokens(std::string_view src) {
+    set_source(src);
+
+    std::vector<Token> tokens;
+
+    do {
+        tokens.push_back(next_token());
+    } while (tokens.back().type != TokenType::EndOfFile);
+
     return tokens;
 }
 
+TokenStream::TokenStream(std::string_view src, Lexer::Mode mode, std::string_view name, uint32_t start)
+        : lexer(mode), source_text(src), source_name(name) {
+    lexer.set_source(src, name, start);
+    lookahead.push_back(lexer.next_token());
+}
+
+const Token &TokenStream::peek(size_t n) {
+    while (lookahead.size() <= n) {
+        if (lookahead.back().type == TokenType::EndOfFile) {
+            return lookahead.back();
+        }
+
+        lookahead.push_back(lexer.next_token());
+    }
+
+    return lookahead[n];
+}
+
+const Token &TokenStream::advance() {
+    if (lookahead.front().type == TokenType::EndOfFile) {
+        return lookahead.front();
+    }
+
+    previous = lookahead.front();
+    lookahead.pop_front();
+
+    if (lookahead.empty()) {
+        lookahead.push_back(lexer.next_token());
+    }
+
+    discard_numbers();
+    return lookahead.front();
+}
+
+// only the numbers of the tokens in the window are kept, so streaming a
+// source does not keep the value of every number in it
+void TokenStream::discard_numbers() {
+    if (previous->type == TokenType::Number) {
+        lexer.discard_numbers(previous->number);
+        return;
+    }
+
+    for (auto &token: lookahead) {
+        if (token.type == TokenType::Number) {
+            lexer.discard_numbers(token.number);
+            return;
+        }
+    }
+
+    lexer.discard_numbers(UINT32_MAX);
+}
+
+void TokenStream::backup() {
+    assert(previous.has_value());
+    lookahead.push_front(previous.value());
+    previous.reset();
+}
+
 }
@@ -1,10 +1,16 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <cstdint>
 #include <vector>
+#include <deque>
+#include <optional>
 #include <iostream>
 #include <regex>
+#include <cassert>
 
+#include "atom.h"
 #include "json.hpp"
 
 namespace lexer {
@@ -57,7 +63,7 @@ namespace lexer {
 
 #define CREATE_ENUM(NAME) NAME,
 
-enum class TokenType {
+enum class TokenType : uint8_t {
     TOKENS(CREATE_ENUM)
 };
 
@@ -65,14 +71,163 @@ enum class TokenType {
 
 std::string token_type_to_string(TokenType type);
 
-struct Token {
-    TokenType type;
-    std::string value;
+#define KEYWORDS(MAP) \
+    MAP(Break, "break") \
+    MAP(Case, "case") \
+    MAP(Catch, "catch") \
+    MAP(Class, "class") \
+    MAP(Const, "const") \
+    MAP(Continue, "continue") \
+    MAP(Debugger, "debugger") \
+    MAP(Default, "default") \
+    MAP(Delete, "delete") \
+    MAP(Do, "do") \
+    MAP(Else, "else") \
+    MAP(Export, "export") \
+    MAP(Extends, "extends") \
+    MAP(False, "false") \
+    MAP(Finally, "finally") \
+    MAP(For, "for") \
+    MAP(Function, "function") \
+    MAP(If, "if") \
+    MAP(Import, "import") \
+    MAP(In, "in") \
+    MAP(Instanceof, "instanceof") \
+    MAP(Let, "let") \
+    MAP(New, "new") \
+    MAP(Null, "null") \
+    MAP(Return, "return") \
+    MAP(Super, "super") \
+    MAP(Switch, "switch") \
+    MAP(This, "this") \
+    MAP(Throw, "throw") \
+    MAP(True, "true") \
+    MAP(Try, "try") \
+    MAP(Typeof, "typeof") \
+    MAP(Var, "var") \
+    MAP(Void, "void") \
+    MAP(While, "while") \
+    MAP(With, "with") \
+    MAP(Yield, "yield")
+
+#define CREATE_KEYWORD_ENUM(NAME, TEXT) NAME,
+
+enum class Keyword : uint8_t {
+    None,
+    KEYWORDS(CREATE_KEYWORD_ENUM)
+};
+
+#undef CREATE_KEYWORD_ENUM
+
+// classifies a scanned identifier by switching on its length and first
+// character, so at most one full string comparison is done per identifier
+constexpr Keyword get_keyword(std::string_view text) {
+    auto is = [&](std::string_view keyword) { return text == keyword; };
+
+    switch (text.length()) {
+        case 2:
+            switch (text[0]) {
+                case 'd': return is("do") ? Keyword::Do : Keyword::None;
+                case 'i': return is("if") ? Keyword::If : is("in") ? Keyword::In : Keyword::None;
+            }
+            break;
+        case 3:
+            switch (text[0]) {
+                case 'f': return is("for") ? Keyword::For : Keyword::None;
+                case 'l': return is("let") ? Keyword::Let : Keyword::None;
+                case 'n': return is("new") ? Keyword::New : Keyword::None;
+                case 't': return is("try") ? Keyword::Try : Keyword::None;
+                case 'v': return is("var") ? Keyword::Var : Keyword::None;
+            }
+            break;
+        case 4:
+            switch (text[0]) {
+                case 'c': return is("case") ? Keyword::Case : Keyword::None;
+                case 'e': return is("else") ? Keyword::Else : Keyword::None;
+                case 'n': return is("null") ? Keyword::Null : Keyword::None;
+                case 't': return is("this") ? Keyword::This : is("true") ? Keyword::True : Keyword::None;
+                case 'v': return is("void") ? Keyword::Void : Keyword::None;
+                case 'w': return is("with") ? Keyword::With : Keyword::None;
+            }
+            break;
+        case 5:
+            switch (text[0]) {
+                case 'b': return is("break") ? Keyword::Break : Keyword::None;
+                case 'c':
+                    return is("catch") ? Keyword::Catch
+                                       : is("class") ? Keyword::Class
+                                                     : is("const") ? Keyword::Const : Keyword::None;
+                case 'f': return is("false") ? Keyword::False : Keyword::None;
+                case 's': return is("super") ? Keyword::Super : Keyword::None;
+                case 't': return is("throw") ? Keyword::Throw : Keyword::None;
+                case 'w': return is("while") ? Keyword::While : Keyword::None;
+                case 'y': return is("yield") ? Keyword::Yield : Keyword::None;
+            }
+            break;
+        case 6:
+            switch (text[0]) {
+                case 'd': return is("delete") ? Keyword::Delete : Keyword::None;
+                case 'e': return is("export") ? Keyword::Export : Keyword::None;
+                case 'i': return is("import") ? Keyword::Import : Keyword::None;
+                case 'r': return is("return") ? Keyword::Return : Keyword::None;
+                case 's': return is("switch") ? Keyword::Switch : Keyword::None;
+                case 't': return is("typeof") ? Keyword::Typeof : Keyword::None;
+            }
+            break;
+        case 7:
+            switch (text[0]) {
+                case 'd': return is("default") ? Keyword::Default : Keyword::None;
+                case 'e': return is("extends") ? Keyword::Extends : Keyword::None;
+                case 'f': return is("finally") ? Keyword::Finally : Keyword::None;
+            }
+            break;
+        case 8:
+            switch (text[0]) {
+                case 'c': return is("continue") ? Keyword::Continue : Keyword::None;
+                case 'd': return is("debugger") ? Keyword::Debugger : Keyword::None;
+                case 'f': return is("function") ? Keyword::Function : Keyword::None;
+            }
+            break;
+        case 10:
+            return is("instanceof") ? Keyword::Instanceof : Keyword::None;
+    }
+
+    return Keyword::None;
+}
+
+struct Location {
     int line;
     int column;
-    nlohmann::json to_json();
 };
 
+// tokens don't own their text, they point into the source buffer that was
+// passed to the lexer, which the caller has to keep alive
+struct Token {
+    TokenType type;
+    Keyword keyword;
+    uint32_t offset;
+    uint32_t length;
+    union {
+        // interned name for identifiers
+        atom::Atom atom;
+        // index of the decoded value in the lexer's number pool for numbers
+        uint32_t number;
+    };
+
+    std::string_view text(std::string_view source) const {
+        return source.substr(offset, length);
+    }
+};
+
+static_assert(sizeof(Token) <= 16);
+
+Location get_location(std::string_view source, uint32_t offset);
+// decimal (with fraction and exponent) or 0x prefixed hex literal text to its value
+double decode_number(std::string_view text);
+// "name:line:column", or "line:column" for sources without a name
+std::string format_location(std::string_view source_name, Location location);
+nlohmann::json tokens_to_json(std::string_view source, const std::vector<Token> &tokens);
+
 struct Pattern {
     std::regex pattern;
     TokenType token_type;
@@ -80,110 +235,104 @@ struct Pattern {
 };
 
 class Lexer {
-    std::vector<Token> tokens;
-    int index = 0;
-    std::string source;
-
-    int line = 1;
-    int column = 0;
-
-    const std::string keywords_regex = "^("
-                                       "break|"
-                                       "case|"
-                                       "catch|"
-                                       "class|"
-                                       "const|"
-                                       "continue|"
-                                       "debugger|"
-                                       "default|"
-                                       "delete|"
-                                       "do|"
-                                       "else|"
-                                       "export|"
-                                       "extends|"
-                                       "false|"
-                                       "finally|"
-                                       "for|"
-                                       "function|"
-                                       "if|"
-                                       "import|"
-                                       "in|"
-                                       "instanceof|"
-                                       "let|"
-                                       "new|"
-                                       "null|"
-                                       "return|"
-                                       "super|"
-                                       "switch|"
-                                       "this|"
-                                       "throw|"
-                                       "true|"
-                                       "try|"
-                                       "typeof|"
-                                       "var|"
-                                       "void|"
-                                       "while|"
-                                       "with|"
-                                       "yield)"
-                                       "(?!\\w)";
-
-    std::vector<Pattern> patterns = {
-            {keywords_regex,          TokenType::Keyword},
-            {"^(_|\\$|[a-zA-Z])\\w*", TokenType::Identifier},
-            {"^\"[^\"]*\"",           TokenType::String},
-            {"^'[^']*'",              TokenType::String},
-            {"^0[xX][0-9a-fA-F]+",    TokenType::Number},
-            {"^\\d[.\\d+]*",          TokenType::Number},
-            {"^=>",                   TokenType::Arrow},
-            {"^===",                  TokenType::EqualToStrict},
-            {"^==",                   TokenType::EqualTo},
-            {"^=",                    TokenType::Equals},
-            {"^>=",                   TokenType::GreaterThanOrEqualTo},
-            {"^>",                    TokenType::GreaterThan},
-            {"^<=",                   TokenType::LessThanOrEqualTo},
-            {"^<",                    TokenType::LessThan},
-            {"^&&",                   TokenType::And},
-            {"^&",                    TokenType::Ampersand},
-            {"^\\|\\|",               TokenType::Or},
-            {"^\\|",                  TokenType::Pipe},
-            {"^!==",                  TokenType::NotEqualToStrict},
-            {"^!=",                   TokenType::NotEqualTo},
-            {"^!",                    TokenType::Not},
-            {"^\\+=",                 TokenType::AdditionAssignment},
-            {"^\\+\\+",               TokenType::Increment},
-            {"^\\+",                  TokenType::Plus},
-            {"^-=",                   TokenType::SubtractionAssignment},
-            {"^--",                   TokenType::Decrement},
-            {"^-",                    TokenType::Minus},
-            {"^;",                    TokenType::Semicolon},
-            {"^:",                    TokenType::Colon},
-            {"^,",                    TokenType::Comma},
-            {"^\\*=",                 TokenType::MultiplicationAssignment},
-            {"^\\*\\*",               TokenType::Exponentiation},
-            {"^\\*",                  TokenType::Asterisk},
-            {"^/=",                   TokenType::DivisionAssignment},
-            {"^/",                    TokenType::Slash},
-            {"^%",                    TokenType::Percent},
-            {"^\\(",                  TokenType::LeftParen},
-            {"^\\)",                  TokenType::RightParen},
-            {"^\\{",                  TokenType::LeftBrace},
-            {"^\\}",                  TokenType::RightBrace},
-            {"^\\[",                  TokenType::LeftBracket},
-            {"^\\]",                  TokenType::RightBracket},
-            {"^\\.",                  TokenType::Dot},
-            {"^\\?",                  TokenType::QuestionMark},
-            {"^\n",                   TokenType::NewLine},
-            {"^\\0",                  TokenType::EndOfFile},
+public:
+    // Scanner is a hand written single pass scanner, Regex is the original
+    // pattern table which is kept around so the two can be compared
+    enum class Mode {
+        Scanner,
+        Regex
     };
 
-    void emit_token(TokenType type, std::string value);
+private:
+    Mode mode;
+    uint32_t index = 0;
+    std::string_view source;
+    std::string_view source_name;
+    // values of the number tokens in the current source, decoded once as they
+    // are lexed. a token stream drops the ones before its window, the first
+    // one still here is that of number token `first_number`
+    std::vector<double> numbers;
+    uint32_t first_number = 0;
+
+    Token token;
+    bool has_token = false;
+
+    // the pattern table of the regex mode, compiled once on first use
+    static const std::vector<Pattern> &patterns();
+
+    void emit_token(TokenType type, uint32_t offset, uint32_t length, Keyword keyword = Keyword::None);
+    void unexpected_character();
     char next_char();
     std::string get_rest_of_line();
     void skip_whitespace();
     void skip_multi_line_comment();
     void get_token();
+
+    char peek_char(int offset = 0);
+    void skip_whitespace_and_comments();
+    void scan_identifier();
+    void scan_number();
+    void scan_string();
+    void scan_punctuator();
+    void scan_token();
+public:
+    Lexer(Mode mode = Mode::Scanner) : mode(mode) {}
+    // lexing starts at `start`, token offsets stay relative to the whole of `src`
+    void set_source(std::string_view src, std::string_view name = {}, uint32_t start = 0);
+    // returns the next token in the source, once the end has been reached
+    // every call returns EndOfFile
+    Token next_token();
+    std::vector<Token> get_tokens(std::string_view src);
+
+    double number(const Token &token) const {
+        return numbers[token.number - first_number];
+    }
+
+    // the values of the number tokens before the `before`th are not asked for
+    // any more, all of them if fewer have been lexed
+    void discard_numbers(uint32_t before);
+
+    Mode get_mode() const {
+        return mode;
+    }
+};
+
+// pulls tokens from a lexer as the parser asks for them, only the current
+// token, the one before it and however far the parser has peeked ahead are
+// kept in memory
+class TokenStream {
+    Lexer lexer;
+    std::string_view source_text;
+    std::string_view source_name;
+    std::optional<Token> previous;
+    std::deque<Token> lookahead;
+
+    void discard_numbers();
+
 public:
-    std::vector<Token> get_tokens(std::string src);
+    TokenStream(std::string_view src, Lexer::Mode mode = Lexer::Mode::Scanner, std::string_view name = {},
+                uint32_t start = 0);
+
+    std::string_view source() const {
+        return source_text;
+    }
+
+    std::string_view name() const {
+        return source_name;
+    }
+
+    double number(const Token &token) const {
+        return lexer.number(token);
+    }
+
+    Lexer::Mode mode() const {
+        return lexer.get_mode();
+    }
+
+    // peek(0) is the current token
+    const Token &peek(size_t n = 0);
+    const Token &advance();
+    void backup();
 };
 
 }
\ No newline at end of file
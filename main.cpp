@@ -1,7 +1,6 @@
 #include <iostream>
 #include <string>
 #include <set>
-#include <fstream>
 #include <sstream>
 
 #include "json.hpp"
@@ -9,6 +8,8 @@
 #include "interpreter.h"
 #include "lexer.h"
 #include "parser.h"
+#include "pipeline.h"
+#include "source.h"
 
 std::vector<std::string> get_files(std::string files_arg) {
     std::string arg_name = "--files=";
@@ -37,44 +38,83 @@ int main(int argc, char* argv[]) {
 
     auto output_tokens = args.find("--output-tokens") != args.end();
     auto output_ast = args.find("--output-ast") != args.end();
+    auto stream = args.find("--stream") != args.end();
+    auto lexer_mode = args.find("--lexer=regex") != args.end() ? lexer::Lexer::Mode::Regex : lexer::Lexer::Mode::Scanner;
+    // function bodies are parsed on their first call, unless the whole ast is printed
+    auto lazy_functions = !output_ast && args.find("--eager-functions") == args.end();
+    // --engine=ast is the default tree walker
+    auto engine = interpreter::Interpreter::Engine::Tree;
+    if (args.find("--engine=flat") != args.end()) {
+        engine = interpreter::Interpreter::Engine::Flat;
+    } else if (args.find("--engine=bytecode") != args.end()) {
+        engine = interpreter::Interpreter::Engine::Bytecode;
+    }
+    interpreter::Optimizations optimizations;
+    optimizations.fold_constants = args.find("--no-fold") == args.end();
+    optimizations.shake_tree = args.find("--no-shake") == args.end();
+    optimizations.report = args.find("--report-shaking") != args.end();
+    for (auto &arg: args) {
+        if (arg.starts_with("--inline-budget=")) {
+            optimizations.inline_budget = std::stoul(arg.substr(16));
+        }
+    }
+    if (args.find("--no-inline") != args.end()) {
+        optimizations.inline_budget = 0;
+    }
+    // counts opcode pairs run by the bytecode engine
+    auto profile_opcodes = args.find("--profile-opcodes") != args.end();
 
     auto files = get_files(files_arg);
 
-    std::stringstream source_buffer;
+    // each file keeps its own buffer so it can be lexed and parsed on its own,
+    // "-" reads stdin
+    std::vector<source::SourceBuffer> sources;
+    std::vector<pipeline::SourceFile> source_files;
 
-    for (auto f: files) {
-        std::ifstream file(f);
-        if (!file.is_open()) {
+    for (auto &f: files) {
+        auto source = source::SourceBuffer::open(f);
+        if (!source.has_value()) {
             std::cerr << "unable to open file " << f << "\n";
             return 1;
         }
 
-        source_buffer << file.rdbuf();
+        sources.push_back(std::move(source.value()));
     }
 
-    auto source = source_buffer.str();
-
-    // get tokens
-    lexer::Lexer l;
-    auto tokens = l.get_tokens(source);
+    for (size_t i = 0; i < files.size(); i++) {
+        source_files.push_back({files[i], sources[i].text()});
+    }
 
     if (output_tokens) {
-        // print tokens
-        nlohmann::json j;
-        std::vector<nlohmann::json> out;
-        for (auto t: tokens) {
-            out.push_back(t.to_json());
+        // print tokens, only the last file's EndOfFile is kept
+        lexer::Lexer l(lexer_mode);
+        auto tokens = nlohmann::json::array();
+        for (size_t i = 0; i < source_files.size(); i++) {
+            auto source = source_files[i].text;
+            for (auto &t: lexer::tokens_to_json(source, l.get_tokens(source))) {
+                if (t["type"] == "EndOfFile" && i + 1 < source_files.size()) {
+                    continue;
+                }
+                tokens.push_back(t);
+            }
         }
+        std::cout << tokens.dump(4) << "\n";
+        return 0;
+    }
 
-        j = out;
-        std::cout << j.dump(4) << "\n";
-
+    if (stream && !output_ast) {
+        // execute each statement as soon as it is parsed, parsing runs one statement ahead
+        pipeline::StatementPipeline statements(source_files, lexer_mode, lazy_functions);
+        interpreter::Interpreter i(engine, optimizations);
+        if (profile_opcodes) {
+            i.profile_opcodes();
+        }
+        i.run([&] { return statements.next(); });
         return 0;
     }
 
-    // parse tokens
-    parser::Parser p;
-    auto ast = p.parse(tokens);
+    // files are lexed and parsed in parallel and joined in order
+    auto ast = pipeline::parse_files(source_files, lexer_mode, lazy_functions);
 
     if (output_ast) {
         std::cout << ast.to_json().dump(4) << "\n";
@@ -82,7 +122,10 @@ int main(int argc, char* argv[]) {
     }
 
     // execute ast
-    interpreter::Interpreter i;
+    interpreter::Interpreter i(engine, optimizations);
+    if (profile_opcodes) {
+        i.profile_opcodes();
+    }
     i.run(ast);
 
     return 0;
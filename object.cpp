@@ -1,89 +1,109 @@
 #include "object.h"
 
+#include <algorithm>
+#include <unordered_set>
+
 namespace interpreter::object {
 
-ObjectManager::Scope* ObjectManager::current_scope() {
-    return &scopes[current_scope_index];
+Environment* ObjectManager::new_environment(size_t size, Environment* parent) {
+    environments.push_back(Environment{std::vector<Value>(size), parent});
+    return &environments.back();
 }
 
-void ObjectManager::push_scope(Value* context) {
-    scopes.push_back(Scope{*this, context});
-    current_scope_index++;
-}
+Frame* ObjectManager::push_frame(Value context, uint32_t size, uint32_t environment_size, Environment* outer) {
+    if (stack_top + size > stack_capacity) {
+        return nullptr;
+    }
 
-void ObjectManager::pop_scope() {
-    scopes.pop_back();
-    current_scope_index--;
-}
+    Frame frame{context, &stack[stack_top], size, nullptr, outer};
+    std::fill_n(frame.locals, size, nullptr);
+    stack_top += size;
 
-std::optional<object::Value*> ObjectManager::get_variable(std::string name) {
-    auto i = current_scope_index;
+    if (environment_size > 0) {
+        frame.environment = new_environment(environment_size, outer);
+    }
 
-    while (i >= 0) {
-        auto var = scopes[i].get_variable(name);
-        if (var.has_value()) {
-            return var.value();
-        }
+    frames.push_back(frame);
+    return &frames.back();
+}
 
-        i--;
-    }
+void ObjectManager::pop_frame() {
+    stack_top -= frames.back().size;
+    frames.pop_back();
+}
+
+void ObjectManager::push_environment(uint32_t size) {
+    auto &frame = frames.back();
+    frame.environment = new_environment(size, frame.environment != nullptr ? frame.environment : frame.outer);
+}
 
-    return {};
+void ObjectManager::pop_environment() {
+    // a call's own environment is the one whose parent is where its function was created
+    auto &frame = frames.back();
+    auto parent = frame.environment->parent;
+    frame.environment = parent == frame.outer ? nullptr : parent;
 }
 
-object::Value* ObjectManager::declare_variable(std::string name, object::Value* value) {
-    return current_scope()->set_variable(name, value);
+void ObjectManager::renew_environment() {
+    auto &frame = frames.back();
+    environments.push_back(*frame.environment);
+    frame.environment = &environments.back();
 }
 
-object::Value* ObjectManager::set_variable(std::string name, object::Value* value) {
-    auto var = current_scope()->get_variable(name);
+void ObjectManager::resize_global_environment(uint32_t size) {
+    global_frame().environment->slots.resize(size);
+}
 
-    // undeclared so set in top level scope, closest thing we have to "global" right now
-    if (var == nullptr) {
-        return scopes[0].set_variable(name, value);
+std::optional<Value> ObjectManager::get_variable(atom::Atom name) {
+    if (global == nullptr) {
+        return {};
     }
 
-    return current_scope()->set_variable(name, value);
+    return global.get_property(*this, name);
+}
+
+Value ObjectManager::set_variable(atom::Atom name, Value value) {
+    return global.set_property(name, value);
 }
 void ObjectManager::collect_garbage() {
     gc_amount++;
 
     // mark referenced objects
-    for (auto i = 0; i <= current_scope_index; i++) {
-        for (auto v: scopes[i].variables) {
-            auto obj = v.second;
-            objects[obj].is_referenced = true;
-            for (auto p: obj->properties) {
-                objects[p.second].is_referenced = true;
+    std::unordered_set<HeapObject*> referenced;
+    auto mark = [&](Value value) {
+        if (!value.is_heap()) {
+            return;
+        }
+        referenced.insert(value.heap());
+        for (auto p: value.properties()) {
+            if (p.second.is_heap()) {
+                referenced.insert(p.second.heap());
             }
         }
-    }
+    };
 
-
-    // get list of unmarked objects
-    std::vector<Value*> to_remove;
-    for (auto o: objects) {
-        auto obj = o.second;
-        if (is_value_still_in_scope(obj.value)) {
-            continue;
+    for (auto &frame: frames) {
+        for (uint32_t i = 0; i < frame.size; i++) {
+            mark(frame.locals[i]);
         }
-
-        if (!obj.is_referenced) {
-            to_remove.push_back(o.first);
+        for (auto environment = frame.environment; environment != nullptr && environment != frame.outer;
+             environment = environment->parent) {
+            for (auto obj: environment->slots) {
+                mark(obj);
+            }
         }
     }
 
     // remove unmarked objects
-    for (auto o: to_remove) {
+    std::erase_if(objects, [&](HeapObject* o) {
+        if (referenced.contains(o)) {
+            return false;
+        }
+
         delete o;
-        objects.erase(o);
         objects_collected++;
-    }
-
-    // reset objects
-    for (auto &c: objects) {
-        c.second.is_referenced = false;
-    }
+        return true;
+    });
 }
 
 template<typename T, typename... Args>
@@ -94,73 +114,197 @@ T* ObjectManager::allocate(Args &&... args) {
     }
 
     auto o = new T(std::forward<Args>(args)...);
-    objects[o] = Cell{o, true};
-
-    if (scopes.size() > 0) {
-        current_scope()->values_in_scope.insert(o);
-    }
+    objects.push_back(o);
     return o;
 }
 
-ObjectManager::Scope* ObjectManager::global_scope() {
-    return &scopes[0];
-}
+// used by the inline constructors in object.h
+template HeapObject* ObjectManager::allocate<HeapObject>();
 
-Value* ObjectManager::global_object() {
+Value ObjectManager::global_object() {
     return global;
 }
 
-Value* Value::register_native_method(ObjectManager &object_manager, std::string name, native_function_handler handler) {
-    auto func_value = object_manager.new_function(name);
-    auto func = func_value->function();
+Value Value::register_native_method(ObjectManager &object_manager, std::string name,
+                                   native_function_handler handler) const {
+    auto name_atom = atom::intern(name);
+    auto func_value = object_manager.new_function(name_atom);
+    auto func = func_value.function();
     func->is_builtin = true;
     func->builtin_func = handler;
-    properties[name] = func_value;
+    properties()[name_atom] = func_value;
     return func_value;
 }
 
-std::optional<Value*> Value::get_property(ObjectManager &object_manager, std::string name) {
-    if (type == Type::Array) {
+nlohmann::json Value::to_json() const {
+    switch (type()) {
+        case Type::Object: {
+            nlohmann::json j;
+
+            for (auto p: properties()) {
+                if (p.first == atom::Proto) {
+                    continue;
+                }
+                j[atom::to_string(p.first)] = p.second.to_json();
+            }
+
+            if (j.empty()) {
+                return "{}";
+            }
+
+            return j;
+        }
+        case Type::Function:
+            return function()->is_builtin ? "Native Function" : "Function";
+        case Type::Array: {
+            nlohmann::json j;
+
+            std::vector<nlohmann::json> element_strings;
+
+            for (auto e: array()->elements) {
+                element_strings.push_back(e.to_json());
+            }
+
+            j = element_strings;
+
+            return j;
+        }
+        case Type::Number:
+            return number();
+        case Type::String:
+            return string();
+        case Type::Boolean:
+            return boolean();
+        case Type::Undefined:
+            return "undefined";
+        case Type::Null:
+            return "null";
+    }
+
+    assert(false);
+}
+
+std::string Value::to_string() const {
+    switch (type()) {
+        case Type::Object: {
+            auto out = to_json().dump(4);
+            auto prototype_entry = properties().find(atom::Proto);
+            if (prototype_entry == properties().end() || !prototype_entry->second.is_heap()) {
+                return out;
+            }
+
+            out = "[object ";
+
+            auto prototype = prototype_entry->second;
+            auto constructor = prototype.properties().find(atom::Constructor);
+            if (constructor != prototype.properties().end()) {
+                assert(constructor->second.type() == Type::Function);
+                auto name = constructor->second.function()->name;
+                if (name.has_value()) {
+                    out += atom::to_string(name.value());
+                    out += "]";
+                    return out;
+                }
+            }
+
+            out += "Object]";
+
+            return out;
+        }
+        case Type::Function:
+        case Type::Array:
+        case Type::Number:
+        case Type::String:
+        case Type::Boolean:
+        case Type::Undefined:
+        case Type::Null:
+            return to_json().dump(4);
+    }
+
+    assert(false);
+}
+
+std::string Value::type_of() const {
+    switch (type()) {
+        case Type::Function:
+            return "function";
+        case Type::Object:
+        case Type::Array:
+            return "object";
+        case Type::Number:
+            return "number";
+        case Type::String:
+            return "string";
+        case Type::Boolean:
+            return "boolean";
+        case Type::Null:
+            return "object";
+        case Type::Undefined:
+            return "undefined";
+    }
+
+    assert(false);
+}
+
+std::optional<Value> Value::get_property(ObjectManager &object_manager, atom::Atom name) const {
+    if (!is_heap()) {
+        auto type = this->type();
+        auto prototype = object_manager.get_variable(type == Type::Number ? atom::Number :
+                                                     type == Type::Boolean ? atom::Boolean : atom::Object);
+        assert(prototype.has_value());
+        if (name == atom::Proto) {
+            return prototype;
+        }
+
+        return prototype.value().get_property(object_manager, name);
+    }
+
+    if (type() == Type::Array) {
         // TODO: built in properties like this need to be generalised
-        if (name == "length") {
+        if (name == atom::Length) {
             auto a = array();
             return object_manager.new_number(a->elements.size());
         }
     }
 
+    auto &properties = this->properties();
     if (auto entry = properties.find(name); entry != properties.end()) {
         return entry->second;
     }
 
-    auto proto = properties.find("__proto__");
-    if (proto == properties.end()) {
+    // the chain ends at a prototype that is not an object
+    auto proto = properties.find(atom::Proto);
+    if (proto == properties.end() || !proto->second.is_heap()) {
         return {};
     }
 
-    return proto->second->get_property(object_manager, name);
+    return proto->second.get_property(object_manager, name);
 }
 
-std::optional<Value*> Value::get_property(ObjectManager &object_manager, int index) {
-    if (type == Type::Array) {
+std::optional<Value> Value::get_property(ObjectManager &object_manager, int index) const {
+    if (is_heap() && type() == Type::Array) {
         auto a = array();
-        if(index >= array()->elements.size()) {
+        if(index >= a->elements.size()) {
             return object_manager.new_undefined();
         }
 
         return a->elements.at(index);
     }
 
-    auto name = std::to_string(index);
+    auto name = atom::intern(std::to_string(index));
     return get_property(object_manager, name);
 }
 
-Value* Value::set_property(std::string name, Value* value) {
-    properties[name] = value;
+Value Value::set_property(atom::Atom name, Value value) const {
+    if (is_heap()) {
+        properties()[name] = value;
+    }
+
     return value;
 }
 
-Value* Value::set_property(int index, Value* value) {
-    if (type == Type::Array) {
+Value Value::set_property(int index, Value value) const {
+    if (is_heap() && type() == Type::Array) {
         auto a = array();
 
         if (index > a->elements.size()) {
@@ -171,110 +315,68 @@ Value* Value::set_property(int index, Value* value) {
         return value;
     }
 
-    auto name = std::to_string(index);
+    auto name = atom::intern(std::to_string(index));
     return set_property(name, value);
 }
 
-Value* ValueFactory::number(ObjectManager &om, Value* value, double v) {
-    value->type = Value::Type::Number;
-    value->value = v;
-    auto prototype = om.global_scope()->get_variable("Number");
+Value ValueFactory::string(ObjectManager &om, HeapObject* object, std::string v) {
+    object->type = Value::Type::String;
+    object->value = v;
+    auto prototype = om.get_variable(atom::String);
     assert(prototype.has_value());
-    value->set_property("__proto__", prototype.value());
-    return value;
-}
-Value* ValueFactory::string(ObjectManager &om, Value* value, std::string v) {
-    value->type = Value::Type::String;
-    value->value = v;
-    auto prototype = om.global_scope()->get_variable("String");
-    assert(prototype.has_value());
-    value->set_property("__proto__", prototype.value());
-    return value;
-}
-
-Value* ValueFactory::boolean(ObjectManager &om, Value* value, bool v) {
-    value->type = Value::Type::Boolean;
-    value->value = v;
-    auto prototype = om.global_scope()->get_variable("Boolean");
-    assert(prototype.has_value());
-    value->set_property("__proto__", prototype.value());
-    return value;
-}
-
-Value* ValueFactory::null(ObjectManager &om, Value* value) {
-    value->type = Value::Type::Null;
-    auto prototype = om.global_scope()->get_variable("Object");
-    assert(prototype.has_value());
-    value->set_property("__proto__", prototype.value());
-    return value;
+    object->properties[atom::Proto] = prototype.value();
+    return Value(object);
 }
 
-Value* ValueFactory::array(ObjectManager &om, Value* value, std::optional<int> length) {
-    return array(om, value, {}, length);
+Value ValueFactory::array(ObjectManager &om, HeapObject* object, std::optional<int> length) {
+    return array(om, object, {}, length);
 }
 
-Value* ValueFactory::array(ObjectManager &om, Value* value, std::vector<Value*> v, std::optional<int> length) {
-    value->type = Value::Type::Array;
-    value->value = Value::Array{v};
-    auto prototype = om.global_scope()->get_variable("Array");
+Value ValueFactory::array(ObjectManager &om, HeapObject* object, std::vector<Value> v, std::optional<int> length) {
+    object->type = Value::Type::Array;
+    object->value = Array{v};
+    auto prototype = om.get_variable(atom::Array);
     assert(prototype.has_value());
-    value->set_property("__proto__", prototype.value());
+    object->properties[atom::Proto] = prototype.value();
 
     // this is a bit of a hack for now, arrays should support "holes",
     // so we don't need to allocate values for items that don't exist
     if(length.has_value()) {
         for(auto i = 0; i < length; i++) {
-            value->array()->elements.push_back(om.new_undefined());
+            std::get<Array>(object->value).elements.push_back(om.new_undefined());
         }
     }
 
-    return value;
-}
-
-Value* ValueFactory::object(ObjectManager &om, Value* value) {
-    std::unordered_map<std::string, Value*> v;
-    return object(om, value, v);
+    return Value(object);
 }
 
-Value* ValueFactory::object(ObjectManager &om, Value* value, std::unordered_map<std::string, Value*> v) {
-    value->type = Value::Type::Object;
-    value->value = v;
-    auto g = om.global_scope();
-    if (g != nullptr) {
-        auto prototype = om.global_scope()->get_variable("Object");
-        if (prototype.has_value()) {
-            assert(prototype.has_value());
-            value->set_property("__proto__", prototype.value());
-        }
+Value ValueFactory::object(ObjectManager &om, HeapObject* object) {
+    object->type = Value::Type::Object;
+    auto prototype = om.get_variable(atom::Object);
+    if (prototype.has_value()) {
+        object->properties[atom::Proto] = prototype.value();
     }
-    return value;
+    return Value(object);
 }
 
-Value* ValueFactory::function(ObjectManager &om, Value* value, std::optional<std::string> name) {
-    value->type = Value::Type::Function;
-    auto func = Value::Function{};
+Value ValueFactory::function(ObjectManager &om, HeapObject* object, std::optional<atom::Atom> name) {
+    object->type = Value::Type::Function;
+    auto func = Function{};
     func.name = name;
-    value->value = func;
+    object->value = func;
+    auto value = Value(object);
 
     auto prototype = om.new_object();
-    prototype->set_property("constructor", value);
-    value->set_property("prototype", prototype);
+    prototype.set_property(atom::Constructor, value);
+    value.set_property(atom::Prototype, prototype);
 
     // not sure if this one is correct
-    auto proto = om.global_scope()->get_variable("Object");
+    auto proto = om.get_variable(atom::Object);
     assert(proto.has_value());
-    value->set_property("__proto__", proto.value());
+    value.set_property(atom::Proto, proto.value());
 
     return value;
 }
 
-Value* ValueFactory::undefined(ObjectManager &om, Value* value) {
-    value->type = Value::Type::Undefined;
-    auto prototype = om.global_scope()->get_variable("Object");
-    assert(prototype.has_value());
-    value->set_property("__proto__", prototype.value());
-    return value;
-}
 
-
-}
\ No newline at end of file
+}
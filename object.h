@@ -1,11 +1,18 @@
 #pragma once
 
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <deque>
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
 #include <variant>
+#include <optional>
+#include <functional>
+#include <memory>
 
 #include "ast.h"
+#include "atom.h"
 
 namespace interpreter::object {
 
@@ -20,20 +27,37 @@ enum class ObjectType {
 };
 
 struct ObjectManager;
+struct HeapObject;
+struct Function;
+struct Array;
+
+// a value in 64 bits. a number is stored as its double, other values are
+// boxed in the bits of a quiet nan with the sign bit set, which no number has
+// once nans are made canonical. strings, objects, arrays and functions live on
+// the heap and keep the address of their HeapObject in the low 48 bits.
+// nullptr is the empty value, of a local that is not set yet or of the result
+// of something that threw
+class Value {
+    // boxed values are Boxed | tag << 48 | payload
+    static constexpr uint64_t Boxed = 0xfff8'0000'0000'0000;
+    static constexpr uint64_t TagShift = 48;
+    static constexpr uint64_t PayloadMask = (uint64_t(1) << TagShift) - 1;
+    static constexpr uint64_t CanonicalNaN = 0x7ff8'0000'0000'0000;
+
+    enum Tag : uint64_t {
+        Empty,
+        UndefinedTag,
+        NullTag,
+        BooleanTag,
+        HeapTag
+    };
 
-struct Value {
-    using native_function_handler = std::function<Value*(Value*, std::vector<Value*>)>;
+    uint64_t bits;
 
-    struct Function {
-        std::optional<std::string> name;
-        std::vector<std::string> parameters;
-        std::shared_ptr<ast::ASTNode> body;
-        bool is_builtin;
-        std::function<Value*(Value*, std::vector<Value*>)> builtin_func;
-    };
-    struct Array {
-        std::vector<Value*> elements;
-    };
+    constexpr Value(Tag tag, uint64_t payload) : bits(Boxed | tag << TagShift | payload) {}
+
+public:
+    using native_function_handler = std::function<Value(Value, std::vector<Value>)>;
 
     enum class Type {
         Object,
@@ -46,305 +70,292 @@ struct Value {
         Undefined
     };
 
-    std::unordered_map<std::string, Value*> properties;
-    Type type;
-    std::variant<double, std::string, bool, std::vector<Value*>, std::unordered_map<std::string, Value*>, Function, Array> value;
+    constexpr Value() : Value(Empty, 0) {}
+    constexpr Value(std::nullptr_t) : Value() {}
 
-    Function* function() {
-        assert(type == Type::Function);
-        return &std::get<Function>(value);
+    explicit Value(HeapObject* object) : Value(HeapTag, reinterpret_cast<uint64_t>(object)) {
+        assert((reinterpret_cast<uint64_t>(object) & ~PayloadMask) == 0);
     }
 
-    Array* array() {
-        assert(type == Type::Array);
-        return &std::get<Array>(value);
+    static Value number(double number) {
+        Value value;
+        value.bits = std::isnan(number) ? CanonicalNaN : std::bit_cast<uint64_t>(number);
+        return value;
     }
 
-    double number() {
-        assert(type == Type::Number);
-        return std::get<double>(value);
+    static constexpr Value boolean(bool boolean) {
+        return {BooleanTag, boolean};
     }
 
-    std::string string() {
-        assert(type == Type::String);
-        return std::get<std::string>(value);
+    static constexpr Value null() {
+        return {NullTag, 0};
     }
 
-    nlohmann::json to_json() {
-        switch (type) {
-            case Type::Object: {
-                nlohmann::json j;
-
-                for (auto p: properties) {
-                    if (p.first == "__proto__") {
-                        continue;
-                    }
-                    j[p.first] = p.second->to_json();
-                }
-
-                if (j.empty()) {
-                    return "{}";
-                }
-
-                return j;
-            }
-            case Type::Function:
-                return function()->is_builtin ? "Native Function" : "Function";
-            case Type::Array: {
-                nlohmann::json j;
-
-                std::vector<nlohmann::json> element_strings;
-
-                auto array = std::get<Array>(value);
-                for (auto e: array.elements) {
-                    element_strings.push_back(e->to_json());
-                }
-
-                j = element_strings;
-
-                return j;
-            }
-            case Type::Number:
-                return std::get<double>(value);
-            case Type::String:
-                return std::get<std::string>(value);
-            case Type::Boolean:
-                return std::get<bool>(value);
-            case Type::Undefined:
-                return "undefined";
-            case Type::Null:
-                return "null";
-        }
+    static constexpr Value undefined() {
+        return {UndefinedTag, 0};
     }
 
+    bool operator==(const Value &other) const = default;
 
-    std::string to_string() {
-        switch (type) {
-            case Type::Object: {
-                auto out = to_json().dump(4);
-                auto prototype_entry = properties.find("__proto__");
-                if (prototype_entry == properties.end()) {
-                    return out;
-                }
-
-                out = "[object ";
-
-                auto prototype = prototype_entry->second;
-                auto constructor = prototype->properties.find("constructor");
-                if (constructor != prototype->properties.end()) {
-                    assert(constructor->second->type == Type::Function);
-                    auto name = constructor->second->function()->name;
-                    if (name.has_value()) {
-                        out += name.value();
-                        out += "]";
-                        return out;
-                    }
-                }
-
-                out += "Object]";
-
-                return out;
-            }
-            case Type::Function:
-            case Type::Array:
-            case Type::Number:
-            case Type::String:
-            case Type::Boolean:
-            case Type::Undefined:
-            case Type::Null:
-                return to_json().dump(4);
-        }
+    bool is_number() const {
+        return (bits & Boxed) != Boxed;
     }
 
-    bool is_truthy() {
-        switch (type) {
-            case Type::Object:
-            case Type::Function:
-            case Type::Array:
-                return true;
-            case Type::Number:
-                return std::get<double>(value) != 0;
-            case Type::String:
-                return std::get<std::string>(value) != "";
-            case Type::Boolean:
-                return std::get<bool>(value);
-            case Type::Undefined:
-            case Type::Null:
-                return false;
-        }
+    bool is_heap() const {
+        return (bits & ~PayloadMask) == (Boxed | HeapTag << TagShift);
     }
 
-    bool is_undefined() {
-        return type == Type::Undefined;
+    bool is_undefined() const {
+        return *this == undefined();
     }
 
-    std::string type_of() {
-        switch (type) {
-            case Type::Function:
-                return "function";
-            case Type::Object:
-            case Type::Array:
-                return "object";
-            case Type::Number:
-                return "number";
-            case Type::String:
-                return "string";
-            case Type::Boolean:
-                return "boolean";
-            case Type::Null:
-                return "object";
-            case Type::Undefined:
-                return "undefined";
-        }
+    Type type() const;
+
+    double number() const {
+        assert(is_number());
+        return std::bit_cast<double>(bits);
+    }
+
+    bool boolean() const {
+        assert(type() == Type::Boolean);
+        return bits & 1;
     }
 
-    std::optional<Value*> get_property(ObjectManager &object_manager, std::string name);
-    std::optional<Value*> get_property(ObjectManager &object_manager, int index);
-    Value* set_property(std::string name, Value* value);
-    Value* set_property(int index, Value* value);
+    HeapObject* heap() const {
+        assert(is_heap());
+        return reinterpret_cast<HeapObject*>(bits & PayloadMask);
+    }
 
-    Value* register_native_method(ObjectManager &object_manager, std::string name, native_function_handler handler);
+    // what the heap object of a string, function or array holds
+    std::string &string() const;
+    Function* function() const;
+    Array* array() const;
+    std::unordered_map<atom::Atom, Value> &properties() const;
+
+    nlohmann::json to_json() const;
+    std::string to_string() const;
+    bool is_truthy() const;
+    std::string type_of() const;
+
+    // numbers, booleans, null and undefined have the properties of their
+    // prototype, setting one on them does nothing
+    std::optional<Value> get_property(ObjectManager &object_manager, atom::Atom name) const;
+    std::optional<Value> get_property(ObjectManager &object_manager, int index) const;
+    Value set_property(atom::Atom name, Value value) const;
+    Value set_property(int index, Value value) const;
+
+    Value register_native_method(ObjectManager &object_manager, std::string name,
+                                 native_function_handler handler) const;
 };
 
+static_assert(sizeof(Value) == 8);
 
-class ValueFactory {
-    ValueFactory();
-public:
-    static Value* number(ObjectManager &om, Value* value, double v);
-    static Value* string(ObjectManager &om, Value* value, std::string v);
-    static Value* boolean(ObjectManager &om, Value* value, bool v);
-    static Value* null(ObjectManager &om, Value* value);
-    static Value* array(ObjectManager &om, Value* value, std::optional<int> length);
-    static Value* array(ObjectManager &om, Value* value, std::vector<Value*> v, std::optional<int> length);
-    static Value* object(ObjectManager &om, Value* value);
-    static Value* object(ObjectManager &om, Value* value, std::unordered_map<std::string, Value*> v);
-    static Value* function(ObjectManager &om, Value* value, std::optional<std::string> name);
-    static Value* undefined(ObjectManager &om, Value* value);
+// the slots of the captured variables of one call of a function, `parent` is
+// the environment the function was created in. a block with captured
+// variables gets one each time it runs whose parent is the one around it
+struct Environment {
+    std::vector<Value> slots;
+    Environment* parent;
 };
 
+struct Function {
+    std::optional<atom::Atom> name;
+    std::vector<atom::Atom> parameters;
+    ast::ASTNode* body = nullptr;
+    // index of the body in the interpreter's flat program when the flat engine created the function
+    std::optional<uint32_t> flat_body;
+    // index of the function in the interpreter's bytecode program when the bytecode engine created it
+    std::optional<uint32_t> bytecode_function;
+    ast::Scope* scope = nullptr;
+    Environment* environment = nullptr;
+    bool is_builtin = false;
+    Value::native_function_handler builtin_func;
+};
 
-class ObjectManager {
-    struct Scope {
-        ObjectManager &om;
-        Value* context;
-        bool is_global;
+struct Array {
+    std::vector<Value> elements;
+};
 
-        Scope(ObjectManager &om, Value* context, bool is_global = false)
-                : om(om), context(context), is_global(is_global) {}
+// a string, object, array or function, the only values that are allocated
+struct HeapObject {
+    std::unordered_map<atom::Atom, Value> properties;
+    Value::Type type;
+    std::variant<std::monostate, std::string, Function, Array> value;
+};
 
-        std::unordered_set<Value*> values_in_scope;
-        std::unordered_map<std::string, Value*> variables;
+inline Value::Type Value::type() const {
+    if (is_number()) {
+        return Type::Number;
+    }
 
-        std::optional<Value*> get_variable(std::string name) {
-            if (is_global) {
-                return context->get_property(om, name);
-            }
+    switch (static_cast<Tag>(bits >> TagShift & 0x7)) {
+        case UndefinedTag:
+            return Type::Undefined;
+        case NullTag:
+            return Type::Null;
+        case BooleanTag:
+            return Type::Boolean;
+        case HeapTag:
+            return heap()->type;
+        case Empty:
+            break;
+    }
 
-            if (auto entry = variables.find(name); entry != variables.end()) {
-                return entry->second;
-            }
+    assert(false);
+}
+
+inline std::string &Value::string() const {
+    assert(type() == Type::String);
+    return std::get<std::string>(heap()->value);
+}
+
+inline Function* Value::function() const {
+    assert(type() == Type::Function);
+    return &std::get<Function>(heap()->value);
+}
+
+inline Array* Value::array() const {
+    assert(type() == Type::Array);
+    return &std::get<Array>(heap()->value);
+}
+
+inline std::unordered_map<atom::Atom, Value> &Value::properties() const {
+    return heap()->properties;
+}
+
+inline bool Value::is_truthy() const {
+    switch (type()) {
+        case Type::Object:
+        case Type::Function:
+        case Type::Array:
+            return true;
+        case Type::Number:
+            return number() != 0;
+        case Type::String:
+            return string() != "";
+        case Type::Boolean:
+            return boolean();
+        case Type::Undefined:
+        case Type::Null:
+            return false;
+    }
 
-            return {};
-        }
+    assert(false);
+}
 
-        Value* set_variable(std::string name, Value* value) {
-            if (is_global) {
-                return context->set_property(name, value);
-            }
 
-            variables[name] = value;
-            return value;
-        }
+// sets up a newly allocated heap object as a value of its type
+class ValueFactory {
+    ValueFactory();
+public:
+    static Value string(ObjectManager &om, HeapObject* object, std::string v);
+    static Value array(ObjectManager &om, HeapObject* object, std::optional<int> length);
+    static Value array(ObjectManager &om, HeapObject* object, std::vector<Value> v, std::optional<int> length);
+    static Value object(ObjectManager &om, HeapObject* object);
+    static Value function(ObjectManager &om, HeapObject* object, std::optional<atom::Atom> name);
+};
 
-        Value* this_context() {
-            return context;
-        }
-    };
 
-    struct Cell {
-        Value* value;
-        bool is_referenced;
-    };
+// a call of a function, `locals` are its slots on the frame stack and
+// `environment` has the slots of its captured variables if it has any, or
+// those of the innermost block running that has some
+struct Frame {
+    Value context;
+    Value* locals;
+    uint32_t size;
+    Environment* environment;
+    // the environment the function was created in
+    Environment* outer;
+};
 
-    std::vector<Scope> scopes;
-    int current_scope_index = 0;
+class ObjectManager {
+    std::vector<Frame> frames;
+    // slots of the variables that are not captured, pushed and popped with the frames
+    static constexpr size_t stack_capacity = 1 << 20;
+    std::unique_ptr<Value[]> stack;
+    size_t stack_top = 0;
 
-    std::unordered_map<Value*, Cell> objects;
+    // every allocated value, in order
+    std::vector<HeapObject*> objects;
+    // environments are never freed yet, closures can hold on to any of them
+    std::deque<Environment> environments;
 
     const int gc_threshold = 25000;
     int gc_amount = 0;
     int objects_collected = 0;
 
-    Value* global;
+    Value global = nullptr;
 
     void collect_garbage();
 
     template<typename T, typename ... Args>
     T* allocate(Args &&... args);
 
-    bool is_value_still_in_scope(Value* v) {
-        auto i = current_scope_index;
-
-        while (i >= 0) {
-            auto scope = scopes[i];
-            auto value = scope.values_in_scope.find(v);
-            if (value != scope.values_in_scope.end()) {
-                return true;
-            }
-
-            i--;
-        }
-
-        return false;
-    }
-
-
 public:
     ObjectManager() {
         global = new_object();
-        // push top level scope
-        scopes.push_back(Scope{*this, global, true});
+        stack.reset(new Value[stack_capacity]);
+        frames.reserve(1024);
+
+        // the top level frame, it grows as top level statements are resolved
+        auto environment = new_environment(0, nullptr);
+        frames.push_back(Frame{global, nullptr, 0, environment, nullptr});
     }
 
-    Value* new_object() {
-        return ValueFactory::object(*this, allocate<Value>());
+    Value new_object() {
+        return ValueFactory::object(*this, allocate<HeapObject>());
     }
-    Value* new_function() {
-        return ValueFactory::function(*this, allocate<Value>(), {});
+    Value new_function() {
+        return ValueFactory::function(*this, allocate<HeapObject>(), {});
     }
-    Value* new_function(std::optional<std::string> name) {
-        return ValueFactory::function(*this, allocate<Value>(), name);
+    Value new_function(std::optional<atom::Atom> name) {
+        return ValueFactory::function(*this, allocate<HeapObject>(), name);
     }
-    Value* new_array() {
-        return ValueFactory::array(*this, allocate<Value>(), {});
+    Value new_array() {
+        return ValueFactory::array(*this, allocate<HeapObject>(), {});
     }
-    Value* new_array(int length) {
-        return ValueFactory::array(*this, allocate<Value>(), length);
+    Value new_array(int length) {
+        return ValueFactory::array(*this, allocate<HeapObject>(), length);
     }
-    Value* new_number(double value) {
-        return ValueFactory::number(*this, allocate<Value>(), value);
+    Value new_string(std::string value) {
+        return ValueFactory::string(*this, allocate<HeapObject>(), value);
     }
-    Value* new_string(std::string value) {
-        return ValueFactory::string(*this, allocate<Value>(), value);
+    // the other values are not allocated
+    Value new_number(double value) {
+        return Value::number(value);
     }
-    Value* new_boolean(bool value) {
-        return ValueFactory::boolean(*this, allocate<Value>(), value);
+    Value new_boolean(bool value) {
+        return Value::boolean(value);
     }
-    Value* new_null() {
-        return ValueFactory::null(*this, allocate<Value>());
+    Value new_null() {
+        return Value::null();
     }
-    Value* new_undefined() {
-        return ValueFactory::undefined(*this, allocate<Value>());
+    Value new_undefined() {
+        return Value::undefined();
     }
 
-    void push_scope(Value* context);
-    void pop_scope();
-    Scope* current_scope();
-    Scope* global_scope();
-    Value* global_object();
-    std::optional<object::Value*> get_variable(std::string name);
-    Value* set_variable(std::string name, Value* value);
-    Value* declare_variable(std::string name, Value* value);
+    Environment* new_environment(size_t size, Environment* parent);
+
+    // returns nullptr when the frame stack is full
+    Frame* push_frame(Value context, uint32_t size, uint32_t environment_size, Environment* outer);
+    void pop_frame();
+    // the environment of a block with captured variables, while it runs
+    void push_environment(uint32_t size);
+    void pop_environment();
+    // a loop gives each iteration a copy of its environment, so the functions
+    // created in one keep the values it ended with
+    void renew_environment();
+    Frame &current_frame() {
+        return frames.back();
+    }
+    Frame &global_frame() {
+        return frames.front();
+    }
+    void resize_global_environment(uint32_t size);
+    Value global_object();
+    // global variables, the properties of the global object
+    std::optional<Value> get_variable(atom::Atom name);
+    Value set_variable(atom::Atom name, Value value);
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,1372 @@
+#include "optimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace optimizer {
+
+namespace {
+
+bool is_literal(ast::Expression* e) {
+    switch (e->type) {
+        case ast::ExpressionType::NumberLiteral:
+        case ast::ExpressionType::StringLiteral:
+        case ast::ExpressionType::BooleanLiteral:
+        case ast::ExpressionType::NullLiteral:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_truthy(ast::Expression* literal) {
+    switch (literal->type) {
+        case ast::ExpressionType::NumberLiteral:
+            return literal->as_number_literal()->value != 0;
+        case ast::ExpressionType::StringLiteral:
+            return !literal->as_string_literal()->value.empty();
+        case ast::ExpressionType::BooleanLiteral:
+            return literal->as_boolean_literal()->value;
+        case ast::ExpressionType::NullLiteral:
+            return false;
+        default:
+            assert(false);
+    }
+}
+
+std::string type_of(ast::Expression* literal) {
+    switch (literal->type) {
+        case ast::ExpressionType::NumberLiteral:
+            return "number";
+        case ast::ExpressionType::StringLiteral:
+            return "string";
+        case ast::ExpressionType::BooleanLiteral:
+            return "boolean";
+        case ast::ExpressionType::NullLiteral:
+            return "object";
+        default:
+            assert(false);
+    }
+}
+
+// as Value::to_string prints numbers
+std::string number_to_string(double value) {
+    return nlohmann::json(value).dump();
+}
+
+void assignments(ast::ASTNode* node, std::unordered_set<atom::Atom> &assigned);
+
+void assignments(ast::Expression* expression, std::unordered_set<atom::Atom> &assigned) {
+    if (expression == nullptr) {
+        return;
+    }
+
+    auto all = [&](const std::vector<ast::Expression*> &expressions) {
+        for (auto e: expressions) {
+            assignments(e, assigned);
+        }
+    };
+
+    switch (expression->type) {
+        case ast::ExpressionType::VariableDeclaration:
+            assignments(expression->as_variable_declaration()->value, assigned);
+            return;
+        case ast::ExpressionType::Assignment: {
+            auto e = expression->as_assignment();
+            if (e->left->type == ast::ExpressionType::Identifier) {
+                assigned.insert(e->left->as_identifier()->name);
+            } else {
+                assignments(e->left, assigned);
+            }
+            assignments(e->right, assigned);
+            return;
+        }
+        case ast::ExpressionType::Update: {
+            auto e = expression->as_update();
+            if (e->argument->type == ast::ExpressionType::Identifier) {
+                assigned.insert(e->argument->as_identifier()->name);
+            } else {
+                assignments(e->argument, assigned);
+            }
+            return;
+        }
+        case ast::ExpressionType::Call:
+            assignments(expression->as_call()->callee, assigned);
+            all(expression->as_call()->arguments);
+            return;
+        case ast::ExpressionType::New:
+            assignments(expression->as_new()->callee, assigned);
+            all(expression->as_new()->arguments);
+            return;
+        case ast::ExpressionType::Member:
+            assignments(expression->as_member()->object, assigned);
+            if (expression->as_member()->is_computed) {
+                assignments(expression->as_member()->property, assigned);
+            }
+            return;
+        case ast::ExpressionType::Binary:
+            all({expression->as_binary()->left, expression->as_binary()->right});
+            return;
+        case ast::ExpressionType::Unary:
+            assignments(expression->as_unary()->argument, assigned);
+            return;
+        case ast::ExpressionType::Ternary: {
+            auto e = expression->as_ternary();
+            all({e->test, e->consequent, e->alternative});
+            return;
+        }
+        case ast::ExpressionType::Object:
+            for (auto &p: expression->as_object()->properties) {
+                assignments(p.second, assigned);
+            }
+            return;
+        case ast::ExpressionType::Array:
+            all(expression->as_array()->elements);
+            return;
+        case ast::ExpressionType::Function:
+            assignments(expression->as_function()->body, assigned);
+            return;
+        case ast::ExpressionType::ArrowFunction:
+            assignments(expression->as_arrow_function()->body, assigned);
+            return;
+        case ast::ExpressionType::Identifier:
+        case ast::ExpressionType::NumberLiteral:
+        case ast::ExpressionType::StringLiteral:
+        case ast::ExpressionType::BooleanLiteral:
+        case ast::ExpressionType::NullLiteral:
+        case ast::ExpressionType::This:
+            return;
+    }
+
+    assert(false);
+}
+
+// the names assigned to or updated in a statement and the functions in it
+void assignments(ast::Statement* statement, std::unordered_set<atom::Atom> &assigned) {
+    switch (statement->type) {
+        case ast::StatementType::Expression:
+            assignments(statement->as_expression_statement()->expression, assigned);
+            return;
+        case ast::StatementType::Block:
+            for (auto s: statement->as_block()->body) {
+                assignments(s, assigned);
+            }
+            return;
+        case ast::StatementType::LazyBlock: {
+            auto s = statement->as_lazy_block();
+            if (s->block != nullptr) {
+                assignments(s->block, assigned);
+            } else {
+                assigned.insert(s->assigned.begin(), s->assigned.end());
+            }
+            return;
+        }
+        case ast::StatementType::If: {
+            auto s = statement->as_if();
+            assignments(s->test, assigned);
+            assignments(s->consequent, assigned);
+            if (s->alternative != nullptr) {
+                assignments(s->alternative, assigned);
+            }
+            return;
+        }
+        case ast::StatementType::FunctionDeclaration:
+            assignments(statement->as_function_declaration()->body, assigned);
+            return;
+        case ast::StatementType::While:
+            assignments(statement->as_while()->test, assigned);
+            assignments(statement->as_while()->body, assigned);
+            return;
+        case ast::StatementType::For: {
+            auto s = statement->as_for();
+            assignments(s->init, assigned);
+            assignments(s->test, assigned);
+            assignments(s->update, assigned);
+            assignments(s->body, assigned);
+            return;
+        }
+        case ast::StatementType::Return:
+            assignments(statement->as_return()->argument, assigned);
+            return;
+        case ast::StatementType::Throw:
+            assignments(statement->as_throw()->argument, assigned);
+            return;
+        case ast::StatementType::TryCatch:
+            assignments(statement->as_trycatch()->try_body, assigned);
+            assignments(statement->as_trycatch()->catch_body, assigned);
+            return;
+        case ast::StatementType::Break:
+        case ast::StatementType::Continue:
+            return;
+    }
+
+    assert(false);
+}
+
+void assignments(ast::ASTNode* node, std::unordered_set<atom::Atom> &assigned) {
+    if (node->type == ast::ASTNodeType::Statement) {
+        assignments(static_cast<ast::Statement*>(node), assigned);
+    } else {
+        assignments(static_cast<ast::Expression*>(node), assigned);
+    }
+}
+
+}
+
+ConstantFolder::ConstantFolder(ast::Arena &nodes) : nodes(nodes) {
+    constants = &links.emplace_back(Constants{nullptr, {}, {}, {}, false, {}});
+}
+
+// the constants of the function or top level a block is in
+ConstantFolder::Constants* ConstantFolder::function_of(Constants* c) {
+    while (c->block) {
+        c = c->parent;
+    }
+    return c;
+}
+
+ast::Expression* ConstantFolder::lookup(atom::Atom name) {
+    auto function = function_of(constants);
+    for (auto c = constants; c != nullptr; c = c->parent) {
+        if (auto entry = c->values.find(name); entry != c->values.end()) {
+            // a hoisted function or a closure could have been called before
+            // the const was declared, when reading it throws
+            if (function_of(c) != function && c->late.contains(name)) {
+                return nullptr;
+            }
+            return entry->second;
+        }
+
+        if (c->declared.contains(name)) {
+            return nullptr;
+        }
+    }
+
+    return nullptr;
+}
+
+// declared by a function around the current code, reading it cannot throw
+bool ConstantFolder::is_local(atom::Atom name) {
+    for (auto c = constants; c->parent != nullptr; c = c->parent) {
+        if (c->declared.contains(name)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// every use gets its own node, so the ast stays a tree
+ast::Expression* ConstantFolder::copy(ast::Expression* literal) {
+    switch (literal->type) {
+        case ast::ExpressionType::NumberLiteral:
+            return nodes.make<ast::NumberLiteralExpression>(literal->as_number_literal()->value);
+        case ast::ExpressionType::StringLiteral:
+            return nodes.make<ast::StringLiteralExpression>(literal->as_string_literal()->value);
+        case ast::ExpressionType::BooleanLiteral:
+            return nodes.make<ast::BooleanLiteralExpression>(literal->as_boolean_literal()->value);
+        case ast::ExpressionType::NullLiteral:
+            return nodes.make<ast::NullLiteralExpression>();
+        default:
+            assert(false);
+    }
+}
+
+// the names declared in a function body, without going into the functions in
+// it. the let and const of the blocks in it are only declared while the block
+// is folded, `lexical` is set for the statements of the body itself
+void ConstantFolder::declare(ast::Statement* statement, std::unordered_set<atom::Atom> &declared, bool lexical) {
+    switch (statement->type) {
+        case ast::StatementType::Expression: {
+            auto e = statement->as_expression_statement()->expression;
+            if (e->type == ast::ExpressionType::VariableDeclaration &&
+                (lexical || e->as_variable_declaration()->type == ast::VariableType::Var)) {
+                for (auto name: e->as_variable_declaration()->identifiers) {
+                    declared.insert(name);
+                }
+            }
+            return;
+        }
+        case ast::StatementType::Block:
+            for (auto s: statement->as_block()->body) {
+                declare(s, declared, false);
+            }
+            return;
+        case ast::StatementType::If:
+            declare(statement->as_if()->consequent, declared, false);
+            if (statement->as_if()->alternative != nullptr) {
+                declare(statement->as_if()->alternative, declared, false);
+            }
+            return;
+        case ast::StatementType::FunctionDeclaration:
+            declared.insert(statement->as_function_declaration()->identifier);
+            return;
+        case ast::StatementType::While:
+            declare(statement->as_while()->body, declared, false);
+            return;
+        case ast::StatementType::For: {
+            auto s = statement->as_for();
+            if (s->init != nullptr && s->init->type == ast::ExpressionType::VariableDeclaration &&
+                s->init->as_variable_declaration()->type == ast::VariableType::Var) {
+                for (auto name: s->init->as_variable_declaration()->identifiers) {
+                    declared.insert(name);
+                }
+            }
+            declare(s->body, declared, false);
+            return;
+        }
+        case ast::StatementType::TryCatch:
+            declare(statement->as_trycatch()->try_body, declared, false);
+            declare(statement->as_trycatch()->catch_body, declared, false);
+            return;
+        case ast::StatementType::LazyBlock:
+        case ast::StatementType::Return:
+        case ast::StatementType::Throw:
+        case ast::StatementType::Break:
+        case ast::StatementType::Continue:
+            return;
+    }
+
+    assert(false);
+}
+
+ast::ASTNode* ConstantFolder::fold_function(std::optional<atom::Atom> name,
+                                            const std::vector<atom::Atom> &parameters, ast::ASTNode* body) {
+    auto outer = constants;
+    constants = &links.emplace_back(Constants{outer, {}, {parameters.begin(), parameters.end()}, {}, false, {}});
+    if (name.has_value()) {
+        constants->declared.insert(name.value());
+    }
+    assignments(body, constants->assigned.emplace());
+
+    if (body->type == ast::ASTNodeType::Expression) {
+        auto e = static_cast<ast::Expression*>(body);
+        fold(e);
+        body = e;
+    } else {
+        auto s = static_cast<ast::Statement*>(body);
+        if (s->type == ast::StatementType::LazyBlock && s->as_lazy_block()->block == nullptr) {
+            // folded when it is parsed
+            lazy[s->as_lazy_block()] = constants;
+        } else {
+            declare(s, constants->declared, false);
+            fold(s);
+        }
+    }
+
+    constants = outer;
+    return body;
+}
+
+void ConstantFolder::see_program(const std::vector<ast::Statement*> &program) {
+    auto &assigned = links.front().assigned.emplace();
+    for (auto s: program) {
+        assignments(s, assigned);
+    }
+}
+
+void ConstantFolder::fold_top_level(ast::Statement* statement) {
+    assert(constants == &links.front());
+    // top level variables are globals, they can be inlined arguments once declared
+    declare(statement, constants->declared, true);
+    fold(statement);
+}
+
+void ConstantFolder::fold_body(ast::LazyBlockStatement* lazy_body) {
+    auto entry = lazy.find(lazy_body);
+    if (entry == lazy.end()) {
+        // not seen by the folder, as when folding was turned on after it was parsed
+        return;
+    }
+
+    auto outer = constants;
+    constants = entry->second;
+    lazy.erase(entry);
+
+    // what the body assigns to is now known exactly
+    assignments(lazy_body->block, constants->assigned.emplace());
+    declare(lazy_body->block, constants->declared, false);
+    fold(lazy_body->block);
+
+    constants = outer;
+}
+
+void ConstantFolder::fold(ast::Statement* statement) {
+    switch (statement->type) {
+        case ast::StatementType::Expression:
+            fold(statement->as_expression_statement()->expression);
+            return;
+        case ast::StatementType::Block: {
+            // the let and const of a block are not seen outside it
+            auto outer = constants;
+            constants = &links.emplace_back(Constants{outer, {}, {}, {}, false, {}, true});
+            for (auto s: statement->as_block()->body) {
+                declare(s, constants->declared, true);
+            }
+
+            for (auto s: statement->as_block()->body) {
+                fold(s);
+            }
+            constants = outer;
+            return;
+        }
+        case ast::StatementType::LazyBlock: {
+            auto s = statement->as_lazy_block();
+            if (s->block != nullptr) {
+                fold(s->block);
+            }
+            return;
+        }
+        case ast::StatementType::If: {
+            auto s = statement->as_if();
+            fold(s->test);
+            fold(s->consequent);
+            if (s->alternative != nullptr) {
+                fold(s->alternative);
+            }
+            return;
+        }
+        case ast::StatementType::FunctionDeclaration: {
+            auto s = statement->as_function_declaration();
+            s->body = static_cast<ast::Statement*>(fold_function({}, s->parameters, s->body));
+            return;
+        }
+        case ast::StatementType::While:
+            fold(statement->as_while()->test);
+            fold(statement->as_while()->body);
+            return;
+        case ast::StatementType::For: {
+            auto s = statement->as_for();
+            auto outer = constants;
+            if (s->init->type == ast::ExpressionType::VariableDeclaration &&
+                s->init->as_variable_declaration()->type != ast::VariableType::Var) {
+                auto &names = s->init->as_variable_declaration()->identifiers;
+                constants = &links.emplace_back(
+                        Constants{outer, {}, {names.begin(), names.end()}, {}, false, {}, true});
+            }
+
+            fold(s->init);
+            fold(s->test);
+            fold(s->update);
+            fold(s->body);
+            constants = outer;
+            return;
+        }
+        case ast::StatementType::Return:
+            fold(statement->as_return()->argument);
+            return;
+        case ast::StatementType::Throw:
+            fold(statement->as_throw()->argument);
+            return;
+        case ast::StatementType::Break:
+        case ast::StatementType::Continue:
+            return;
+        case ast::StatementType::TryCatch: {
+            auto s = statement->as_trycatch();
+            fold(s->try_body);
+
+            // the catch parameter hides a const of the same name from here on
+            constants->values.erase(s->catch_identifier);
+            constants->declared.insert(s->catch_identifier);
+            fold(s->catch_body);
+            return;
+        }
+    }
+
+    assert(false);
+}
+
+void ConstantFolder::fold(ast::Expression* &expression) {
+    if (expression == nullptr) {
+        return;
+    }
+
+    switch (expression->type) {
+        case ast::ExpressionType::VariableDeclaration: {
+            auto e = expression->as_variable_declaration();
+            fold(e->value);
+
+            auto function = function_of(constants);
+            if (e->type != ast::VariableType::Const || e->value == nullptr || !function->assigned.has_value()) {
+                return;
+            }
+
+            if ((fold_literals && is_literal(e->value)) || inline_body(e->value) != nullptr) {
+                for (auto name: e->identifiers) {
+                    if (!function->assigned->contains(name)) {
+                        constants->values[name] = e->value;
+                        if (function->called) {
+                            constants->late.insert(name);
+                        }
+                    }
+                }
+            }
+            return;
+        }
+        case ast::ExpressionType::Call: {
+            auto e = expression->as_call();
+            function_of(constants)->called = true;
+            fold(e->callee);
+            for (auto &arg: e->arguments) {
+                fold(arg);
+            }
+
+            if (e->callee->type != ast::ExpressionType::Identifier || inlining) {
+                return;
+            }
+
+            auto function = lookup(e->callee->as_identifier()->name);
+            if (function == nullptr || is_literal(function)) {
+                return;
+            }
+
+            if (auto inlined = inline_call(function, e); inlined != nullptr) {
+                // what the arguments make foldable
+                inlining = true;
+                fold(inlined);
+                inlining = false;
+                expression = inlined;
+            }
+            return;
+        }
+        case ast::ExpressionType::New: {
+            auto e = expression->as_new();
+            function_of(constants)->called = true;
+            fold(e->callee);
+            for (auto &arg: e->arguments) {
+                fold(arg);
+            }
+            return;
+        }
+        case ast::ExpressionType::Member: {
+            auto e = expression->as_member();
+            fold(e->object);
+            // a property name is not a variable
+            if (e->is_computed) {
+                fold(e->property);
+            }
+            return;
+        }
+        case ast::ExpressionType::Identifier: {
+            auto value = lookup(expression->as_identifier()->name);
+            if (value != nullptr && is_literal(value)) {
+                expression = copy(value);
+            }
+            return;
+        }
+        case ast::ExpressionType::NumberLiteral:
+        case ast::ExpressionType::StringLiteral:
+        case ast::ExpressionType::BooleanLiteral:
+        case ast::ExpressionType::NullLiteral:
+        case ast::ExpressionType::This:
+            return;
+        case ast::ExpressionType::Binary: {
+            auto e = expression->as_binary();
+            fold(e->left);
+            fold(e->right);
+            if (auto folded = fold_literals ? fold_binary(e) : nullptr; folded != nullptr) {
+                expression = folded;
+            }
+            return;
+        }
+        case ast::ExpressionType::Assignment: {
+            auto e = expression->as_assignment();
+            // the variable assigned to stays
+            if (e->left->type != ast::ExpressionType::Identifier) {
+                fold(e->left);
+            }
+            fold(e->right);
+            return;
+        }
+        case ast::ExpressionType::Unary: {
+            auto e = expression->as_unary();
+            fold(e->argument);
+            if (auto folded = fold_literals ? fold_unary(e) : nullptr; folded != nullptr) {
+                expression = folded;
+            }
+            return;
+        }
+        case ast::ExpressionType::Update:
+            return;
+        case ast::ExpressionType::Ternary: {
+            auto e = expression->as_ternary();
+            fold(e->test);
+            fold(e->consequent);
+            fold(e->alternative);
+            if (fold_literals && is_literal(e->test)) {
+                expression = is_truthy(e->test) ? e->consequent : e->alternative;
+            }
+            return;
+        }
+        case ast::ExpressionType::Object:
+            for (auto &p: expression->as_object()->properties) {
+                fold(p.second);
+            }
+            return;
+        case ast::ExpressionType::Array:
+            for (auto &element: expression->as_array()->elements) {
+                fold(element);
+            }
+            return;
+        case ast::ExpressionType::Function: {
+            auto e = expression->as_function();
+            e->body = static_cast<ast::Statement*>(fold_function(e->identifier, e->parameters, e->body));
+            return;
+        }
+        case ast::ExpressionType::ArrowFunction: {
+            auto e = expression->as_arrow_function();
+            e->body = fold_function({}, e->parameters, e->body);
+            return;
+        }
+    }
+
+    assert(false);
+}
+
+ast::Expression* ConstantFolder::fold_unary(ast::UnaryExpression* e) {
+    if (!is_literal(e->argument)) {
+        return nullptr;
+    }
+
+    switch (e->op) {
+        case ast::Operator::Not:
+            return nodes.make<ast::BooleanLiteralExpression>(!is_truthy(e->argument));
+        case ast::Operator::Typeof:
+            return nodes.make<ast::StringLiteralExpression>(type_of(e->argument));
+        default:
+            return nullptr;
+    }
+}
+
+ast::Expression* ConstantFolder::fold_binary(ast::BinaryExpression* e) {
+    auto left = e->left;
+    auto right = e->right;
+
+    if (left->type == ast::ExpressionType::NumberLiteral && right->type == ast::ExpressionType::NumberLiteral) {
+        auto l = left->as_number_literal()->value;
+        auto r = right->as_number_literal()->value;
+
+        auto number = [&](double value) {
+            return nodes.make<ast::NumberLiteralExpression>(value);
+        };
+        auto boolean = [&](bool value) {
+            return nodes.make<ast::BooleanLiteralExpression>(value);
+        };
+
+        switch (e->op) {
+            case ast::Operator::Plus:
+                return number(l + r);
+            case ast::Operator::Minus:
+                return number(l - r);
+            case ast::Operator::Multiply:
+                return number(l * r);
+            case ast::Operator::Divide:
+                return number(l / r);
+            case ast::Operator::Modulo:
+                return number(std::fmod(l, r));
+            case ast::Operator::Exponentiation:
+                return number(std::pow(l, r));
+            case ast::Operator::BitwiseAnd:
+                return number(static_cast<int>(l) & static_cast<int>(r));
+            case ast::Operator::BitwiseOr:
+                return number(static_cast<int>(l) | static_cast<int>(r));
+            case ast::Operator::EqualTo:
+            case ast::Operator::EqualToStrict:
+                return boolean(l == r);
+            case ast::Operator::NotEqualTo:
+            case ast::Operator::NotEqualToStrict:
+                return boolean(l != r);
+            case ast::Operator::GreaterThan:
+                return boolean(l > r);
+            case ast::Operator::GreaterThanOrEqualTo:
+                return boolean(l >= r);
+            case ast::Operator::LessThan:
+                return boolean(l < r);
+            case ast::Operator::LessThanOrEqualTo:
+                return boolean(l <= r);
+            case ast::Operator::And:
+                return boolean(l != 0 && r != 0);
+            case ast::Operator::Or:
+                return boolean(l != 0 || r != 0);
+            default:
+                return nullptr;
+        }
+    }
+
+    if (e->op != ast::Operator::Plus) {
+        return nullptr;
+    }
+
+    auto to_string = [](ast::Expression* literal) -> std::optional<std::string> {
+        if (literal->type == ast::ExpressionType::StringLiteral) {
+            return literal->as_string_literal()->value;
+        }
+        if (literal->type == ast::ExpressionType::NumberLiteral) {
+            return number_to_string(literal->as_number_literal()->value);
+        }
+        return {};
+    };
+
+    // at least one of them is a string
+    auto l = to_string(left);
+    auto r = to_string(right);
+    if (!l.has_value() || !r.has_value()) {
+        return nullptr;
+    }
+
+    return nodes.make<ast::StringLiteralExpression>(l.value() + r.value());
+}
+
+namespace {
+
+// the number of nodes in an expression that only uses the given names as
+// variables, or nothing if it uses anything else
+std::optional<uint32_t> measure(ast::Expression* e, const std::vector<atom::Atom> &parameters) {
+    auto all = [&](const std::vector<ast::Expression*> &expressions) -> std::optional<uint32_t> {
+        uint32_t size = 0;
+        for (auto x: expressions) {
+            auto n = measure(x, parameters);
+            if (!n.has_value()) {
+                return {};
+            }
+            size += n.value();
+        }
+        return size;
+    };
+    auto plus_one = [](std::optional<uint32_t> n) -> std::optional<uint32_t> {
+        return n.has_value() ? std::optional<uint32_t>(n.value() + 1) : std::nullopt;
+    };
+
+    switch (e->type) {
+        case ast::ExpressionType::Identifier:
+            if (std::find(parameters.begin(), parameters.end(), e->as_identifier()->name) == parameters.end()) {
+                return {};
+            }
+            return 1;
+        case ast::ExpressionType::NumberLiteral:
+        case ast::ExpressionType::StringLiteral:
+        case ast::ExpressionType::BooleanLiteral:
+        case ast::ExpressionType::NullLiteral:
+            return 1;
+        case ast::ExpressionType::Binary:
+            return plus_one(all({e->as_binary()->left, e->as_binary()->right}));
+        case ast::ExpressionType::Unary:
+            return plus_one(measure(e->as_unary()->argument, parameters));
+        case ast::ExpressionType::Ternary: {
+            auto t = e->as_ternary();
+            return plus_one(all({t->test, t->consequent, t->alternative}));
+        }
+        case ast::ExpressionType::Member: {
+            auto m = e->as_member();
+            return plus_one(m->is_computed ? all({m->object, m->property}) : measure(m->object, parameters));
+        }
+        case ast::ExpressionType::Call: {
+            auto c = e->as_call();
+            auto arguments = all(c->arguments);
+            auto callee = measure(c->callee, parameters);
+            if (!arguments.has_value() || !callee.has_value()) {
+                return {};
+            }
+            return arguments.value() + callee.value() + 1;
+        }
+        case ast::ExpressionType::Array:
+            return plus_one(all(e->as_array()->elements));
+        default:
+            // declarations, assignments, functions and this
+            return {};
+    }
+}
+
+// a variable an inlinable body reads, whether a call in the body can have run
+// before it and whether it is only read on some paths
+struct Read {
+    atom::Atom name;
+    bool after_call;
+    bool conditional;
+};
+
+// the variables an inlinable body reads in the order the engines evaluate
+// them, which is the right side of a binary expression first
+void reads(ast::Expression* e, std::vector<Read> &order, bool &called, bool conditional) {
+    switch (e->type) {
+        case ast::ExpressionType::Identifier:
+            order.push_back({e->as_identifier()->name, called, conditional});
+            return;
+        case ast::ExpressionType::Binary: {
+            // both sides are always evaluated, && and || do not short circuit
+            auto b = e->as_binary();
+            reads(b->right, order, called, conditional);
+            reads(b->left, order, called, conditional);
+            return;
+        }
+        case ast::ExpressionType::Unary:
+            reads(e->as_unary()->argument, order, called, conditional);
+            return;
+        case ast::ExpressionType::Ternary:
+            reads(e->as_ternary()->test, order, called, conditional);
+            reads(e->as_ternary()->consequent, order, called, true);
+            reads(e->as_ternary()->alternative, order, called, true);
+            return;
+        case ast::ExpressionType::Member:
+            reads(e->as_member()->object, order, called, conditional);
+            if (e->as_member()->is_computed) {
+                reads(e->as_member()->property, order, called, conditional);
+            }
+            return;
+        case ast::ExpressionType::Call:
+            reads(e->as_call()->callee, order, called, conditional);
+            for (auto arg: e->as_call()->arguments) {
+                reads(arg, order, called, conditional);
+            }
+            called = true;
+            return;
+        case ast::ExpressionType::Array:
+            for (auto element: e->as_array()->elements) {
+                reads(element, order, called, conditional);
+            }
+            return;
+        default:
+            // literals, measure does not let anything else through
+            return;
+    }
+}
+
+}
+
+// the expression a function returns if it can be inlined
+ast::Expression* ConstantFolder::inline_body(ast::Expression* function) {
+    if (inline_budget == 0) {
+        return nullptr;
+    }
+
+    const std::vector<atom::Atom>* parameters;
+    ast::ASTNode* body;
+
+    if (function->type == ast::ExpressionType::ArrowFunction) {
+        parameters = &function->as_arrow_function()->parameters;
+        body = function->as_arrow_function()->body;
+    } else if (function->type == ast::ExpressionType::Function) {
+        parameters = &function->as_function()->parameters;
+        body = function->as_function()->body;
+    } else {
+        return nullptr;
+    }
+
+    ast::Expression* returned = nullptr;
+    if (body->type == ast::ASTNodeType::Expression) {
+        returned = static_cast<ast::Expression*>(body);
+    } else if (static_cast<ast::Statement*>(body)->type == ast::StatementType::Block) {
+        // bodies that are only pre-parsed are not looked into
+        auto block = static_cast<ast::Statement*>(body)->as_block();
+        if (block->body.size() == 1 && block->body[0]->type == ast::StatementType::Return) {
+            returned = block->body[0]->as_return()->argument;
+        }
+    }
+
+    if (returned == nullptr) {
+        return nullptr;
+    }
+
+    std::unordered_set<atom::Atom> unique(parameters->begin(), parameters->end());
+    if (unique.size() != parameters->size()) {
+        return nullptr;
+    }
+
+    auto size = measure(returned, *parameters);
+    if (!size.has_value() || size.value() > inline_budget) {
+        return nullptr;
+    }
+
+    return returned;
+}
+
+ast::Expression* ConstantFolder::inline_call(ast::Expression* function, ast::CallExpression* call) {
+    auto returned = inline_body(function);
+    if (returned == nullptr) {
+        return nullptr;
+    }
+
+    auto &parameters = function->type == ast::ExpressionType::ArrowFunction
+                       ? function->as_arrow_function()->parameters
+                       : function->as_function()->parameters;
+
+    if (call->arguments.size() != parameters.size()) {
+        return nullptr;
+    }
+
+    std::vector<Read> order;
+    bool called = false;
+    reads(returned, order, called, false);
+    if (order.size() != parameters.size()) {
+        return nullptr;
+    }
+
+    for (size_t i = 0; i < parameters.size(); i++) {
+        auto arg = call->arguments[i];
+        auto read = std::find_if(order.begin(), order.end(), [&](const Read &r) {
+            return r.name == parameters[i];
+        });
+        // parameters are unique, with as many reads every one is read once
+        if (read == order.end()) {
+            return nullptr;
+        }
+
+        if (arg->type == ast::ExpressionType::Identifier) {
+            // a call could assign to the variable before it is read
+            if (read->after_call) {
+                return nullptr;
+            }
+
+            // a global declared later throws if it is read, a read that is
+            // skipped would lose that
+            auto name = arg->as_identifier()->name;
+            if (!is_local(name) && (read->conditional || !links.front().declared.contains(name))) {
+                return nullptr;
+            }
+        } else if (!is_literal(arg)) {
+            return nullptr;
+        }
+    }
+
+    return substitute(returned, parameters, call->arguments);
+}
+
+// a copy of an inlined body with the arguments in place of the parameters
+ast::Expression* ConstantFolder::substitute(ast::Expression* expression, const std::vector<atom::Atom> &parameters,
+                                            const std::vector<ast::Expression*> &arguments) {
+    auto again = [&](ast::Expression* e) {
+        return substitute(e, parameters, arguments);
+    };
+
+    switch (expression->type) {
+        case ast::ExpressionType::Identifier: {
+            auto name = expression->as_identifier()->name;
+            auto i = std::find(parameters.begin(), parameters.end(), name) - parameters.begin();
+            auto arg = arguments[i];
+            if (arg->type == ast::ExpressionType::Identifier) {
+                return nodes.make<ast::IdentifierExpression>(arg->as_identifier()->name);
+            }
+            return copy(arg);
+        }
+        case ast::ExpressionType::NumberLiteral:
+        case ast::ExpressionType::StringLiteral:
+        case ast::ExpressionType::BooleanLiteral:
+        case ast::ExpressionType::NullLiteral:
+            return copy(expression);
+        case ast::ExpressionType::Binary: {
+            auto e = expression->as_binary();
+            return nodes.make<ast::BinaryExpression>(again(e->left), again(e->right), e->op);
+        }
+        case ast::ExpressionType::Unary: {
+            auto e = expression->as_unary();
+            return nodes.make<ast::UnaryExpression>(again(e->argument), e->op);
+        }
+        case ast::ExpressionType::Ternary: {
+            auto e = expression->as_ternary();
+            return nodes.make<ast::TernaryExpression>(again(e->test), again(e->consequent), again(e->alternative));
+        }
+        case ast::ExpressionType::Member: {
+            auto e = expression->as_member();
+            auto property = e->is_computed ? again(e->property)
+                                           : nodes.make<ast::IdentifierExpression>(e->property->as_identifier()->name);
+            return nodes.make<ast::MemberExpression>(again(e->object), property, e->is_computed);
+        }
+        case ast::ExpressionType::Call: {
+            auto e = expression->as_call();
+            auto c = nodes.make<ast::CallExpression>(again(e->callee));
+            for (auto arg: e->arguments) {
+                c->arguments.push_back(again(arg));
+            }
+            return c;
+        }
+        case ast::ExpressionType::Array: {
+            auto a = nodes.make<ast::ArrayExpression>();
+            for (auto element: expression->as_array()->elements) {
+                a->elements.push_back(again(element));
+            }
+            return a;
+        }
+        default:
+            assert(false);
+    }
+}
+
+void ShakeReport::print(std::ostream &out) const {
+    out << "tree shaking removed " << functions.size() << " functions, " << branches << " branches and "
+        << statements << " statements\n";
+    for (auto name: functions) {
+        out << "  function " << atom::to_string(name) << "\n";
+    }
+}
+
+TreeShaker::TreeShaker(ast::Arena &nodes) : nodes(nodes) {}
+
+ast::Statement* TreeShaker::empty() {
+    return nodes.make<ast::BlockStatement>(std::vector<ast::Statement*>{});
+}
+
+void TreeShaker::eliminate_dead_code(ast::Statement* &statement) {
+    switch (statement->type) {
+        case ast::StatementType::Expression:
+            eliminate(statement->as_expression_statement()->expression);
+            return;
+        case ast::StatementType::Block: {
+            auto &body = statement->as_block()->body;
+            for (size_t i = 0; i < body.size(); i++) {
+                eliminate_dead_code(body[i]);
+
+                auto type = body[i]->type;
+                auto jumps = type == ast::StatementType::Return || type == ast::StatementType::Throw ||
+                             type == ast::StatementType::Break || type == ast::StatementType::Continue;
+                if (jumps && i + 1 < body.size()) {
+                    report.statements += body.size() - i - 1;
+                    body.resize(i + 1);
+                }
+            }
+            return;
+        }
+        case ast::StatementType::LazyBlock: {
+            auto s = statement->as_lazy_block();
+            if (s->block != nullptr) {
+                eliminate_function(s->block);
+            }
+            return;
+        }
+        case ast::StatementType::If: {
+            auto s = statement->as_if();
+            eliminate(s->test);
+            eliminate_dead_code(s->consequent);
+            if (s->alternative != nullptr) {
+                eliminate_dead_code(s->alternative);
+            }
+
+            if (is_literal(s->test)) {
+                report.branches++;
+                if (is_truthy(s->test)) {
+                    statement = s->consequent;
+                } else {
+                    statement = s->alternative != nullptr ? s->alternative : empty();
+                }
+            }
+            return;
+        }
+        case ast::StatementType::FunctionDeclaration:
+            eliminate_function(statement->as_function_declaration()->body);
+            return;
+        case ast::StatementType::While: {
+            auto s = statement->as_while();
+            eliminate(s->test);
+            eliminate_dead_code(s->body);
+
+            if (is_literal(s->test) && !is_truthy(s->test)) {
+                report.branches++;
+                statement = empty();
+            }
+            return;
+        }
+        case ast::StatementType::For: {
+            auto s = statement->as_for();
+            eliminate(s->init);
+            eliminate(s->test);
+            eliminate(s->update);
+            eliminate_dead_code(s->body);
+            return;
+        }
+        case ast::StatementType::Return:
+            if (statement->as_return()->argument != nullptr) {
+                eliminate(statement->as_return()->argument);
+            }
+            return;
+        case ast::StatementType::Throw:
+            eliminate(statement->as_throw()->argument);
+            return;
+        case ast::StatementType::Break:
+        case ast::StatementType::Continue:
+            return;
+        case ast::StatementType::TryCatch:
+            eliminate_dead_code(statement->as_trycatch()->try_body);
+            eliminate_dead_code(statement->as_trycatch()->catch_body);
+            return;
+    }
+
+    assert(false);
+}
+
+// expressions only have dead code in the functions in them
+void TreeShaker::eliminate(ast::Expression* expression) {
+    if (expression == nullptr) {
+        return;
+    }
+
+    switch (expression->type) {
+        case ast::ExpressionType::VariableDeclaration:
+            eliminate(expression->as_variable_declaration()->value);
+            return;
+        case ast::ExpressionType::Call:
+            eliminate(expression->as_call()->callee);
+            for (auto arg: expression->as_call()->arguments) {
+                eliminate(arg);
+            }
+            return;
+        case ast::ExpressionType::New:
+            eliminate(expression->as_new()->callee);
+            for (auto arg: expression->as_new()->arguments) {
+                eliminate(arg);
+            }
+            return;
+        case ast::ExpressionType::Member:
+            eliminate(expression->as_member()->object);
+            eliminate(expression->as_member()->property);
+            return;
+        case ast::ExpressionType::Identifier:
+        case ast::ExpressionType::NumberLiteral:
+        case ast::ExpressionType::StringLiteral:
+        case ast::ExpressionType::BooleanLiteral:
+        case ast::ExpressionType::NullLiteral:
+        case ast::ExpressionType::This:
+        case ast::ExpressionType::Update:
+            return;
+        case ast::ExpressionType::Binary:
+            eliminate(expression->as_binary()->left);
+            eliminate(expression->as_binary()->right);
+            return;
+        case ast::ExpressionType::Assignment:
+            eliminate(expression->as_assignment()->left);
+            eliminate(expression->as_assignment()->right);
+            return;
+        case ast::ExpressionType::Unary:
+            eliminate(expression->as_unary()->argument);
+            return;
+        case ast::ExpressionType::Ternary:
+            eliminate(expression->as_ternary()->test);
+            eliminate(expression->as_ternary()->consequent);
+            eliminate(expression->as_ternary()->alternative);
+            return;
+        case ast::ExpressionType::Object:
+            for (auto &p: expression->as_object()->properties) {
+                eliminate(p.second);
+            }
+            return;
+        case ast::ExpressionType::Array:
+            for (auto element: expression->as_array()->elements) {
+                eliminate(element);
+            }
+            return;
+        case ast::ExpressionType::Function:
+            eliminate_function(expression->as_function()->body);
+            return;
+        case ast::ExpressionType::ArrowFunction:
+            eliminate_function(expression->as_arrow_function()->body);
+            return;
+    }
+
+    assert(false);
+}
+
+// a body is always a block or an expression, so it is never replaced
+void TreeShaker::eliminate_function(ast::ASTNode* body) {
+    if (body->type == ast::ASTNodeType::Expression) {
+        eliminate(static_cast<ast::Expression*>(body));
+        return;
+    }
+
+    auto s = static_cast<ast::Statement*>(body);
+    eliminate_dead_code(s);
+    assert(s == body);
+}
+
+void TreeShaker::shake(std::vector<ast::Statement*> &program) {
+    std::unordered_map<atom::Atom, std::vector<ast::FunctionDeclarationStatement*>> functions;
+    std::vector<atom::Atom> names;
+
+    for (auto s: program) {
+        if (s->type == ast::StatementType::FunctionDeclaration) {
+            functions[s->as_function_declaration()->identifier].push_back(s->as_function_declaration());
+        } else {
+            uses(s, names);
+        }
+    }
+
+    std::unordered_set<atom::Atom> reached;
+    while (!names.empty()) {
+        auto name = names.back();
+        names.pop_back();
+
+        if (!reached.insert(name).second) {
+            continue;
+        }
+
+        if (auto entry = functions.find(name); entry != functions.end()) {
+            for (auto f: entry->second) {
+                uses(f->body, names);
+            }
+        }
+    }
+
+    std::erase_if(program, [&](ast::Statement* s) {
+        if (s->type != ast::StatementType::FunctionDeclaration) {
+            return false;
+        }
+
+        auto name = s->as_function_declaration()->identifier;
+        if (reached.contains(name)) {
+            return false;
+        }
+
+        report.functions.push_back(name);
+        return true;
+    });
+}
+
+void TreeShaker::uses(ast::ASTNode* node, std::vector<atom::Atom> &names) {
+    if (node->type == ast::ASTNodeType::Statement) {
+        uses(static_cast<ast::Statement*>(node), names);
+    } else {
+        uses(static_cast<ast::Expression*>(node), names);
+    }
+}
+
+void TreeShaker::uses(ast::Statement* statement, std::vector<atom::Atom> &names) {
+    switch (statement->type) {
+        case ast::StatementType::Expression:
+            uses(statement->as_expression_statement()->expression, names);
+            return;
+        case ast::StatementType::Block:
+            for (auto s: statement->as_block()->body) {
+                uses(s, names);
+            }
+            return;
+        case ast::StatementType::LazyBlock: {
+            auto s = statement->as_lazy_block();
+            if (s->block != nullptr) {
+                uses(s->block, names);
+            } else {
+                names.insert(names.end(), s->names.begin(), s->names.end());
+                names.insert(names.end(), s->properties.begin(), s->properties.end());
+            }
+            return;
+        }
+        case ast::StatementType::If: {
+            auto s = statement->as_if();
+            uses(s->test, names);
+            uses(s->consequent, names);
+            if (s->alternative != nullptr) {
+                uses(s->alternative, names);
+            }
+            return;
+        }
+        case ast::StatementType::FunctionDeclaration:
+            uses(statement->as_function_declaration()->body, names);
+            return;
+        case ast::StatementType::While:
+            uses(statement->as_while()->test, names);
+            uses(statement->as_while()->body, names);
+            return;
+        case ast::StatementType::For: {
+            auto s = statement->as_for();
+            uses(s->init, names);
+            uses(s->test, names);
+            uses(s->update, names);
+            uses(s->body, names);
+            return;
+        }
+        case ast::StatementType::Return:
+            if (statement->as_return()->argument != nullptr) {
+                uses(statement->as_return()->argument, names);
+            }
+            return;
+        case ast::StatementType::Throw:
+            uses(statement->as_throw()->argument, names);
+            return;
+        case ast::StatementType::Break:
+        case ast::StatementType::Continue:
+            return;
+        case ast::StatementType::TryCatch:
+            uses(statement->as_trycatch()->try_body, names);
+            uses(statement->as_trycatch()->catch_body, names);
+            return;
+    }
+
+    assert(false);
+}
+
+void TreeShaker::uses(ast::Expression* expression, std::vector<atom::Atom> &names) {
+    if (expression == nullptr) {
+        return;
+    }
+
+    switch (expression->type) {
+        case ast::ExpressionType::VariableDeclaration:
+            uses(expression->as_variable_declaration()->value, names);
+            return;
+        case ast::ExpressionType::Call:
+            uses(expression->as_call()->callee, names);
+            for (auto arg: expression->as_call()->arguments) {
+                uses(arg, names);
+            }
+            return;
+        case ast::ExpressionType::New:
+            uses(expression->as_new()->callee, names);
+            for (auto arg: expression->as_new()->arguments) {
+                uses(arg, names);
+            }
+            return;
+        case ast::ExpressionType::Member:
+            // property names count too, a global can be reached through an object
+            uses(expression->as_member()->object, names);
+            uses(expression->as_member()->property, names);
+            return;
+        case ast::ExpressionType::Identifier:
+            names.push_back(expression->as_identifier()->name);
+            return;
+        case ast::ExpressionType::StringLiteral:
+            // a string can be the key of a computed member like this[name]
+            names.push_back(atom::intern(expression->as_string_literal()->value));
+            return;
+        case ast::ExpressionType::NumberLiteral:
+        case ast::ExpressionType::BooleanLiteral:
+        case ast::ExpressionType::NullLiteral:
+        case ast::ExpressionType::This:
+            return;
+        case ast::ExpressionType::Binary:
+            uses(expression->as_binary()->left, names);
+            uses(expression->as_binary()->right, names);
+            return;
+        case ast::ExpressionType::Assignment:
+            uses(expression->as_assignment()->left, names);
+            uses(expression->as_assignment()->right, names);
+            return;
+        case ast::ExpressionType::Unary:
+            uses(expression->as_unary()->argument, names);
+            return;
+        case ast::ExpressionType::Update:
+            uses(expression->as_update()->argument, names);
+            return;
+        case ast::ExpressionType::Ternary:
+            uses(expression->as_ternary()->test, names);
+            uses(expression->as_ternary()->consequent, names);
+            uses(expression->as_ternary()->alternative, names);
+            return;
+        case ast::ExpressionType::Object:
+            for (auto &p: expression->as_object()->properties) {
+                uses(p.second, names);
+            }
+            return;
+        case ast::ExpressionType::Array:
+            for (auto element: expression->as_array()->elements) {
+                uses(element, names);
+            }
+            return;
+        case ast::ExpressionType::Function:
+            uses(expression->as_function()->body, names);
+            return;
+        case ast::ExpressionType::ArrowFunction:
+            uses(expression->as_arrow_function()->body, names);
+            return;
+    }
+
+    assert(false);
+}
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <deque>
+#include <optional>
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "ast.h"
+
+namespace optimizer {
+
+// folds operations on literals into the literal they evaluate to and replaces
+// the uses of consts initialised with a literal by the literal, in place. only
+// operations that the interpreter does without side effects are folded, and
+// with its semantics: numbers are concatenated to strings as the interpreter
+// prints them and strings are not compared.
+//
+// consts initialised with a small function are inlined where they are called
+// directly. the function has to return a single expression that only uses its
+// parameters, so it cannot be recursive or need a closure. each parameter has
+// to be used once and the arguments have to be literals or declared variables
+// that the body, in the order the engines evaluate it, reads before any call.
+// every argument is then still read once and reading it has no side effect,
+// so the order the arguments are read in does not matter
+class ConstantFolder {
+    // the consts of a function or the top level, names it declares otherwise
+    // hide the consts of the functions around it. functions created in it keep
+    // a pointer to this, so bodies that are parsed later see its consts too
+    struct Constants {
+        Constants* parent;
+        std::unordered_map<atom::Atom, ast::Expression*> values;
+        std::unordered_set<atom::Atom> declared;
+        // names assigned to in the function or the functions in it, the
+        // runtime does not stop a const from being assigned to so those are
+        // not propagated. not known at the top level until the program is seen
+        std::optional<std::unordered_set<atom::Atom>> assigned;
+        // set once a call or new in the code of the function has been folded,
+        // from then on a function it declares could already have run
+        bool called = false;
+        // consts declared after that, they are only propagated into the code
+        // of the function itself and not into the functions in it
+        std::unordered_set<atom::Atom> late;
+        // the let and const of a block in a function, the rest is kept by the function's
+        bool block = false;
+    };
+
+    ast::Arena &nodes;
+    std::deque<Constants> links;
+    Constants* constants;
+    std::unordered_map<ast::LazyBlockStatement*, Constants*> lazy;
+    // set while folding an inlined body, which is not inlined into again
+    bool inlining = false;
+
+    static Constants* function_of(Constants* c);
+    ast::Expression* lookup(atom::Atom name);
+    bool is_local(atom::Atom name);
+    ast::Expression* copy(ast::Expression* literal);
+    void declare(ast::Statement* statement, std::unordered_set<atom::Atom> &declared, bool lexical);
+    ast::ASTNode* fold_function(std::optional<atom::Atom> name, const std::vector<atom::Atom> &parameters,
+                                ast::ASTNode* body);
+    void fold(ast::Statement* statement);
+    void fold(ast::Expression* &expression);
+    ast::Expression* fold_unary(ast::UnaryExpression* e);
+    ast::Expression* fold_binary(ast::BinaryExpression* e);
+    ast::Expression* inline_body(ast::Expression* function);
+    ast::Expression* inline_call(ast::Expression* function, ast::CallExpression* call);
+    ast::Expression* substitute(ast::Expression* expression, const std::vector<atom::Atom> &parameters,
+                                const std::vector<ast::Expression*> &arguments);
+
+public:
+    // folded literals are allocated in `nodes`, which has to outlive the ast
+    explicit ConstantFolder(ast::Arena &nodes);
+
+    bool fold_literals = true;
+    // the most nodes a function body can have to be inlined, 0 turns inlining off
+    uint32_t inline_budget = 0;
+
+    // looks for assignments in the whole program, consts at the top level are
+    // only propagated after it, since any later statement could assign to them
+    void see_program(const std::vector<ast::Statement*> &program);
+    // consts at the top level are kept for the statements after them
+    void fold_top_level(ast::Statement* statement);
+    // folds the body of a function that was parsed after the code around it
+    // was folded, with the consts that were around it
+    void fold_body(ast::LazyBlockStatement* lazy_body);
+};
+
+// what the tree shaker removed
+struct ShakeReport {
+    std::vector<atom::Atom> functions;
+    size_t branches = 0;
+    size_t statements = 0;
+
+    void print(std::ostream &out) const;
+};
+
+// removes code that cannot run: branches whose test is a literal that picks
+// the other branch, statements after a jump out of the same block and
+// top level function declarations that no code that is kept refers to. a name
+// counts as referred to wherever it is used, as a variable, after a dot or as
+// the contents of a string, which can be a computed key
+class TreeShaker {
+    ast::Arena &nodes;
+
+    ast::Statement* empty();
+    void eliminate(ast::Expression* expression);
+    void eliminate_function(ast::ASTNode* body);
+    void uses(ast::ASTNode* node, std::vector<atom::Atom> &names);
+    void uses(ast::Statement* statement, std::vector<atom::Atom> &names);
+    void uses(ast::Expression* expression, std::vector<atom::Atom> &names);
+
+public:
+    // empty statements for removed branches are allocated in `nodes`
+    explicit TreeShaker(ast::Arena &nodes);
+
+    ShakeReport report;
+
+    // removes dead code in a statement, replacing it if it is a dead branch
+    void eliminate_dead_code(ast::Statement* &statement);
+    // removes the function declarations of a whole program that are not
+    // reachable from the rest of it
+    void shake(std::vector<ast::Statement*> &program);
+};
+
+}
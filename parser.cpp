@@ -1,44 +1,39 @@
 #include "parser.h"
 
-namespace parser {
+#include <algorithm>
 
-lexer::Token Parser::next_token() {
-    if (index >= tokens.size()) {
-        return lexer::Token{lexer::TokenType::EndOfFile, ""};
-    }
+namespace parser {
 
-    if (tokens[index].type == lexer::TokenType::EndOfFile) {
-        return tokens[index];
-    }
+const lexer::Token &Parser::current_token() {
+    return stream->peek();
+}
 
-    return tokens[++index];
+const lexer::Token &Parser::next_token() {
+    return stream->advance();
 }
 
-lexer::Token Parser::peek_next_token() {
-    if (tokens[index].type == lexer::TokenType::EndOfFile) {
-        return tokens[index];
+const lexer::Token &Parser::peek_next_token() {
+    if (current_token().type == lexer::TokenType::EndOfFile) {
+        return current_token();
     }
 
-    return tokens[index + 1];
+    return stream->peek(1);
 }
 
-void Parser::backup() {
-    index--;
-}
-
-lexer::Token Parser::expect_next_token(lexer::TokenType type) {
-    if (tokens[index].type == lexer::TokenType::EndOfFile) {
-        return tokens[index];
+const lexer::Token &Parser::expect_next_token(lexer::TokenType type) {
+    if (current_token().type == lexer::TokenType::EndOfFile) {
+        return current_token();
     }
 
-    auto t = tokens[++index];
+    auto &t = next_token();
 
     if (t.type != type) {
+        auto location = lexer::get_location(source, t.offset);
         std::cerr << "unexpected token: expected "
                   << lexer::token_type_to_string(type)
                   << " and got "
                   << lexer::token_type_to_string(t.type)
-                  << " at " << t.line << ":" << t.column
+                  << " at " << lexer::format_location(stream->name(), location)
                   << "\n";
         assert(false);
     }
@@ -53,158 +48,193 @@ void Parser::skip_token_if_type(lexer::TokenType type) {
     }
 }
 
-lexer::Token Parser::peek_next_token_after_type(lexer::TokenType type) {
-    int i = 0;
-
-    auto next = tokens[index];
-    while (next.type != type) {
-        next = next_token();
-        i++;
-    }
+std::string_view Parser::text(const lexer::Token &token) {
+    return token.text(source);
+}
 
-    auto peek = peek_next_token();
-    index -= i;
-    return peek;
+void Parser::unexpected_token() {
+    auto &t = current_token();
+    auto location = lexer::get_location(source, t.offset);
+    std::cerr << "unexpected token \"" << text(t) << "\" at " << lexer::format_location(stream->name(), location) << "\n";
 }
 
+namespace {
 
-void Parser::unexpected_token() {
-    auto t = tokens[index];
-    std::cerr << "unexpected token \"" << t.value << "\" at " << t.line << ":" << t.column << "\n";
+// binding power of an operator that continues an expression, higher binds tighter
+Precedence infix_precedence(lexer::TokenType type) {
+    switch (type) {
+        case lexer::TokenType::Equals:
+        case lexer::TokenType::AdditionAssignment:
+        case lexer::TokenType::SubtractionAssignment:
+        case lexer::TokenType::MultiplicationAssignment:
+        case lexer::TokenType::DivisionAssignment:
+            return Precedence::Assignment;
+        case lexer::TokenType::QuestionMark:
+            return Precedence::Conditional;
+        case lexer::TokenType::Or:
+            return Precedence::LogicalOr;
+        case lexer::TokenType::And:
+            return Precedence::LogicalAnd;
+        case lexer::TokenType::Pipe:
+            return Precedence::BitwiseOr;
+        case lexer::TokenType::Ampersand:
+            return Precedence::BitwiseAnd;
+        case lexer::TokenType::EqualTo:
+        case lexer::TokenType::EqualToStrict:
+        case lexer::TokenType::NotEqualTo:
+        case lexer::TokenType::NotEqualToStrict:
+            return Precedence::Equality;
+        case lexer::TokenType::LessThan:
+        case lexer::TokenType::LessThanOrEqualTo:
+        case lexer::TokenType::GreaterThan:
+        case lexer::TokenType::GreaterThanOrEqualTo:
+            return Precedence::Relational;
+        case lexer::TokenType::Plus:
+        case lexer::TokenType::Minus:
+            return Precedence::Additive;
+        case lexer::TokenType::Asterisk:
+        case lexer::TokenType::Slash:
+        case lexer::TokenType::Percent:
+            return Precedence::Multiplicative;
+        case lexer::TokenType::Exponentiation:
+            return Precedence::Exponentiation;
+        case lexer::TokenType::Increment:
+        case lexer::TokenType::Decrement:
+            return Precedence::Postfix;
+        case lexer::TokenType::LeftParen:
+            return Precedence::Call;
+        case lexer::TokenType::Dot:
+        case lexer::TokenType::LeftBracket:
+            return Precedence::Member;
+        default:
+            return Precedence::None;
+    }
 }
 
-std::shared_ptr<ast::Expression> Parser::parse_member_expression(std::shared_ptr<ast::Expression> left) {
-    auto next = tokens[index];
+}
+
+ast::Expression* Parser::parse_member_expression(ast::Expression* left) {
+    auto &next = current_token();
 
     if (next.type == lexer::TokenType::Dot) {
-        auto identifier_token = expect_next_token(lexer::TokenType::Identifier);
-        auto right = std::make_shared<ast::IdentifierExpression>(identifier_token.value);
-        return std::make_shared<ast::MemberExpression>(left, right, false);
+        auto &identifier_token = expect_next_token(lexer::TokenType::Identifier);
+        auto right = make<ast::IdentifierExpression>(identifier_token.atom);
+        return make<ast::MemberExpression>(left, right, false);
     }
 
     if (next.type == lexer::TokenType::LeftBracket) {
         next_token();
-        auto right = parse_expression(nullptr);
+        auto right = parse_expression();
         expect_next_token(lexer::TokenType::RightBracket);
-        return std::make_shared<ast::MemberExpression>(left, right, true);
+        return make<ast::MemberExpression>(left, right, true);
     }
 
     assert(false);
 }
 
-std::shared_ptr<ast::Expression> Parser::parse_binary_expression(std::shared_ptr<ast::Expression> left) {
-    auto next = tokens[index];
+ast::Expression* Parser::parse_binary_expression(ast::Expression* left) {
+    auto &next = current_token();
 
     auto op = ast::token_type_to_operator(next.type);
+    auto precedence = infix_precedence(next.type);
 
     next_token();
-    auto right = parse_expression(nullptr);
+    // ** is right associative, everything else binds left
+    auto right = op == ast::Operator::Exponentiation
+                 ? parse_expression(precedence)
+                 : parse_expression(static_cast<Precedence>(static_cast<int>(precedence) + 1));
 
-    return std::make_shared<ast::BinaryExpression>(left, right, op);
+    return make<ast::BinaryExpression>(left, right, op);
 }
 
-std::shared_ptr<ast::Expression> Parser::parse_call_expression(std::shared_ptr<ast::Expression> callee) {
-    auto next = tokens[index];
-
-    auto call_expression = std::make_shared<ast::CallExpression>(callee);
+void Parser::parse_arguments(std::vector<ast::Expression*> &arguments) {
+    assert(current_token().type == lexer::TokenType::LeftParen);
 
-    assert(next.type == lexer::TokenType::LeftParen);
+    if (peek_next_token().type == lexer::TokenType::RightParen) {
+        next_token();
+        return;
+    }
 
-    next = next_token();
-    while (next.type != lexer::TokenType::RightParen) {
-        auto arg = parse_expression(nullptr);
-        call_expression->arguments.push_back(arg);
+    while (true) {
+        next_token();
+        arguments.push_back(parse_expression(Precedence::Assignment));
 
-        if (peek_next_token().type == lexer::TokenType::Semicolon) {
-            break;
+        auto &next = next_token();
+        if (next.type == lexer::TokenType::RightParen) {
+            return;
         }
 
-        next = next_token();
-        if (next.type == lexer::TokenType::Comma) {
-            next = next_token();
+        if (next.type != lexer::TokenType::Comma) {
+            unexpected_token();
+            assert(false);
         }
     }
+}
 
+ast::Expression* Parser::parse_call_expression(ast::Expression* callee) {
+    auto call_expression = make<ast::CallExpression>(callee);
+    parse_arguments(call_expression->arguments);
     return call_expression;
 }
 
-std::shared_ptr<ast::Expression> Parser::parse_new_expression() {
-    auto next = tokens[index];
-
-    // TODO: technically this can be any type of expression that returns a constructor function
-    auto identifier_token = expect_next_token(lexer::TokenType::Identifier);
-    auto callee = std::make_shared<ast::IdentifierExpression>(identifier_token.value);
-    auto expression = std::make_shared<ast::NewExpression>(callee);
-
-    expect_next_token(lexer::TokenType::LeftParen);
-
-    next = next_token();
-    while (next.type != lexer::TokenType::RightParen) {
-        auto arg = parse_expression(nullptr);
-        expression->arguments.push_back(arg);
+ast::Expression* Parser::parse_new_expression() {
+    next_token();
 
-        if (peek_next_token().type == lexer::TokenType::Semicolon) {
-            break;
-        }
+    // member accesses belong to the constructor, the first ( starts the arguments
+    auto callee = parse_expression(Precedence::Member);
+    auto expression = make<ast::NewExpression>(callee);
 
-        next = next_token();
-        if (next.type == lexer::TokenType::Comma) {
-            next = next_token();
-        }
+    if (peek_next_token().type == lexer::TokenType::LeftParen) {
+        next_token();
+        parse_arguments(expression->arguments);
     }
 
     return expression;
 }
 
-std::shared_ptr<ast::Expression> Parser::parse_assignment_expression(std::shared_ptr<ast::Expression> left) {
-    auto next = tokens[index];
+ast::Expression* Parser::parse_assignment_expression(ast::Expression* left) {
+    auto &next = current_token();
 
     auto op = ast::token_type_to_operator(next.type);
 
     next_token();
-    auto right = parse_expression(nullptr);
+    auto right = parse_expression(Precedence::Assignment);
 
-    return std::make_shared<ast::AssignmentExpression>(left, right, op);
+    return make<ast::AssignmentExpression>(left, right, op);
 }
 
-std::shared_ptr<ast::Expression> Parser::parse_variable_declaration_expression() {
-    auto next = tokens[index];
-    auto type = ast::get_variable_type(next.value);
+ast::Expression* Parser::parse_variable_declaration_expression() {
+    auto next = current_token();
+    auto type = ast::get_variable_type(next.keyword);
 
-    std::vector<std::string> identifiers;
-    identifiers.push_back(expect_next_token(lexer::TokenType::Identifier).value);
-    std::optional<std::shared_ptr<ast::Expression>> value;
+    std::vector<atom::Atom> identifiers;
+    identifiers.push_back(expect_next_token(lexer::TokenType::Identifier).atom);
+    ast::Expression* value = nullptr;
 
-    if (peek_next_token().type == lexer::TokenType::Semicolon) {
-        return std::make_shared<ast::VariableDeclarationExpression>(identifiers, value, type);
+    while (peek_next_token().type == lexer::TokenType::Comma) {
+        next_token();
+        identifiers.push_back(expect_next_token(lexer::TokenType::Identifier).atom);
     }
 
-    next = next_token();
-    while (next.type != lexer::TokenType::Equals) {
-        if (next.type != lexer::TokenType::Comma) {
-            break;
-        }
-
-        identifiers.push_back(expect_next_token(lexer::TokenType::Identifier).value);
-        next = next_token();
+    if (peek_next_token().type != lexer::TokenType::Equals) {
+        return make<ast::VariableDeclarationExpression>(identifiers, value, type);
     }
 
-    assert(next.type == lexer::TokenType::Equals);
-
     next_token();
-    value = parse_expression(nullptr);
+    next_token();
+    value = parse_expression(Precedence::Assignment);
 
-    return std::make_shared<ast::VariableDeclarationExpression>(identifiers, value, type);
+    return make<ast::VariableDeclarationExpression>(identifiers, value, type);
 }
 
-std::shared_ptr<ast::Expression> Parser::parse_array_expression() {
-    auto expression = std::make_shared<ast::ArrayExpression>();
+ast::Expression* Parser::parse_array_expression() {
+    auto expression = make<ast::ArrayExpression>();
 
     auto next = next_token();
 
     // get properties
     while (next.type != lexer::TokenType::RightBracket) {
-        expression->elements.push_back(parse_expression(nullptr));
+        expression->elements.push_back(parse_expression(Precedence::Assignment));
 
         next = next_token();
         if (next.type == lexer::TokenType::Comma) {
@@ -215,8 +245,8 @@ std::shared_ptr<ast::Expression> Parser::parse_array_expression() {
     return expression;
 }
 
-std::shared_ptr<ast::Expression> Parser::parse_object_expression() {
-    auto expression = std::make_shared<ast::ObjectExpression>();
+ast::Expression* Parser::parse_object_expression() {
+    auto expression = make<ast::ObjectExpression>();
 
     auto next = next_token();
 
@@ -228,8 +258,8 @@ std::shared_ptr<ast::Expression> Parser::parse_object_expression() {
         expect_next_token(lexer::TokenType::Colon);
 
         next_token();
-        auto value = parse_expression(nullptr);
-        expression->properties[id.value] = value;
+        auto value = parse_expression(Precedence::Assignment);
+        expression->properties[id.atom] = value;
 
         next = next_token();
         if (next.type == lexer::TokenType::Comma) {
@@ -240,23 +270,16 @@ std::shared_ptr<ast::Expression> Parser::parse_object_expression() {
     return expression;
 }
 
-std::shared_ptr<ast::Expression> Parser::parse_function_expression() {
-    std::optional<std::string> identifier;
+std::vector<atom::Atom> Parser::parse_parameters() {
+    assert(current_token().type == lexer::TokenType::LeftParen);
 
-    if (peek_next_token().type == lexer::TokenType::Identifier) {
-        auto identifier_token = expect_next_token(lexer::TokenType::Identifier);
-        identifier = identifier_token.value;
-    }
-
-    expect_next_token(lexer::TokenType::LeftParen);
-
-    std::vector<std::string> parameters;
+    std::vector<atom::Atom> parameters;
 
     auto next = next_token();
 
     while (next.type != lexer::TokenType::RightParen) {
         assert(next.type == lexer::TokenType::Identifier);
-        parameters.push_back(next.value);
+        parameters.push_back(next.atom);
 
         next = next_token();
         if (next.type == lexer::TokenType::Comma) {
@@ -264,396 +287,444 @@ std::shared_ptr<ast::Expression> Parser::parse_function_expression() {
         }
     }
 
-    assert(tokens[index].type == lexer::TokenType::RightParen);
+    return parameters;
+}
+
+ast::Expression* Parser::parse_function_expression() {
+    std::optional<atom::Atom> identifier;
+
+    if (peek_next_token().type == lexer::TokenType::Identifier) {
+        identifier = expect_next_token(lexer::TokenType::Identifier).atom;
+    }
+
+    expect_next_token(lexer::TokenType::LeftParen);
+    auto parameters = parse_parameters();
 
     next_token();
-    auto body = parse_statement();
+    auto body = parse_function_body();
 
-    return std::make_shared<ast::FunctionExpression>(identifier, parameters, body);
+    return make<ast::FunctionExpression>(identifier, parameters, body);
 }
 
-std::shared_ptr<ast::Expression> Parser::parse_arrow_function_expression() {
-    if (peek_next_token().type == lexer::TokenType::Identifier) {
-        auto identifier = expect_next_token(lexer::TokenType::Identifier);
-        expect_next_token(lexer::TokenType::Arrow);
+ast::Statement* Parser::parse_function_body() {
+    if (!lazy_functions || current_token().type != lexer::TokenType::LeftBrace) {
+        return parse_statement();
+    }
 
-        std::vector<std::string> parameters{identifier.value};
+    // pre-parse: only check that the brackets match and remember where the
+    // body is and the names it uses, it is parsed properly when the function
+    // is first called
+    auto begin = current_token().offset;
+    brackets.clear();
+    std::vector<atom::Atom> names;
+    std::vector<atom::Atom> properties;
+    std::vector<atom::Atom> assigned;
+    auto previous = lexer::TokenType::LeftBrace;
+    // the variable just before the current token, unless it is being declared
+    std::optional<atom::Atom> variable;
+    bool declaring = false;
+
+    while (true) {
+        auto &t = current_token();
 
-        next_token();
-        auto body = parse_statement();
-        if (body->type == ast::StatementType::Expression) {
-            auto body_expression = body->as_expression_statement()->expression;
-            return std::make_shared<ast::ArrowFunctionExpression>(parameters, body_expression);
+        switch (t.type) {
+            case lexer::TokenType::Identifier:
+                // a property name is not a variable
+                (previous == lexer::TokenType::Dot ? properties : names).push_back(t.atom);
+                if (previous == lexer::TokenType::Increment || previous == lexer::TokenType::Decrement) {
+                    assigned.push_back(t.atom);
+                }
+                break;
+            case lexer::TokenType::Equals:
+            case lexer::TokenType::AdditionAssignment:
+            case lexer::TokenType::SubtractionAssignment:
+            case lexer::TokenType::MultiplicationAssignment:
+            case lexer::TokenType::DivisionAssignment:
+            case lexer::TokenType::Increment:
+            case lexer::TokenType::Decrement:
+                if (variable.has_value()) {
+                    assigned.push_back(variable.value());
+                }
+                break;
+            case lexer::TokenType::String:
+                // a string can be a computed property name
+                properties.push_back(atom::intern(text(t)));
+                break;
+            case lexer::TokenType::LeftBrace:
+            case lexer::TokenType::LeftParen:
+            case lexer::TokenType::LeftBracket:
+                brackets.push_back(t.type);
+                break;
+            case lexer::TokenType::RightBrace:
+            case lexer::TokenType::RightParen:
+            case lexer::TokenType::RightBracket: {
+                auto open = t.type == lexer::TokenType::RightBrace ? lexer::TokenType::LeftBrace
+                            : t.type == lexer::TokenType::RightParen ? lexer::TokenType::LeftParen
+                            : lexer::TokenType::LeftBracket;
+                if (brackets.empty() || brackets.back() != open) {
+                    unexpected_token();
+                    assert(false);
+                }
+                brackets.pop_back();
+                break;
+            }
+            case lexer::TokenType::EndOfFile:
+                unexpected_token();
+                assert(false);
+            default:
+                break;
+        }
+
+        if (brackets.empty()) {
+            auto body = make<ast::LazyBlockStatement>(source, stream->name(), stream->mode(), begin,
+                                                      t.offset + t.length);
+            for (auto list: {&names, &properties, &assigned}) {
+                std::sort(list->begin(), list->end());
+                list->erase(std::unique(list->begin(), list->end()), list->end());
+            }
+            body->names = std::move(names);
+            body->properties = std::move(properties);
+            body->assigned = std::move(assigned);
+            return body;
         }
 
-        return std::make_shared<ast::ArrowFunctionExpression>(parameters, body);
+        variable.reset();
+        if (t.type == lexer::TokenType::Identifier && previous != lexer::TokenType::Dot && !declaring) {
+            variable = t.atom;
+        }
+        declaring = t.type == lexer::TokenType::Keyword &&
+                    (t.keyword == lexer::Keyword::Const || t.keyword == lexer::Keyword::Let ||
+                     t.keyword == lexer::Keyword::Var);
+        previous = t.type;
+        next_token();
     }
+}
 
-    expect_next_token(lexer::TokenType::LeftParen);
+ast::Expression* Parser::parse_arrow_function_body(std::vector<atom::Atom> parameters) {
+    assert(current_token().type == lexer::TokenType::Arrow);
 
-    std::vector<std::string> parameters;
+    next_token();
+    if (current_token().type == lexer::TokenType::LeftBrace) {
+        return make<ast::ArrowFunctionExpression>(parameters, parse_function_body());
+    }
 
-    auto next = next_token();
+    return make<ast::ArrowFunctionExpression>(parameters, parse_expression(Precedence::Assignment));
+}
 
-    while (next.type != lexer::TokenType::RightParen) {
-        assert(next.type == lexer::TokenType::Identifier);
-        parameters.push_back(next.value);
+ast::Expression* Parser::parse_parenthesized_expression() {
+    assert(current_token().type == lexer::TokenType::LeftParen);
 
-        next = next_token();
-        if (next.type == lexer::TokenType::Comma) {
-            next = next_token();
+    // () can only be the parameters of an arrow function
+    if (peek_next_token().type == lexer::TokenType::RightParen) {
+        next_token();
+        expect_next_token(lexer::TokenType::Arrow);
+        return parse_arrow_function_body({});
+    }
+
+    // cover grammar: parse what is in the parentheses as expressions and
+    // reinterpret them as parameters if an arrow follows the )
+    std::vector<ast::Expression*> items;
+
+    while (true) {
+        next_token();
+        items.push_back(parse_expression(Precedence::Assignment));
+
+        auto &next = next_token();
+        if (next.type == lexer::TokenType::RightParen) {
+            break;
+        }
+
+        if (next.type != lexer::TokenType::Comma) {
+            unexpected_token();
+            assert(false);
         }
     }
 
-    assert(tokens[index].type == lexer::TokenType::RightParen);
-    expect_next_token(lexer::TokenType::Arrow);
+    if (peek_next_token().type == lexer::TokenType::Arrow) {
+        std::vector<atom::Atom> parameters;
+        for (auto item: items) {
+            if (item->type != ast::ExpressionType::Identifier) {
+                unexpected_token();
+                assert(false);
+            }
+            parameters.push_back(item->as_identifier()->name);
+        }
 
-    next_token();
-    auto body = parse_statement();
-    if (body->type == ast::StatementType::Expression) {
-        auto body_expression = body->as_expression_statement()->expression;
-        return std::make_shared<ast::ArrowFunctionExpression>(parameters, body_expression);
+        next_token();
+        return parse_arrow_function_body(parameters);
     }
 
-    return std::make_shared<ast::ArrowFunctionExpression>(parameters, body);
-}
+    // there is no comma operator
+    if (items.size() != 1) {
+        unexpected_token();
+        assert(false);
+    }
 
-std::shared_ptr<ast::Expression> Parser::parse_update_expression(std::shared_ptr<ast::Expression> left) {
-    auto t = tokens[index];
-    return std::make_shared<ast::UpdateExpression>(left, ast::token_type_to_operator(t.type), false);
+    return items[0];
 }
 
-std::shared_ptr<ast::Expression> Parser::parse_ternary_expression(std::shared_ptr<ast::Expression> left) {
-    auto next = tokens[index];
+ast::Expression* Parser::parse_update_expression(ast::Expression* left) {
+    auto &t = current_token();
+    return make<ast::UpdateExpression>(left, ast::token_type_to_operator(t.type), false);
+}
 
+ast::Expression* Parser::parse_ternary_expression(ast::Expression* left) {
     next_token();
-    auto consequent = parse_expression(nullptr);
+    auto consequent = parse_expression(Precedence::Assignment);
     expect_next_token(lexer::TokenType::Colon);
     next_token();
-    auto alternative = parse_expression(nullptr);
+    auto alternative = parse_expression(Precedence::Assignment);
 
-    return std::make_shared<ast::TernaryExpression>(left, consequent, alternative);
+    return make<ast::TernaryExpression>(left, consequent, alternative);
 }
 
-std::shared_ptr<ast::Expression> Parser::parse_expression(std::shared_ptr<ast::Expression> left) {
-    auto t = tokens[index];
-
-    if (left == nullptr) {
-        switch (t.type) {
-            case lexer::TokenType::Not: {
-                next_token();
-                return std::make_shared<ast::UnaryExpression>(parse_expression(nullptr), ast::Operator::Not);
-            }
-            case lexer::TokenType::LeftParen: {
-                auto next = peek_next_token();
-
-                if (next.type == lexer::TokenType::RightParen) {
-                    backup();
-                    return parse_arrow_function_expression();
-                }
-
-                if (next.type != lexer::TokenType::LeftParen &&
-                    peek_next_token_after_type(lexer::TokenType::RightParen).type == lexer::TokenType::Arrow) {
-                    backup();
-                    return parse_arrow_function_expression();
-                }
+ast::Expression* Parser::parse_prefix_expression() {
+    auto &t = current_token();
 
+    switch (t.type) {
+        case lexer::TokenType::Not: {
+            next_token();
+            return make<ast::UnaryExpression>(parse_expression(Precedence::Prefix), ast::Operator::Not);
+        }
+        case lexer::TokenType::Increment:
+        case lexer::TokenType::Decrement: {
+            auto op = ast::token_type_to_operator(t.type);
+            next_token();
+            return make<ast::UpdateExpression>(parse_expression(Precedence::Prefix), op, true);
+        }
+        case lexer::TokenType::LeftParen:
+            return parse_parenthesized_expression();
+        case lexer::TokenType::Number:
+            return make<ast::NumberLiteralExpression>(stream->number(t));
+        case lexer::TokenType::String:
+            return make<ast::StringLiteralExpression>(std::string(text(t)));
+        case lexer::TokenType::Identifier: {
+            auto name = t.atom;
+            if (peek_next_token().type == lexer::TokenType::Arrow) {
                 next_token();
-                auto left = parse_expression(nullptr);
-                expect_next_token(lexer::TokenType::RightParen);
-                return parse_expression(left);
-            }
-            case lexer::TokenType::Number: {
-                auto left = std::make_shared<ast::NumberLiteralExpression>(std::stod(t.value));
-                return parse_expression(left);
-            }
-            case lexer::TokenType::String: {
-                auto left = std::make_shared<ast::StringLiteralExpression>(t.value);
-                return parse_expression(left);
+                return parse_arrow_function_body({name});
             }
-            case lexer::TokenType::Identifier: {
-                if (peek_next_token().type == lexer::TokenType::Arrow) {
-                    backup();
-                    return parse_arrow_function_expression();
-                }
 
-                auto left = std::make_shared<ast::IdentifierExpression>(t.value);
-                return parse_expression(left);
-            }
-            case lexer::TokenType::LeftBrace: {
-                return parse_expression(parse_object_expression());
-            }
-            case lexer::TokenType::LeftBracket: {
-                return parse_expression(parse_array_expression());
-            }
-            case lexer::TokenType::Keyword: {
-                if (t.value == "var" || t.value == "let" || t.value == "const") {
-                    return parse_expression(parse_variable_declaration_expression());
-                }
-
-                if (t.value == "true" || t.value == "false") {
-                    return parse_expression(std::make_shared<ast::BooleanLiteralExpression>(t.value == "true"));
-                }
-
-                if (t.value == "function") {
-                    return parse_expression(parse_function_expression());
-                }
-
-                if (t.value == "this") {
-                    return parse_expression(std::make_shared<ast::ThisExpression>());
-                }
-
-                if (t.value == "new") {
+            return make<ast::IdentifierExpression>(name);
+        }
+        case lexer::TokenType::LeftBrace:
+            return parse_object_expression();
+        case lexer::TokenType::LeftBracket:
+            return parse_array_expression();
+        case lexer::TokenType::Keyword: {
+            switch (t.keyword) {
+                case lexer::Keyword::Var:
+                case lexer::Keyword::Let:
+                case lexer::Keyword::Const:
+                    return parse_variable_declaration_expression();
+                case lexer::Keyword::True:
+                case lexer::Keyword::False:
+                    return make<ast::BooleanLiteralExpression>(t.keyword == lexer::Keyword::True);
+                case lexer::Keyword::Function:
+                    return parse_function_expression();
+                case lexer::Keyword::This:
+                    return make<ast::ThisExpression>();
+                case lexer::Keyword::New:
                     return parse_new_expression();
-                }
-
-                if (t.value == "typeof") {
+                case lexer::Keyword::Typeof:
                     next_token();
-                    return std::make_shared<ast::UnaryExpression>(parse_expression(nullptr), ast::Operator::Typeof);
-                }
-
-                if (t.value == "null") {
-                    return parse_expression(std::make_shared<ast::NullLiteralExpression>());
-                }
-
-                unexpected_token();
-                assert(false);
+                    return make<ast::UnaryExpression>(parse_expression(Precedence::Prefix), ast::Operator::Typeof);
+                case lexer::Keyword::Null:
+                    return make<ast::NullLiteralExpression>();
+                default:
+                    break;
             }
-            default:
-                unexpected_token();
-                assert(false);
         }
+        default:
+            unexpected_token();
+            assert(false);
     }
+}
 
-    if (t.type == lexer::TokenType::Semicolon) {
-        return left;
-    }
+ast::Expression* Parser::parse_expression(Precedence min_precedence) {
+    auto left = parse_prefix_expression();
 
-    auto next = next_token();
+    // every iteration consumes at least one token and only ever looks one
+    // token ahead, so an expression is parsed in time linear in its tokens
+    while (true) {
+        auto type = peek_next_token().type;
+        auto precedence = infix_precedence(type);
 
-    switch (next.type) {
-        case lexer::TokenType::EndOfFile:
-        case lexer::TokenType::Semicolon:
-        case lexer::TokenType::RightParen:
-        case lexer::TokenType::RightBrace:
-        case lexer::TokenType::RightBracket:
-        case lexer::TokenType::Colon:
-        case lexer::TokenType::Comma: {
-            // end of expression
-            backup();
+        if (precedence == Precedence::None || precedence < min_precedence) {
             return left;
         }
-        case lexer::TokenType::Dot:
-        case lexer::TokenType::LeftBracket:
-            return parse_expression(parse_member_expression(left));
-        case lexer::TokenType::LeftParen:
-            return parse_expression(parse_call_expression(left));
-        case lexer::TokenType::Increment:
-        case lexer::TokenType::Decrement:
-            return parse_expression(parse_update_expression(left));
-        case lexer::TokenType::QuestionMark:
-            return parse_expression(parse_ternary_expression(left));
-        case lexer::TokenType::Equals:
-        case lexer::TokenType::AdditionAssignment:
-        case lexer::TokenType::SubtractionAssignment:
-        case lexer::TokenType::MultiplicationAssignment:
-        case lexer::TokenType::DivisionAssignment:
-            return parse_expression(parse_assignment_expression(left));
-        default:
-            if (!ast::token_type_is_operator(next.type)) {
-                unexpected_token();
-                assert(false);
-            }
-            return parse_expression(parse_binary_expression(left));
+
+        next_token();
+
+        switch (type) {
+            case lexer::TokenType::Dot:
+            case lexer::TokenType::LeftBracket:
+                left = parse_member_expression(left);
+                break;
+            case lexer::TokenType::LeftParen:
+                left = parse_call_expression(left);
+                break;
+            case lexer::TokenType::Increment:
+            case lexer::TokenType::Decrement:
+                left = parse_update_expression(left);
+                break;
+            case lexer::TokenType::QuestionMark:
+                left = parse_ternary_expression(left);
+                break;
+            case lexer::TokenType::Equals:
+            case lexer::TokenType::AdditionAssignment:
+            case lexer::TokenType::SubtractionAssignment:
+            case lexer::TokenType::MultiplicationAssignment:
+            case lexer::TokenType::DivisionAssignment:
+                left = parse_assignment_expression(left);
+                break;
+            default:
+                left = parse_binary_expression(left);
+                break;
+        }
     }
 }
 
-std::shared_ptr<ast::Statement> Parser::parse_statement() {
-    auto t = tokens[index];
+ast::Statement* Parser::parse_statement() {
+    auto &t = current_token();
 
     switch (t.type) {
         case lexer::TokenType::Keyword: {
-            if (t.value == "var" || t.value == "let" || t.value == "const") {
-                auto s = std::make_shared<ast::ExpressionStatement>(parse_expression(nullptr));
-                skip_token_if_type(lexer::TokenType::Semicolon);
-                return s;
-            } else if (t.value == "if") {
-                std::optional<std::shared_ptr<ast::Statement>> alternative;
+            if (t.keyword == lexer::Keyword::If) {
+                ast::Statement* alternative = nullptr;
 
                 expect_next_token(lexer::TokenType::LeftParen);
 
                 next_token();
-                auto test = parse_expression(nullptr);
+                auto test = parse_expression();
 
                 expect_next_token(lexer::TokenType::RightParen);
 
                 next_token();
                 auto consequent = parse_statement();
 
-                auto next = next_token();
-                if (next.type == lexer::TokenType::Keyword && next.value == "else") {
+                auto &next = peek_next_token();
+                if (next.type == lexer::TokenType::Keyword && next.keyword == lexer::Keyword::Else) {
+                    next_token();
                     next_token();
                     alternative = parse_statement();
-                } else {
-                    backup();
                 }
 
-                return std::make_shared<ast::IfStatement>(test, consequent, alternative);
-            } else if (t.value == "while") {
+                return make<ast::IfStatement>(test, consequent, alternative);
+            } else if (t.keyword == lexer::Keyword::While) {
                 expect_next_token(lexer::TokenType::LeftParen);
 
                 next_token();
-                auto test = parse_expression(nullptr);
+                auto test = parse_expression();
 
                 expect_next_token(lexer::TokenType::RightParen);
 
                 next_token();
                 auto body = parse_statement();
 
-                return std::make_shared<ast::WhileStatement>(test, body);
-            } else if (t.value == "for") {
+                return make<ast::WhileStatement>(test, body);
+            } else if (t.keyword == lexer::Keyword::For) {
                 expect_next_token(lexer::TokenType::LeftParen);
 
                 next_token();
 
-                auto init = parse_expression(nullptr);
+                auto init = parse_expression();
                 expect_next_token(lexer::TokenType::Semicolon);
 
                 next_token();
-                auto test = parse_expression(nullptr);
+                auto test = parse_expression();
                 expect_next_token(lexer::TokenType::Semicolon);
 
                 next_token();
-                auto update = parse_expression(nullptr);
+                auto update = parse_expression();
 
                 expect_next_token(lexer::TokenType::RightParen);
 
                 next_token();
                 auto body = parse_statement();
 
-                return std::make_shared<ast::ForStatement>(init, test, update, body);
-            } else if (t.value == "function") {
-                auto identifier_token = expect_next_token(lexer::TokenType::Identifier);
+                return make<ast::ForStatement>(init, test, update, body);
+            } else if (t.keyword == lexer::Keyword::Function) {
+                auto identifier = expect_next_token(lexer::TokenType::Identifier).atom;
 
                 expect_next_token(lexer::TokenType::LeftParen);
-
-                std::vector<std::string> parameters;
-
-                auto next = next_token();
-
-                while (next.type != lexer::TokenType::RightParen) {
-                    assert(next.type == lexer::TokenType::Identifier);
-                    parameters.push_back(next.value);
-
-                    next = next_token();
-                    if (next.type == lexer::TokenType::Comma) {
-                        next = next_token();
-                    }
-                }
-
-                assert(tokens[index].type == lexer::TokenType::RightParen);
+                auto parameters = parse_parameters();
 
                 next_token();
-                auto body = parse_statement();
+                auto body = parse_function_body();
 
-                return std::make_shared<ast::FunctionDeclarationStatement>(identifier_token.value, parameters, body);
-            } else if (t.value == "true" || t.value == "false") {
-                auto s = std::make_shared<ast::ExpressionStatement>(parse_expression(nullptr));
-                skip_token_if_type(lexer::TokenType::Semicolon);
-                return s;
-            } else if (t.value == "return") {
-                auto s = std::make_shared<ast::ReturnStatement>();
+                return make<ast::FunctionDeclarationStatement>(identifier, parameters, body);
+            } else if (t.keyword == lexer::Keyword::Return) {
+                auto s = make<ast::ReturnStatement>();
 
-                auto next = next_token();
+                auto &next = next_token();
                 if (next.type != lexer::TokenType::Semicolon) {
-                    s->argument = parse_expression(nullptr);
+                    s->argument = parse_expression();
                     skip_token_if_type(lexer::TokenType::Semicolon);
                 }
 
                 return s;
-            } else if (t.value == "this") {
-                auto s = std::make_shared<ast::ExpressionStatement>(parse_expression(nullptr));
+            } else if (t.keyword == lexer::Keyword::Break) {
                 skip_token_if_type(lexer::TokenType::Semicolon);
-                return s;
-            } else if (t.value == "throw") {
+                return make<ast::BreakStatement>();
+            } else if (t.keyword == lexer::Keyword::Continue) {
+                skip_token_if_type(lexer::TokenType::Semicolon);
+                return make<ast::ContinueStatement>();
+            } else if (t.keyword == lexer::Keyword::Throw) {
                 next_token();
-                auto s = std::make_shared<ast::ThrowStatement>(parse_expression(nullptr));
+                auto s = make<ast::ThrowStatement>(parse_expression());
                 skip_token_if_type(lexer::TokenType::Semicolon);
                 return s;
-            } else if (t.value == "try") {
+            } else if (t.keyword == lexer::Keyword::Try) {
                 next_token();
                 auto try_body = parse_statement();
 
-                auto catch_token = expect_next_token(lexer::TokenType::Keyword);
-                assert(catch_token.value == "catch");
+                // not inside the assert, the token is consumed in release builds too
+                [[maybe_unused]] auto &catch_token = expect_next_token(lexer::TokenType::Keyword);
+                assert(catch_token.keyword == lexer::Keyword::Catch);
 
                 expect_next_token(lexer::TokenType::LeftParen);
-                auto catch_identifier = expect_next_token(lexer::TokenType::Identifier);
+                auto catch_identifier = expect_next_token(lexer::TokenType::Identifier).atom;
                 expect_next_token(lexer::TokenType::RightParen);
 
                 next_token();
                 auto catch_body = parse_statement();
 
-                auto s = std::make_shared<ast::TryCatchStatement>(try_body, catch_identifier.value, catch_body);
-                skip_token_if_type(lexer::TokenType::Semicolon);
-                return s;
-            } else if (t.value == "typeof") {
-                auto s = std::make_shared<ast::ExpressionStatement>(parse_expression(nullptr));
+                auto s = make<ast::TryCatchStatement>(try_body, catch_identifier, catch_body);
                 skip_token_if_type(lexer::TokenType::Semicolon);
                 return s;
             }
 
-            unexpected_token();
-            assert(false);
-        }
-        case lexer::TokenType::Number:
-        case lexer::TokenType::String:
-        case lexer::TokenType::LeftBracket:
-        case lexer::TokenType::Identifier: {
-            auto s = std::make_shared<ast::ExpressionStatement>(parse_expression(nullptr));
-            skip_token_if_type(lexer::TokenType::Semicolon);
-            return s;
-        }
-        case lexer::TokenType::LeftParen: {
-            auto s = std::make_shared<ast::ExpressionStatement>(parse_expression(nullptr));
-            skip_token_if_type(lexer::TokenType::Semicolon);
-            return s;
-        }
-        case lexer::TokenType::LeftBrace: {
-            auto s = std::make_shared<ast::BlockStatement>(parse_statements());
-            skip_token_if_type(lexer::TokenType::RightBrace);
-            return s;
+            break;
         }
+        case lexer::TokenType::LeftBrace:
+            return make<ast::BlockStatement>(parse_statements());
         default:
-            unexpected_token();
-            assert(false);
+            break;
     }
+
+    auto s = make<ast::ExpressionStatement>(parse_expression());
+    skip_token_if_type(lexer::TokenType::Semicolon);
+    return s;
 }
 
-std::vector<std::shared_ptr<ast::Statement>> Parser::parse_statements() {
-    std::vector<std::shared_ptr<ast::Statement>> statements;
+std::vector<ast::Statement*> Parser::parse_statements() {
+    assert(current_token().type == lexer::TokenType::LeftBrace);
 
-    auto t = tokens[index];
+    std::vector<ast::Statement*> statements;
 
-    while (index < tokens.size() && t.type != lexer::TokenType::EndOfFile) {
+    auto t = next_token();
+
+    while (t.type != lexer::TokenType::RightBrace) {
         switch (t.type) {
-            case lexer::TokenType::LeftParen:
-            case lexer::TokenType::Keyword:
-            case lexer::TokenType::Number:
-            case lexer::TokenType::String:
-            case lexer::TokenType::LeftBracket:
-            case lexer::TokenType::Identifier:
-                statements.push_back(parse_statement());
+            case lexer::TokenType::Semicolon:
                 break;
-            case lexer::TokenType::RightBrace:
-                backup();
-                return statements;
-            case lexer::TokenType::LeftBrace:
             case lexer::TokenType::EndOfFile:
-                break;
-            default:
                 unexpected_token();
                 assert(false);
+            default:
+                statements.push_back(parse_statement());
+                break;
         }
 
         t = next_token();
@@ -662,10 +733,53 @@ std::vector<std::shared_ptr<ast::Statement>> Parser::parse_statements() {
     return statements;
 }
 
-ast::Program Parser::parse(std::vector<lexer::Token> input_tokens) {
-    tokens = input_tokens;
+ast::BlockStatement* Parser::parse_lazy_body(ast::LazyBlockStatement* body, ast::Arena &nodes) {
+    if (body->block != nullptr) {
+        return body->block;
+    }
+
+    // lex from the opening brace, the offsets of the tokens stay the same as
+    // in the original parse so errors point at the right place
+    lexer::TokenStream tokens(body->source.substr(0, body->end), body->mode, body->name, body->begin);
+    begin(tokens, nodes);
+    body->block = parse_statement()->as_block();
+    stream = nullptr;
+
+    return body->block;
+}
+
+void Parser::begin(lexer::TokenStream &input, ast::Arena &nodes) {
+    stream = &input;
+    arena = &nodes;
+    source = input.source();
+    started = false;
+}
+
+ast::Statement* Parser::parse_next_statement() {
+    // the previous statement leaves the stream on its last token
+    auto t = started ? next_token() : current_token();
+    started = true;
+
+    while (t.type == lexer::TokenType::Semicolon) {
+        t = next_token();
+    }
+
+    if (t.type == lexer::TokenType::EndOfFile || t.type == lexer::TokenType::RightBrace) {
+        return nullptr;
+    }
+
+    return parse_statement();
+}
+
+ast::Program Parser::parse(lexer::TokenStream &input) {
     ast::Program program;
-    program.body = parse_statements();
+    program.arenas.push_back(std::make_unique<ast::Arena>());
+    begin(input, *program.arenas.back());
+
+    while (auto s = parse_next_statement()) {
+        program.body.push_back(s);
+    }
+
     return program;
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <string_view>
 #include <vector>
 
 #include "ast.h"
@@ -8,36 +9,87 @@
 
 namespace parser {
 
+// binding power of operators, from loosest to tightest
+enum class Precedence {
+    None,
+    Lowest,
+    Assignment,
+    Conditional,
+    LogicalOr,
+    LogicalAnd,
+    BitwiseOr,
+    BitwiseAnd,
+    Equality,
+    Relational,
+    Additive,
+    Multiplicative,
+    Exponentiation,
+    Prefix,
+    Postfix,
+    Call,
+    Member,
+};
+
 class Parser {
-    int index = 0;
-    std::vector<lexer::Token> tokens;
+    lexer::TokenStream* stream = nullptr;
+    std::string_view source;
+    ast::Arena* arena = nullptr;
+    bool lazy_functions;
+    // open brackets while pre-parsing a function body
+    std::vector<lexer::TokenType> brackets;
 
-    void backup();
-    lexer::Token next_token();
-    lexer::Token peek_next_token();
-    lexer::Token expect_next_token(lexer::TokenType type);
+    template<typename T, typename... Args>
+    T* make(Args &&... args) {
+        return arena->make<T>(std::forward<Args>(args)...);
+    }
+
+    const lexer::Token &current_token();
+    const lexer::Token &next_token();
+    const lexer::Token &peek_next_token();
+    const lexer::Token &expect_next_token(lexer::TokenType type);
     void skip_token_if_type(lexer::TokenType type);
-    lexer::Token peek_next_token_after_type(lexer::TokenType type);
+    std::string_view text(const lexer::Token &token);
     void unexpected_token();
 
-    std::shared_ptr<ast::Expression> parse_assignment_expression(std::shared_ptr<ast::Expression> left);
-    std::shared_ptr<ast::Expression> parse_variable_declaration_expression();
-    std::shared_ptr<ast::Expression> parse_array_expression();
-    std::shared_ptr<ast::Expression> parse_object_expression();
-    std::shared_ptr<ast::Expression> parse_function_expression();
-    std::shared_ptr<ast::Expression> parse_arrow_function_expression();
-    std::shared_ptr<ast::Expression> parse_update_expression(std::shared_ptr<ast::Expression> left);
-    std::shared_ptr<ast::Expression> parse_call_expression(std::shared_ptr<ast::Expression> callee);
-    std::shared_ptr<ast::Expression> parse_new_expression();
-    std::shared_ptr<ast::Expression> parse_member_expression(std::shared_ptr<ast::Expression> left);
-    std::shared_ptr<ast::Expression> parse_binary_expression(std::shared_ptr<ast::Expression> left);
-    std::shared_ptr<ast::Expression> parse_ternary_expression(std::shared_ptr<ast::Expression> left);
-    std::shared_ptr<ast::Expression> parse_expression(std::shared_ptr<ast::Expression> left);
-    std::shared_ptr<ast::Statement> parse_statement();
-    std::vector<std::shared_ptr<ast::Statement>> parse_statements();
+    ast::Expression* parse_assignment_expression(ast::Expression* left);
+    ast::Expression* parse_variable_declaration_expression();
+    ast::Expression* parse_array_expression();
+    ast::Expression* parse_object_expression();
+    std::vector<atom::Atom> parse_parameters();
+    ast::Expression* parse_function_expression();
+    ast::Statement* parse_function_body();
+    ast::Expression* parse_arrow_function_body(std::vector<atom::Atom> parameters);
+    ast::Expression* parse_parenthesized_expression();
+    ast::Expression* parse_prefix_expression();
+    ast::Expression* parse_update_expression(ast::Expression* left);
+    void parse_arguments(std::vector<ast::Expression*> &arguments);
+    ast::Expression* parse_call_expression(ast::Expression* callee);
+    ast::Expression* parse_new_expression();
+    ast::Expression* parse_member_expression(ast::Expression* left);
+    ast::Expression* parse_binary_expression(ast::Expression* left);
+    ast::Expression* parse_ternary_expression(ast::Expression* left);
+    ast::Expression* parse_expression(Precedence min_precedence = Precedence::Lowest);
+    ast::Statement* parse_statement();
+    std::vector<ast::Statement*> parse_statements();
+
+    bool started = false;
 
 public:
-    ast::Program parse(std::vector<lexer::Token> input_tokens);
+    // with lazy_functions the bodies of functions are only pre-parsed into
+    // LazyBlockStatements, see parse_lazy_body
+    Parser(bool lazy_functions = false) : lazy_functions(lazy_functions) {}
+
+    ast::Program parse(lexer::TokenStream &input);
+
+    // statement at a time parsing of the top level of a program, returns
+    // nullptr once the end of the input is reached. nodes are allocated in
+    // `nodes`, which has to outlive them
+    void begin(lexer::TokenStream &input, ast::Arena &nodes);
+    ast::Statement* parse_next_statement();
+
+    // parses a pre-parsed function body into `nodes`, the result is kept on
+    // `body` so each body is only parsed once
+    ast::BlockStatement* parse_lazy_body(ast::LazyBlockStatement* body, ast::Arena &nodes);
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
+namespace pipeline {
+
+ast::Program parse_files(const std::vector<SourceFile> &files, lexer::Lexer::Mode mode, bool lazy_functions) {
+    std::vector<ast::Program> programs(files.size());
+    std::atomic<size_t> next_file = 0;
+
+    auto parse_remaining = [&] {
+        for (auto i = next_file++; i < files.size(); i = next_file++) {
+            lexer::TokenStream tokens(files[i].text, mode, files[i].name);
+            parser::Parser p(lazy_functions);
+            programs[i] = p.parse(tokens);
+        }
+    };
+
+    auto n_threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), files.size());
+
+    // the calling thread takes a share of the files too
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < n_threads; i++) {
+        workers.emplace_back(parse_remaining);
+    }
+
+    parse_remaining();
+
+    for (auto &w: workers) {
+        w.join();
+    }
+
+    ast::Program program;
+    for (auto &p: programs) {
+        program.body.insert(program.body.end(), p.body.begin(), p.body.end());
+        std::move(p.arenas.begin(), p.arenas.end(), std::back_inserter(program.arenas));
+    }
+
+    return program;
+}
+
+StatementPipeline::StatementPipeline(std::vector<SourceFile> files, lexer::Lexer::Mode mode, bool lazy_functions,
+                                     size_t capacity)
+        : files(std::move(files)), mode(mode), lazy_functions(lazy_functions), capacity(capacity) {
+    worker = std::thread(&StatementPipeline::produce, this);
+}
+
+StatementPipeline::~StatementPipeline() {
+    {
+        std::lock_guard lock(mutex);
+        stopped = true;
+    }
+    ready.notify_all();
+    worker.join();
+}
+
+bool StatementPipeline::wait_for_space() {
+    std::unique_lock lock(mutex);
+    ready.wait(lock, [&] { return stopped || statements.size() < capacity; });
+    return !stopped;
+}
+
+void StatementPipeline::produce() {
+    for (auto &file: files) {
+        lexer::TokenStream tokens(file.text, mode, file.name);
+        parser::Parser parser(lazy_functions);
+        parser.begin(tokens, arena);
+
+        while (true) {
+            if (!wait_for_space()) {
+                return;
+            }
+
+            auto s = parser.parse_next_statement();
+            if (s == nullptr) {
+                break;
+            }
+
+            std::lock_guard lock(mutex);
+            statements.push_back(s);
+            ready.notify_all();
+        }
+    }
+
+    std::lock_guard lock(mutex);
+    finished = true;
+    ready.notify_all();
+}
+
+ast::Statement* StatementPipeline::next() {
+    std::unique_lock lock(mutex);
+    ready.wait(lock, [&] { return finished || !statements.empty(); });
+
+    if (statements.empty()) {
+        return nullptr;
+    }
+
+    auto s = statements.front();
+    statements.pop_front();
+    ready.notify_all();
+    return s;
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "ast.h"
+#include "lexer.h"
+#include "parser.h"
+
+namespace pipeline {
+
+// a named piece of source text, the text must outlive anything parsed from it
+struct SourceFile {
+    std::string_view name;
+    std::string_view text;
+};
+
+// lexes and parses each file on its own thread and joins the results in order,
+// with lazy_functions function bodies are only pre-parsed
+ast::Program parse_files(const std::vector<SourceFile> &files,
+                         lexer::Lexer::Mode mode = lexer::Lexer::Mode::Scanner,
+                         bool lazy_functions = false);
+
+// lexes and parses top level statements on a worker thread, staying at most
+// `capacity` statements ahead of whoever is consuming them
+class StatementPipeline {
+    std::vector<SourceFile> files;
+    lexer::Lexer::Mode mode;
+    bool lazy_functions;
+    // statements can be referenced for as long as the program runs, so the
+    // nodes of every file are kept until the pipeline goes
+    ast::Arena arena;
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<ast::Statement*> statements;
+    size_t capacity;
+    bool finished = false;
+    bool stopped = false;
+
+    std::thread worker;
+
+    bool wait_for_space();
+    void produce();
+
+public:
+    StatementPipeline(std::vector<SourceFile> files, lexer::Lexer::Mode mode = lexer::Lexer::Mode::Scanner,
+                      bool lazy_functions = false, size_t capacity = 1);
+    ~StatementPipeline();
+
+    // blocks until the next statement has been parsed, nullptr at the end
+    ast::Statement* next();
+};
+
+}
@@ -0,0 +1,494 @@
+#include "resolver.h"
+
+#include <cassert>
+
+namespace resolver {
+
+Resolver::Resolver(ast::Arena &nodes)
+        : nodes(nodes), scope(nullptr), top_level(nodes.make<ast::Scope>(ast::Scope::Kind::TopLevel, nullptr)) {
+    scope = top_level;
+}
+
+// the function or top level whose frame the variables of a scope are in
+ast::Scope* Resolver::frame_of(ast::Scope* s) {
+    while (s->kind == ast::Scope::Kind::Catch || s->kind == ast::Scope::Kind::Block) {
+        s = s->parent;
+    }
+    return s;
+}
+
+// the index of the variable `name` refers to from the scope `from`, looking
+// no further than `frame`
+std::optional<uint32_t> Resolver::lookup(ast::Scope* from, ast::Scope* frame, atom::Atom name) {
+    for (auto s = from;; s = s->parent) {
+        if (auto entry = s->names.find(name); entry != s->names.end()) {
+            return entry->second;
+        }
+
+        if (s == frame) {
+            return {};
+        }
+    }
+}
+
+// the environments of the blocks from the scope `from` out to `to`, once their sizes are known
+uint16_t Resolver::blocks_between(ast::Scope* from, ast::Scope* to) {
+    uint16_t hops = 0;
+    for (auto s = from; s != to; s = s->parent) {
+        if (s->kind == ast::Scope::Kind::Block && s->environment_size > 0) {
+            hops++;
+        }
+    }
+    return hops;
+}
+
+// the scope whose environment a captured variable of `frame` is in
+ast::Scope* Resolver::environment_of(ast::Scope* frame, const ast::Variable &variable) {
+    return variable.block != nullptr ? variable.block : frame;
+}
+
+uint32_t Resolver::add(ast::Scope* s, atom::Atom name) {
+    auto frame = frame_of(s);
+    auto [entry, inserted] = s->names.try_emplace(name, frame->variables.size());
+
+    if (inserted) {
+        auto block = s->kind == ast::Scope::Kind::Block ? s : nullptr;
+
+        // the top level frame is an environment, its variables get their slots straight away
+        if (frame->kind == ast::Scope::Kind::TopLevel) {
+            auto environment = block != nullptr ? block : frame;
+            frame->variables.push_back({true, environment->environment_size++, block});
+        } else {
+            frame->variables.push_back({false, 0, block});
+        }
+    }
+
+    return entry->second;
+}
+
+// var and functions belong to the function they are in, let and const to the
+// block around them
+void Resolver::declare(atom::Atom name, ast::Binding &binding, bool lexical) {
+    auto s = scope;
+    while (s->kind == ast::Scope::Kind::Catch || (!lexical && s->kind == ast::Scope::Kind::Block)) {
+        s = s->parent;
+    }
+
+    if (s->kind == ast::Scope::Kind::TopLevel) {
+        binding = {};
+        return;
+    }
+
+    auto index = add(s, name);
+    if (frames.empty()) {
+        binding = {ast::Binding::Kind::Captured, 0, top_level->variables[index].slot};
+        return;
+    }
+
+    frames.back().references.push_back({name, &binding, s, 0, false});
+}
+
+void Resolver::reference(atom::Atom name, ast::Binding &binding) {
+    binding = {};
+
+    if (!frames.empty()) {
+        frames.back().references.push_back({name, &binding, scope, 0, false});
+        return;
+    }
+
+    // nothing is declared at the top level apart from catch parameters and the let and const of blocks
+    if (auto index = lookup(scope, top_level, name); index.has_value()) {
+        auto &variable = top_level->variables[index.value()];
+        auto hops = blocks_between(scope, environment_of(top_level, variable));
+        binding = {ast::Binding::Kind::Captured, hops, variable.slot};
+    }
+}
+
+// looks up a reference that is not to a variable of the function it was
+// pending in, starting from the scope around that function
+void Resolver::resolve_outwards(Reference ref) {
+    auto parent = frames.size() > 1 ? &frames[frames.size() - 2] : nullptr;
+
+    for (auto s = ref.from;;) {
+        auto frame = frame_of(s);
+
+        // the enclosing function is still being resolved
+        if (parent != nullptr && frame == parent->scope) {
+            parent->references.push_back(ref);
+            return;
+        }
+
+        // otherwise it was resolved before this body was parsed, the names
+        // the body uses were captured then
+        if (auto index = lookup(s, frame, ref.name); index.has_value()) {
+            auto &variable = frame->variables[index.value()];
+            assert(variable.captured);
+            auto hops = ref.hops + blocks_between(s, environment_of(frame, variable));
+            *ref.binding = {ast::Binding::Kind::Captured, static_cast<uint16_t>(hops), variable.slot};
+            return;
+        }
+
+        if (frame->kind == ast::Scope::Kind::TopLevel) {
+            *ref.binding = {};
+            return;
+        }
+
+        ref.hops += blocks_between(s, frame) + (frame->environment_size > 0 ? 1 : 0);
+        s = frame->parent;
+        ref.from = s;
+    }
+}
+
+void Resolver::finish(Frame &frame) {
+    auto function = frame.scope;
+
+    std::vector<std::pair<Reference, uint32_t>> found;
+    std::vector<Reference> missing;
+    std::optional<uint32_t> arguments;
+
+    for (auto &ref: frame.references) {
+        if (auto index = lookup(ref.from, function, ref.name); index.has_value()) {
+            if (ref.nested) {
+                function->variables[index.value()].captured = true;
+            }
+            found.push_back({ref, index.value()});
+            continue;
+        }
+
+        // every function has its own arguments, it only takes a slot when it is used
+        if (ref.name == atom::Arguments && !ref.nested) {
+            if (!arguments.has_value()) {
+                arguments = function->variables.size();
+                function->variables.push_back({});
+            }
+            found.push_back({ref, arguments.value()});
+            continue;
+        }
+
+        missing.push_back(ref);
+    }
+
+    for (auto &variable: function->variables) {
+        if (!variable.captured) {
+            variable.slot = function->frame_size++;
+        } else if (variable.block != nullptr) {
+            variable.slot = variable.block->environment_size++;
+        } else {
+            variable.slot = function->environment_size++;
+        }
+    }
+
+    if (arguments.has_value()) {
+        function->arguments_slot = function->variables[arguments.value()].slot;
+    }
+
+    for (auto &[ref, index]: found) {
+        auto &variable = function->variables[index];
+        if (!variable.captured) {
+            *ref.binding = {ast::Binding::Kind::Local, 0, variable.slot};
+            continue;
+        }
+
+        auto hops = ref.hops + blocks_between(ref.from, environment_of(function, variable));
+        *ref.binding = {ast::Binding::Kind::Captured, static_cast<uint16_t>(hops), variable.slot};
+    }
+
+    // the rest pass through the environments of the blocks they are in and
+    // the function's own if it has one
+    for (auto ref: missing) {
+        ref.hops += blocks_between(ref.from, function) + (function->environment_size > 0 ? 1 : 0);
+        ref.from = function->parent;
+        ref.nested = true;
+        resolve_outwards(ref);
+    }
+}
+
+ast::Scope* Resolver::resolve_function(const std::vector<atom::Atom> &parameters, ast::ASTNode* body) {
+    auto function = nodes.make<ast::Scope>(ast::Scope::Kind::Function, scope);
+
+    for (auto s = scope; s->kind == ast::Scope::Kind::Catch || s->kind == ast::Scope::Kind::Block; s = s->parent) {
+        s->closures = true;
+    }
+
+    // with repeated names the last one wins, they are all the same variable
+    for (auto parameter: parameters) {
+        function->parameters.push_back(add(function, parameter));
+    }
+
+    if (body->type == ast::ASTNodeType::Statement) {
+        auto s = static_cast<ast::Statement*>(body);
+        if (s->type == ast::StatementType::LazyBlock && s->as_lazy_block()->block == nullptr) {
+            // resolved when it is parsed, until then any name it uses could
+            // be a variable it captures
+            if (!frames.empty()) {
+                for (auto name: s->as_lazy_block()->names) {
+                    if (name == atom::Arguments || function->names.contains(name)) {
+                        continue;
+                    }
+
+                    unparsed.emplace_back();
+                    frames.back().references.push_back({name, &unparsed.back(), scope, 0, true});
+                }
+            }
+            return function;
+        }
+    }
+
+    auto outer = scope;
+    scope = function;
+    frames.push_back({function, {}});
+
+    // the block of a body is the function's, not one of its own
+    auto statement = body->type == ast::ASTNodeType::Statement ? static_cast<ast::Statement*>(body) : nullptr;
+    if (statement != nullptr && statement->type == ast::StatementType::Block) {
+        for (auto s: statement->as_block()->body) {
+            resolve(s);
+        }
+    } else {
+        resolve_node(body);
+    }
+
+    finish(frames.back());
+    frames.pop_back();
+    scope = outer;
+
+    return function;
+}
+
+void Resolver::resolve_top_level(ast::Statement* statement) {
+    assert(scope == top_level && frames.empty());
+    resolve(statement);
+    unparsed.clear();
+}
+
+void Resolver::resolve_body(ast::Statement* body, ast::Scope* function) {
+    assert(frames.empty());
+
+    auto outer = scope;
+    scope = function;
+    frames.push_back({function, {}});
+
+    for (auto s: body->as_block()->body) {
+        resolve(s);
+    }
+
+    finish(frames.back());
+    frames.pop_back();
+    scope = outer;
+    unparsed.clear();
+}
+
+void Resolver::resolve_node(ast::ASTNode* node) {
+    if (node->type == ast::ASTNodeType::Statement) {
+        resolve(static_cast<ast::Statement*>(node));
+    } else {
+        resolve(static_cast<ast::Expression*>(node));
+    }
+}
+
+void Resolver::resolve_block(ast::BlockStatement* block) {
+    scope = nodes.make<ast::Scope>(ast::Scope::Kind::Block, scope);
+    block->scope = scope;
+
+    // let and const are the block's from its start, at the top level they
+    // have to be known before anything in it is resolved
+    for (auto s: block->body) {
+        if (s->type != ast::StatementType::Expression ||
+            s->as_expression_statement()->expression->type != ast::ExpressionType::VariableDeclaration) {
+            continue;
+        }
+
+        auto e = s->as_expression_statement()->expression->as_variable_declaration();
+        if (e->type != ast::VariableType::Var) {
+            for (auto name: e->identifiers) {
+                add(scope, name);
+            }
+        }
+    }
+
+    for (auto s: block->body) {
+        resolve(s);
+    }
+
+    scope = scope->parent;
+}
+
+void Resolver::resolve(ast::Statement* statement) {
+    switch (statement->type) {
+        case ast::StatementType::Expression:
+            resolve(statement->as_expression_statement()->expression);
+            return;
+        case ast::StatementType::Block:
+            resolve_block(statement->as_block());
+            return;
+        case ast::StatementType::LazyBlock: {
+            // the body of a function, its variables are the function's
+            auto s = statement->as_lazy_block();
+            if (s->block != nullptr) {
+                for (auto child: s->block->body) {
+                    resolve(child);
+                }
+            }
+            return;
+        }
+        case ast::StatementType::If: {
+            auto s = statement->as_if();
+            resolve(s->test);
+            resolve(s->consequent);
+            if (s->alternative != nullptr) {
+                resolve(s->alternative);
+            }
+            return;
+        }
+        case ast::StatementType::FunctionDeclaration: {
+            auto s = statement->as_function_declaration();
+            declare(s->identifier, s->binding, false);
+            s->scope = resolve_function(s->parameters, s->body);
+            return;
+        }
+        case ast::StatementType::While:
+            resolve(statement->as_while()->test);
+            resolve(statement->as_while()->body);
+            return;
+        case ast::StatementType::For: {
+            auto s = statement->as_for();
+
+            scope = nodes.make<ast::Scope>(ast::Scope::Kind::Block, scope);
+            s->scope = scope;
+            resolve(s->init);
+            resolve(s->test);
+            resolve(s->update);
+            resolve(s->body);
+            scope = scope->parent;
+            return;
+        }
+        case ast::StatementType::Return:
+            if (statement->as_return()->argument != nullptr) {
+                resolve(statement->as_return()->argument);
+            }
+            return;
+        case ast::StatementType::Throw:
+            resolve(statement->as_throw()->argument);
+            return;
+        case ast::StatementType::Break:
+        case ast::StatementType::Continue:
+            return;
+        case ast::StatementType::TryCatch: {
+            auto s = statement->as_trycatch();
+            resolve(s->try_body);
+
+            // the catch identifier is a variable of the frame around it
+            auto clause = nodes.make<ast::Scope>(ast::Scope::Kind::Catch, scope);
+            auto index = add(clause, s->catch_identifier);
+            if (frames.empty()) {
+                auto slot = top_level->variables[index].slot;
+                s->catch_binding = {ast::Binding::Kind::Captured, blocks_between(clause, top_level), slot};
+            } else {
+                frames.back().references.push_back({s->catch_identifier, &s->catch_binding, clause, 0, false});
+            }
+
+            scope = clause;
+            resolve(s->catch_body);
+            scope = clause->parent;
+            return;
+        }
+    }
+
+    assert(false);
+}
+
+void Resolver::resolve(ast::Expression* expression) {
+    switch (expression->type) {
+        case ast::ExpressionType::VariableDeclaration: {
+            auto e = expression->as_variable_declaration();
+            for (size_t i = 0; i < e->identifiers.size(); i++) {
+                declare(e->identifiers[i], e->bindings[i], e->type != ast::VariableType::Var);
+            }
+            if (e->value != nullptr) {
+                resolve(e->value);
+            }
+            return;
+        }
+        case ast::ExpressionType::Call: {
+            auto e = expression->as_call();
+            resolve(e->callee);
+            for (auto arg: e->arguments) {
+                resolve(arg);
+            }
+            return;
+        }
+        case ast::ExpressionType::New: {
+            auto e = expression->as_new();
+            resolve(e->callee);
+            for (auto arg: e->arguments) {
+                resolve(arg);
+            }
+            return;
+        }
+        case ast::ExpressionType::Member: {
+            auto e = expression->as_member();
+            resolve(e->object);
+            // a property name is not a variable
+            if (e->is_computed) {
+                resolve(e->property);
+            }
+            return;
+        }
+        case ast::ExpressionType::Identifier: {
+            auto e = expression->as_identifier();
+            reference(e->name, e->binding);
+            return;
+        }
+        case ast::ExpressionType::NumberLiteral:
+        case ast::ExpressionType::StringLiteral:
+        case ast::ExpressionType::BooleanLiteral:
+        case ast::ExpressionType::NullLiteral:
+        case ast::ExpressionType::This:
+            return;
+        case ast::ExpressionType::Binary:
+            resolve(expression->as_binary()->left);
+            resolve(expression->as_binary()->right);
+            return;
+        case ast::ExpressionType::Assignment:
+            resolve(expression->as_assignment()->left);
+            resolve(expression->as_assignment()->right);
+            return;
+        case ast::ExpressionType::Unary:
+            resolve(expression->as_unary()->argument);
+            return;
+        case ast::ExpressionType::Update:
+            resolve(expression->as_update()->argument);
+            return;
+        case ast::ExpressionType::Ternary: {
+            auto e = expression->as_ternary();
+            resolve(e->test);
+            resolve(e->consequent);
+            resolve(e->alternative);
+            return;
+        }
+        case ast::ExpressionType::Object:
+            for (auto &p: expression->as_object()->properties) {
+                resolve(p.second);
+            }
+            return;
+        case ast::ExpressionType::Array:
+            for (auto element: expression->as_array()->elements) {
+                resolve(element);
+            }
+            return;
+        case ast::ExpressionType::Function: {
+            auto e = expression->as_function();
+            e->scope = resolve_function(e->parameters, e->body);
+            return;
+        }
+        case ast::ExpressionType::ArrowFunction: {
+            auto e = expression->as_arrow_function();
+            e->scope = resolve_function(e->parameters, e->body);
+            return;
+        }
+    }
+
+    assert(false);
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <deque>
+#include <optional>
+#include <vector>
+
+#include "ast.h"
+
+namespace resolver {
+
+// gives every variable declared in a function a slot and points each
+// identifier at the slot it refers to. a function's references are only
+// resolved once the whole of it has been seen, so declarations after their
+// first use are still found. that is also when it is known which of its
+// variables are captured by the functions created in it: those go in the
+// environment of a call, the rest on the frame stack. let and const in a
+// block are variables of their own, the captured ones go in an environment of
+// the block. names that no enclosing function declares are globals
+class Resolver {
+    struct Reference {
+        atom::Atom name;
+        ast::Binding* binding;
+        // the innermost scope to look the name up from
+        ast::Scope* from;
+        // the environments between the function the reference is in and this
+        // one, not counting those of the blocks in this one
+        uint16_t hops;
+        // whether the reference is in a function created in this one
+        bool nested;
+    };
+
+    // a function being resolved and the references that are left to look up in it
+    struct Frame {
+        ast::Scope* scope;
+        std::vector<Reference> references;
+    };
+
+    ast::Arena &nodes;
+    std::vector<Frame> frames;
+    ast::Scope* scope;
+    // what the names used by bodies that are only pre-parsed resolve to
+    std::deque<ast::Binding> unparsed;
+
+    static ast::Scope* frame_of(ast::Scope* s);
+    static std::optional<uint32_t> lookup(ast::Scope* from, ast::Scope* frame, atom::Atom name);
+    static ast::Scope* environment_of(ast::Scope* frame, const ast::Variable &variable);
+    static uint16_t blocks_between(ast::Scope* from, ast::Scope* to);
+    uint32_t add(ast::Scope* s, atom::Atom name);
+    void declare(atom::Atom name, ast::Binding &binding, bool lexical);
+    void reference(atom::Atom name, ast::Binding &binding);
+    void resolve_outwards(Reference ref);
+    void finish(Frame &frame);
+    ast::Scope* resolve_function(const std::vector<atom::Atom> &parameters, ast::ASTNode* body);
+    void resolve_node(ast::ASTNode* node);
+    void resolve_block(ast::BlockStatement* block);
+    void resolve(ast::Statement* statement);
+    void resolve(ast::Expression* expression);
+
+public:
+    // scopes are allocated in `nodes`, which has to outlive the ast
+    explicit Resolver(ast::Arena &nodes);
+
+    // catch clauses at the top level add their variables here, the top level
+    // environment can grow as statements are resolved
+    ast::Scope* const top_level;
+
+    void resolve_top_level(ast::Statement* statement);
+    // resolves the body of a function that was parsed after the code around
+    // it was resolved
+    void resolve_body(ast::Statement* body, ast::Scope* function);
+};
+
+}
@@ -0,0 +1,99 @@
+#include "source.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+namespace source {
+
+namespace {
+
+bool read_all(int fd, std::string &out) {
+    char chunk[64 * 1024];
+
+    while (true) {
+        auto n = read(fd, chunk, sizeof(chunk));
+        if (n == 0) {
+            return true;
+        }
+
+        if (n < 0) {
+            return false;
+        }
+
+        out.append(chunk, n);
+    }
+}
+
+}
+
+std::optional<SourceBuffer> SourceBuffer::open(const std::string &path) {
+    SourceBuffer source;
+
+    if (path == "-") {
+        if (!read_all(STDIN_FILENO, source.buffer)) {
+            return {};
+        }
+
+        return source;
+    }
+
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return {};
+    }
+
+    struct stat info{};
+    auto is_regular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+
+    // empty files can't be mapped, pipes and devices have to be read
+    if (is_regular && info.st_size > 0) {
+        auto address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            madvise(address, info.st_size, MADV_SEQUENTIAL);
+            source.mapped = static_cast<const char*>(address);
+            source.mapped_length = info.st_size;
+            close(fd);
+            return source;
+        }
+    }
+
+    auto ok = read_all(fd, source.buffer);
+    close(fd);
+
+    if (!ok) {
+        return {};
+    }
+
+    return source;
+}
+
+SourceBuffer::SourceBuffer(SourceBuffer &&other) noexcept
+        : mapped(std::exchange(other.mapped, nullptr)),
+          mapped_length(std::exchange(other.mapped_length, 0)),
+          buffer(std::move(other.buffer)) {}
+
+SourceBuffer &SourceBuffer::operator=(SourceBuffer &&other) noexcept {
+    if (this != &other) {
+        if (mapped != nullptr) {
+            munmap(const_cast<char*>(mapped), mapped_length);
+        }
+
+        mapped = std::exchange(other.mapped, nullptr);
+        mapped_length = std::exchange(other.mapped_length, 0);
+        buffer = std::move(other.buffer);
+    }
+
+    return *this;
+}
+
+SourceBuffer::~SourceBuffer() {
+    if (mapped != nullptr) {
+        munmap(const_cast<char*>(mapped), mapped_length);
+    }
+}
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace source {
+
+// the text of a source file. regular files are memory mapped read only and
+// lexed straight from the mapping, stdin and pipes are read into a buffer.
+// the text is not null terminated
+class SourceBuffer {
+    const char* mapped = nullptr;
+    size_t mapped_length = 0;
+    std::string buffer;
+
+    SourceBuffer() = default;
+
+public:
+    // "-" reads stdin
+    static std::optional<SourceBuffer> open(const std::string &path);
+
+    SourceBuffer(SourceBuffer &&other) noexcept;
+    SourceBuffer &operator=(SourceBuffer &&other) noexcept;
+    SourceBuffer(const SourceBuffer &) = delete;
+    SourceBuffer &operator=(const SourceBuffer &) = delete;
+    ~SourceBuffer();
+
+    std::string_view text() const {
+        if (mapped != nullptr) {
+            return {mapped, mapped_length};
+        }
+
+        return buffer;
+    }
+};
+
+}
@@ -0,0 +1,47 @@
+#include "catch.hpp"
+
+#include "../atom.h"
+
+#include <thread>
+#include <vector>
+
+TEST_CASE("Atom table maps atoms back to their names", "[atom]") {
+    REQUIRE(atom::to_string(atom::Proto) == "__proto__");
+    REQUIRE(atom::to_string(atom::Array) == "Array");
+
+    // enough names to fill several chunks of the table
+    std::vector<atom::Atom> atoms;
+    for (auto i = 0; i < 5000; i++) {
+        atoms.push_back(atom::intern("name" + std::to_string(i)));
+    }
+
+    for (auto i = 0; i < 5000; i++) {
+        REQUIRE(atom::to_string(atoms[i]) == "name" + std::to_string(i));
+        REQUIRE(atom::intern("name" + std::to_string(i)) == atoms[i]);
+    }
+}
+
+TEST_CASE("Atom table looks names up while other threads intern", "[atom]") {
+    auto interning = [](int thread) {
+        for (auto i = 0; i < 2000; i++) {
+            auto name = "thread" + std::to_string(thread) + "_" + std::to_string(i);
+            if (atom::to_string(atom::intern(name)) != name) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::vector<std::thread> threads;
+    bool ok[4];
+    for (auto i = 0; i < 4; i++) {
+        threads.emplace_back([&, i] { ok[i] = interning(i); });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+
+    for (auto i = 0; i < 4; i++) {
+        REQUIRE(ok[i]);
+    }
+}
@@ -0,0 +1,104 @@
+#include "catch.hpp"
+
+#include "../bytecode.h"
+#include "../lexer.h"
+#include "../parser.h"
+#include "../resolver.h"
+
+TEST_CASE("Bytecode compiler puts locals in registers", "[bytecode]") {
+    std::string source = R"(
+        x = a + 1;
+        function f(a, b) {
+            var c = a + b;
+            return c;
+        }
+        function g() {
+            return later;
+            var later = 1;
+        }
+        function h(list) {
+            for (var i = 0; i < 10; i++) {
+                list.push(i);
+            }
+        }
+    )";
+
+    lexer::TokenStream tokens(source);
+    parser::Parser p;
+    auto ast = p.parse(tokens);
+
+    ast::Arena nodes;
+    resolver::Resolver r(nodes);
+    for (auto s: ast.body) {
+        r.resolve_top_level(s);
+    }
+
+    bytecode::Program program;
+
+    auto opcodes = [&](uint32_t chunk) {
+        std::vector<bytecode::Opcode> result;
+        for (auto &i: program.chunks[chunk].code) {
+            result.push_back(i.opcode);
+        }
+        return result;
+    };
+    auto compile_function = [&](size_t i) {
+        auto s = ast.body[i]->as_function_declaration();
+        return program.compile_function(program.add_function(s->identifier, s->parameters, s->scope, s->body),
+                                        s->body);
+    };
+
+    SECTION("globals are read and written by name") {
+        auto chunk = program.compile(ast.body[0]);
+
+        std::vector<bytecode::Opcode> expected = {
+                bytecode::Opcode::LoadNumber,
+                bytecode::Opcode::GetVariable,
+                bytecode::Opcode::Binary,
+                bytecode::Opcode::SetVariable,
+                bytecode::Opcode::ReturnUndefined,
+        };
+        REQUIRE(opcodes(chunk) == expected);
+
+        auto &binary = program.chunks[chunk].code[2];
+        REQUIRE(binary.op == ast::Operator::Plus);
+        REQUIRE(binary.b == program.chunks[chunk].code[1].a);
+        REQUIRE(binary.c == program.chunks[chunk].code[0].a);
+    }
+
+    SECTION("operations on locals use their registers") {
+        auto chunk = compile_function(1);
+
+        std::vector<bytecode::Opcode> expected = {
+                bytecode::Opcode::Binary,
+                bytecode::Opcode::Return,
+                bytecode::Opcode::ReturnUndefined,
+        };
+        REQUIRE(opcodes(chunk) == expected);
+
+        auto &code = program.chunks[chunk].code;
+        REQUIRE(code[0].a == 2);
+        REQUIRE(code[0].b == 0);
+        REQUIRE(code[0].c == 1);
+        REQUIRE(code[1].a == 2);
+        REQUIRE(program.chunks[chunk].registers == 3);
+    }
+
+    SECTION("locals read before they are set are checked") {
+        auto chunk = compile_function(2);
+        REQUIRE(opcodes(chunk)[0] == bytecode::Opcode::CheckDefined);
+    }
+
+    SECTION("loops and method calls use superinstructions") {
+        auto code = opcodes(compile_function(3));
+        auto has = [&](bytecode::Opcode opcode) {
+            return std::find(code.begin(), code.end(), opcode) != code.end();
+        };
+
+        REQUIRE(has(bytecode::Opcode::CompareJump));
+        REQUIRE(has(bytecode::Opcode::UpdateLocal));
+        REQUIRE(has(bytecode::Opcode::CallNamed));
+        REQUIRE(!has(bytecode::Opcode::Binary));
+        REQUIRE(!has(bytecode::Opcode::JumpIfFalse));
+    }
+}
@@ -0,0 +1,60 @@
+#include "catch.hpp"
+
+#include "../flat.h"
+#include "../lexer.h"
+#include "../parser.h"
+
+TEST_CASE("Flat encoding stores nodes in pre-order with subtree sizes", "[flat]") {
+    SECTION("binary expression") {
+        auto source = R"(a + b * 2;)";
+        lexer::TokenStream tokens(source);
+        parser::Parser p;
+        auto ast = p.parse(tokens);
+
+        flat::Program program;
+        auto root = program.encode(ast.body[0]);
+
+        std::vector<flat::Kind> expected = {
+                flat::Kind::ExpressionStatement,
+                flat::Kind::BinaryExpression,
+                flat::Kind::IdentifierExpression,
+                flat::Kind::BinaryExpression,
+                flat::Kind::IdentifierExpression,
+                flat::Kind::NumberLiteralExpression,
+        };
+
+        REQUIRE(root == 0);
+        REQUIRE(program.nodes.size() == expected.size());
+        for (auto i = 0; i < expected.size(); i++) {
+            REQUIRE(program[i].kind == expected[i]);
+        }
+
+        REQUIRE(program[0].size == 6);
+        REQUIRE(program[1].op == ast::Operator::Plus);
+        REQUIRE(program.child(1, 1) == 3);
+        REQUIRE(program[3].op == ast::Operator::Multiply);
+        REQUIRE(program.numbers[program[5].a] == 2);
+        REQUIRE(static_cast<atom::Atom>(program[2].a) == atom::intern("a"));
+    }
+
+    SECTION("statements are appended after each other") {
+        auto source = R"(if (x) { y; } else { z; } function f(a, b) { return a; })";
+        lexer::TokenStream tokens(source);
+        parser::Parser p;
+        auto ast = p.parse(tokens);
+
+        flat::Program program;
+        auto if_root = program.encode(ast.body[0]);
+        auto function_root = program.encode(ast.body[1]);
+
+        REQUIRE(program[if_root].kind == flat::Kind::IfStatement);
+        REQUIRE(program[if_root].flags & flat::HasOptional);
+        REQUIRE(program[program.child(if_root, 2)].kind == flat::Kind::BlockStatement);
+        REQUIRE(program.next_sibling(if_root) == function_root);
+
+        auto &function = program[function_root];
+        REQUIRE(function.kind == flat::Kind::FunctionDeclarationStatement);
+        REQUIRE(program.functions[function.b].parameters.size() == 2);
+        REQUIRE(program.next_sibling(function_root) == program.nodes.size());
+    }
+}
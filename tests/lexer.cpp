@@ -3,15 +3,24 @@
 #include "../lexer.h"
 #include "../parser.h"
 
-void lexer_test_case(std::string source, std::vector<lexer::Token> expected_tokens) {
-    lexer::Lexer l;
-    auto tokens = l.get_tokens(source);
+struct ExpectedToken {
+    lexer::TokenType type;
+    std::string value;
+};
+
+void lexer_test_case(std::string source, std::vector<ExpectedToken> expected_tokens) {
+    expected_tokens.push_back({lexer::TokenType::EndOfFile, ""});
+
+    for (auto mode: {lexer::Lexer::Mode::Scanner, lexer::Lexer::Mode::Regex}) {
+        lexer::Lexer l(mode);
+        auto tokens = l.get_tokens(source);
 
-    REQUIRE(tokens.size() == expected_tokens.size());
+        REQUIRE(tokens.size() == expected_tokens.size());
 
-    for (auto i = 0; i < tokens.size(); i++) {
-        REQUIRE(tokens[i].type == expected_tokens[i].type);
-        REQUIRE(tokens[i].value == expected_tokens[i].value);
+        for (auto i = 0; i < tokens.size(); i++) {
+            REQUIRE(tokens[i].type == expected_tokens[i].type);
+            REQUIRE(tokens[i].text(source) == expected_tokens[i].value);
+        }
     }
 }
 
@@ -19,7 +28,7 @@ TEST_CASE("Lexer returns expected tokens", "[lexer][ast]") {
     SECTION("string") {
         auto source = R"("test")";
 
-        std::vector<lexer::Token> expected = {
+        std::vector<ExpectedToken> expected = {
                 {lexer::TokenType::String, "test"}
         };
 
@@ -29,7 +38,7 @@ TEST_CASE("Lexer returns expected tokens", "[lexer][ast]") {
     SECTION("multiple strings") {
         auto source = R"("test","test2","test3")";
 
-        std::vector<lexer::Token> expected = {
+        std::vector<ExpectedToken> expected = {
                 {lexer::TokenType::String, "test"},
                 {lexer::TokenType::Comma, ","},
                 {lexer::TokenType::String, "test2"},
@@ -43,7 +52,7 @@ TEST_CASE("Lexer returns expected tokens", "[lexer][ast]") {
     SECTION("arrow function") {
         auto source = R"(() => 1;)";
 
-        std::vector<lexer::Token> expected = {
+        std::vector<ExpectedToken> expected = {
                 {lexer::TokenType::LeftParen,  "("},
                 {lexer::TokenType::RightParen, ")"},
                 {lexer::TokenType::Arrow,      "=>"},
@@ -57,7 +66,7 @@ TEST_CASE("Lexer returns expected tokens", "[lexer][ast]") {
     SECTION("arrow function with body") {
         auto source = R"(() => { return 1; })";
 
-        std::vector<lexer::Token> expected = {
+        std::vector<ExpectedToken> expected = {
                 {lexer::TokenType::LeftParen,  "("},
                 {lexer::TokenType::RightParen, ")"},
                 {lexer::TokenType::Arrow,      "=>"},
@@ -74,7 +83,7 @@ TEST_CASE("Lexer returns expected tokens", "[lexer][ast]") {
     SECTION("arrow function with parameters") {
         auto source = R"((a,b) => 1;)";
 
-        std::vector<lexer::Token> expected = {
+        std::vector<ExpectedToken> expected = {
                 {lexer::TokenType::LeftParen,  "("},
                 {lexer::TokenType::Identifier, "a"},
                 {lexer::TokenType::Comma,      ","},
@@ -88,4 +97,174 @@ TEST_CASE("Lexer returns expected tokens", "[lexer][ast]") {
         lexer_test_case(source, expected);
     }
 
+    SECTION("comments and whitespace") {
+        auto source = "// comment\n\tx /* multi\nline */ = 1;\n";
+
+        std::vector<ExpectedToken> expected = {
+                {lexer::TokenType::Identifier, "x"},
+                {lexer::TokenType::Equals,     "="},
+                {lexer::TokenType::Number,     "1"},
+                {lexer::TokenType::Semicolon,  ";"},
+        };
+
+        lexer_test_case(source, expected);
+    }
+
+    SECTION("numbers") {
+        auto source = R"(1 1.5 0xff 2e10 3.5E-2)";
+
+        std::vector<ExpectedToken> expected = {
+                {lexer::TokenType::Number, "1"},
+                {lexer::TokenType::Number, "1.5"},
+                {lexer::TokenType::Number, "0xff"},
+                {lexer::TokenType::Number, "2e10"},
+                {lexer::TokenType::Number, "3.5E-2"},
+        };
+
+        lexer::Lexer l;
+        auto tokens = l.get_tokens(source);
+        expected.push_back({lexer::TokenType::EndOfFile, ""});
+
+        REQUIRE(tokens.size() == expected.size());
+        for (auto i = 0; i < tokens.size(); i++) {
+            REQUIRE(tokens[i].type == expected[i].type);
+            REQUIRE(tokens[i].text(source) == expected[i].value);
+        }
+    }
+}
+
+TEST_CASE("Scanner and regex lexer produce the same tokens", "[lexer]") {
+    auto source = R"(
+        function f(a, b) {
+            var x = a + b - 1 * 2 / 3 % 4 ** 5;
+            x += 1; x -= 1; x *= 2; x /= 2; x++; x--;
+            if (a == b && a === b || a != b && a !== b) { return !x; }
+            const y = a < b ? a <= b : a > b >= a;
+            let z = [1, 2, { key: 'value', other: "str" }];
+            z.length;
+            return (c) => c | 1 & 2;
+        }
+        // trailing comment
+        typeof null; new Thing(0x1F);
+    )";
+
+    lexer::Lexer scanner(lexer::Lexer::Mode::Scanner);
+    lexer::Lexer regex(lexer::Lexer::Mode::Regex);
+
+    auto scanned = scanner.get_tokens(source);
+    auto matched = regex.get_tokens(source);
+
+    REQUIRE(scanned.size() == matched.size());
+
+    for (auto i = 0; i < scanned.size(); i++) {
+        REQUIRE(scanned[i].type == matched[i].type);
+        REQUIRE(scanned[i].offset == matched[i].offset);
+        REQUIRE(scanned[i].length == matched[i].length);
+    }
+}
+
+TEST_CASE("Lexer decodes number literals", "[lexer]") {
+    auto check = [](lexer::Lexer::Mode mode, std::string source, std::vector<double> expected) {
+        lexer::Lexer l(mode);
+        auto tokens = l.get_tokens(source);
+
+        REQUIRE(tokens.size() == expected.size() + 1);
+        for (auto i = 0; i < expected.size(); i++) {
+            REQUIRE(tokens[i].type == lexer::TokenType::Number);
+            REQUIRE(l.number(tokens[i]) == expected[i]);
+        }
+    };
+
+    for (auto mode: {lexer::Lexer::Mode::Scanner, lexer::Lexer::Mode::Regex}) {
+        check(mode, "0 123 1.5 0.125 0x1f 0XFF 9007199254740993",
+              {0, 123, 1.5, 0.125, 31, 255, 9007199254740992.0});
+    }
+
+    check(lexer::Lexer::Mode::Scanner, "1e3 2.5E-2 7e+1 0x10000000000000000",
+          {1000, 0.025, 70, 18446744073709551616.0});
+
+    SECTION("out of range") {
+        check(lexer::Lexer::Mode::Scanner, "1e400 1e-400", {HUGE_VAL, 0});
+    }
+}
+
+TEST_CASE("Lexer classifies keywords", "[lexer]") {
+    auto source = R"(function functions if iff instanceof typeof var variable)";
+
+    std::vector<std::pair<lexer::TokenType, lexer::Keyword>> expected = {
+            {lexer::TokenType::Keyword,    lexer::Keyword::Function},
+            {lexer::TokenType::Identifier, lexer::Keyword::None},
+            {lexer::TokenType::Keyword,    lexer::Keyword::If},
+            {lexer::TokenType::Identifier, lexer::Keyword::None},
+            {lexer::TokenType::Keyword,    lexer::Keyword::Instanceof},
+            {lexer::TokenType::Keyword,    lexer::Keyword::Typeof},
+            {lexer::TokenType::Keyword,    lexer::Keyword::Var},
+            {lexer::TokenType::Identifier, lexer::Keyword::None},
+            {lexer::TokenType::EndOfFile,  lexer::Keyword::None},
+    };
+
+    for (auto mode: {lexer::Lexer::Mode::Scanner, lexer::Lexer::Mode::Regex}) {
+        lexer::Lexer l(mode);
+        auto tokens = l.get_tokens(source);
+
+        REQUIRE(tokens.size() == expected.size());
+
+        for (auto i = 0; i < tokens.size(); i++) {
+            REQUIRE(tokens[i].type == expected[i].first);
+            REQUIRE(tokens[i].keyword == expected[i].second);
+        }
+    }
+}
+
+TEST_CASE("Token stream yields the same tokens as get_tokens", "[lexer]") {
+    auto source = R"(const f = (a, b) => { return a + b; }; f(1, 2);)";
+
+    lexer::Lexer l;
+    auto tokens = l.get_tokens(source);
+
+    lexer::TokenStream stream(source);
+
+    SECTION("advance") {
+        for (auto &expected: tokens) {
+            auto &t = stream.peek();
+            REQUIRE(t.type == expected.type);
+            REQUIRE(t.offset == expected.offset);
+            stream.advance();
+        }
+
+        REQUIRE(stream.peek().type == lexer::TokenType::EndOfFile);
+        REQUIRE(stream.advance().type == lexer::TokenType::EndOfFile);
+    }
+
+    SECTION("peek ahead and backup") {
+        REQUIRE(stream.peek(5).offset == tokens[5].offset);
+        REQUIRE(stream.peek(100).type == lexer::TokenType::EndOfFile);
+
+        stream.advance();
+        stream.advance();
+        stream.backup();
+        REQUIRE(stream.peek().offset == tokens[1].offset);
+        REQUIRE(stream.peek(1).offset == tokens[2].offset);
+    }
+}
+
+TEST_CASE("Token stream keeps the numbers of its window", "[lexer]") {
+    std::string source;
+    for (auto i = 0; i < 10000; i++) {
+        source += std::to_string(i) + " ";
+    }
+
+    lexer::TokenStream stream(source);
+
+    for (auto i = 0; i < 9998; i++) {
+        REQUIRE(stream.number(stream.peek(2)) == i + 2);
+        REQUIRE(stream.number(stream.peek()) == i);
+        stream.advance();
+    }
+
+    stream.advance();
+    stream.advance();
+
+    stream.backup();
+    REQUIRE(stream.number(stream.peek()) == 9999);
 }
@@ -0,0 +1,62 @@
+#include "catch.hpp"
+
+#include <limits>
+
+#include "../object.h"
+
+using interpreter::object::ObjectManager;
+using interpreter::object::Value;
+
+TEST_CASE("Values store numbers, booleans, null and undefined inline", "[object]") {
+    SECTION("numbers keep their double") {
+        for (auto number: {0.0, -0.0, 1.5, -2.0, 1e308, std::numeric_limits<double>::infinity(),
+                           -std::numeric_limits<double>::infinity()}) {
+            auto value = Value::number(number);
+            REQUIRE(value.type() == Value::Type::Number);
+            REQUIRE(value.number() == number);
+        }
+    }
+
+    SECTION("any nan is a number") {
+        auto value = Value::number(-std::numeric_limits<double>::quiet_NaN());
+        REQUIRE(value.type() == Value::Type::Number);
+        REQUIRE(std::isnan(value.number()));
+    }
+
+    SECTION("other values are told apart") {
+        REQUIRE(Value::boolean(true).type() == Value::Type::Boolean);
+        REQUIRE(Value::boolean(true).boolean());
+        REQUIRE(!Value::boolean(false).boolean());
+        REQUIRE(Value::null().type() == Value::Type::Null);
+        REQUIRE(Value::undefined().is_undefined());
+        REQUIRE(Value() == nullptr);
+        REQUIRE(Value::number(0) != nullptr);
+    }
+}
+
+TEST_CASE("Strings, objects, arrays and functions live on the heap", "[object]") {
+    ObjectManager om;
+    om.global_object().set_property(atom::Object, om.new_object());
+    om.global_object().set_property(atom::String, om.new_object());
+    om.global_object().set_property(atom::Number, om.new_object());
+
+    auto string = om.new_string("text");
+    REQUIRE(string.is_heap());
+    REQUIRE(string.string() == "text");
+
+    auto object = om.new_object();
+    object.set_property(atom::intern("x"), om.new_number(2));
+    REQUIRE(object.get_property(om, atom::intern("x"))->number() == 2);
+
+    SECTION("primitives have the properties of their prototype") {
+        auto prototype = om.get_variable(atom::Number).value();
+        prototype.set_property(atom::intern("y"), om.new_boolean(true));
+
+        auto number = om.new_number(1);
+        REQUIRE(!number.is_heap());
+        REQUIRE(number.get_property(om, atom::intern("y"))->boolean());
+
+        number.set_property(atom::intern("z"), om.new_null());
+        REQUIRE(!number.get_property(om, atom::intern("z")).has_value());
+    }
+}
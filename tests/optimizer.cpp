@@ -0,0 +1,306 @@
+#include "catch.hpp"
+
+#include "../lexer.h"
+#include "../optimizer.h"
+#include "../parser.h"
+
+TEST_CASE("ConstantFolder folds literals and propagates consts", "[optimizer]") {
+    std::string source = R"(
+        var day = 24 * 60 * 60 * 1000;
+        var name = "prefix" + "_" + 2;
+        var numbers = 1 + 2 > 2 ? 1 == 1 : false;
+        const limit = 10;
+        var twice = limit * 2;
+        function f(limit) { return limit; }
+        function g() { return limit + 1; }
+        var x = y + 1 * 2;
+        var unfolded = "a" == "b";
+        const reset = 1;
+        function clear() { reset = 0; }
+        var cleared = reset;
+    )";
+
+    lexer::TokenStream tokens(source);
+    parser::Parser p;
+    auto ast = p.parse(tokens);
+
+    ast::Arena nodes;
+    optimizer::ConstantFolder folder(nodes);
+    folder.see_program(ast.body);
+    for (auto s: ast.body) {
+        folder.fold_top_level(s);
+    }
+
+    auto value = [&](size_t i) {
+        return ast.body[i]->as_expression_statement()->expression->as_variable_declaration()->value;
+    };
+    auto returned = [&](size_t i) {
+        auto body = ast.body[i]->as_function_declaration()->body->as_block()->body;
+        return body[0]->as_return()->argument;
+    };
+
+    SECTION("arithmetic on numbers") {
+        REQUIRE(value(0)->type == ast::ExpressionType::NumberLiteral);
+        REQUIRE(value(0)->as_number_literal()->value == 86400000);
+    }
+
+    SECTION("concatenation prints numbers as the interpreter does") {
+        REQUIRE(value(1)->type == ast::ExpressionType::StringLiteral);
+        REQUIRE(value(1)->as_string_literal()->value == "prefix_2.0");
+    }
+
+    SECTION("comparisons and conditionals") {
+        REQUIRE(value(2)->type == ast::ExpressionType::BooleanLiteral);
+        REQUIRE(value(2)->as_boolean_literal()->value == true);
+    }
+
+    SECTION("consts with literal values") {
+        REQUIRE(value(4)->type == ast::ExpressionType::NumberLiteral);
+        REQUIRE(value(4)->as_number_literal()->value == 20);
+        REQUIRE(returned(6)->type == ast::ExpressionType::NumberLiteral);
+        REQUIRE(returned(6)->as_number_literal()->value == 11);
+    }
+
+    SECTION("names declared in a function hide consts") {
+        REQUIRE(returned(5)->type == ast::ExpressionType::Identifier);
+    }
+
+    SECTION("only what is known is folded") {
+        auto sum = value(7)->as_binary();
+        REQUIRE(sum->left->type == ast::ExpressionType::Identifier);
+        REQUIRE(sum->right->type == ast::ExpressionType::NumberLiteral);
+
+        // strings compare by truthiness in the interpreter, that is left to it
+        REQUIRE(value(8)->type == ast::ExpressionType::Binary);
+    }
+
+    SECTION("consts that are assigned to anywhere are not propagated") {
+        REQUIRE(value(11)->type == ast::ExpressionType::Identifier);
+    }
+}
+
+TEST_CASE("ConstantFolder folds bodies parsed later with the consts around them", "[optimizer]") {
+    std::string source = R"(
+        const base = "v";
+        function f(a) { return base + a + (1 + 1); }
+        const count = 0;
+        function g() { count += 1; return count; }
+    )";
+
+    lexer::TokenStream tokens(source);
+    parser::Parser p(true);
+    auto ast = p.parse(tokens);
+
+    ast::Arena nodes;
+    optimizer::ConstantFolder folder(nodes);
+    folder.see_program(ast.body);
+    for (auto s: ast.body) {
+        folder.fold_top_level(s);
+    }
+
+    auto lazy = ast.body[1]->as_function_declaration()->body->as_lazy_block();
+    p.parse_lazy_body(lazy, nodes);
+    folder.fold_body(lazy);
+
+    // (base + a) + 2.0, the left side is not all literals
+    auto sum = lazy->block->body[0]->as_return()->argument->as_binary();
+    auto left = sum->left->as_binary();
+    REQUIRE(left->left->type == ast::ExpressionType::StringLiteral);
+    REQUIRE(left->left->as_string_literal()->value == "v");
+    REQUIRE(sum->right->type == ast::ExpressionType::NumberLiteral);
+
+    SECTION("assignments in bodies that are only pre-parsed are seen") {
+        auto g = ast.body[3]->as_function_declaration()->body->as_lazy_block();
+        p.parse_lazy_body(g, nodes);
+        folder.fold_body(g);
+
+        REQUIRE(g->assigned == std::vector<atom::Atom>{atom::intern("count")});
+        REQUIRE(g->block->body[1]->as_return()->argument->type == ast::ExpressionType::Identifier);
+    }
+}
+
+TEST_CASE("ConstantFolder keeps consts from functions that can run before them", "[optimizer]") {
+    std::string source = R"(
+        const early = 1;
+        function f() { return early + late; }
+        try { f(); } catch (e) {}
+        const late = 2;
+        var after = late;
+        function g() { return late; }
+    )";
+
+    for (auto lazy: {false, true}) {
+        lexer::TokenStream tokens(source);
+        parser::Parser p(lazy);
+        auto ast = p.parse(tokens);
+
+        ast::Arena nodes;
+        optimizer::ConstantFolder folder(nodes);
+        folder.see_program(ast.body);
+        for (auto s: ast.body) {
+            folder.fold_top_level(s);
+        }
+
+        auto returned = [&](size_t i) {
+            auto body = ast.body[i]->as_function_declaration()->body;
+            if (body->type == ast::StatementType::LazyBlock) {
+                p.parse_lazy_body(body->as_lazy_block(), nodes);
+                folder.fold_body(body->as_lazy_block());
+                body = body->as_lazy_block()->block;
+            }
+            return body->as_block()->body[0]->as_return()->argument;
+        };
+
+        // the code after the const runs after it
+        auto after = ast.body[4]->as_expression_statement()->expression->as_variable_declaration()->value;
+        REQUIRE(after->type == ast::ExpressionType::NumberLiteral);
+
+        auto sum = returned(1)->as_binary();
+        REQUIRE(sum->left->type == ast::ExpressionType::NumberLiteral);
+        REQUIRE(sum->right->type == ast::ExpressionType::Identifier);
+        REQUIRE(returned(5)->type == ast::ExpressionType::Identifier);
+    }
+}
+
+TEST_CASE("TreeShaker removes code that cannot run", "[optimizer]") {
+    std::string source = R"(
+        function used() { return helper(); }
+        function helper() { return 1; }
+        function unused() { return helper(); }
+        function method() { return 2; }
+        if (false) { unused(); } else { used(); }
+        function f() { return 1; used(); used(); }
+        this.method();
+        function computed() { return 3; }
+        const key = "computed";
+        this[key]();
+    )";
+
+    lexer::TokenStream tokens(source);
+    parser::Parser p;
+    auto ast = p.parse(tokens);
+
+    ast::Arena nodes;
+    optimizer::TreeShaker shaker(nodes);
+    for (auto &s: ast.body) {
+        shaker.eliminate_dead_code(s);
+    }
+    shaker.shake(ast.body);
+
+    SECTION("branches and statements after a return") {
+        REQUIRE(shaker.report.branches == 1);
+        REQUIRE(shaker.report.statements == 2);
+        REQUIRE(ast.body[3]->type == ast::StatementType::Block);
+    }
+
+    SECTION("functions nothing that is kept refers to") {
+        REQUIRE(shaker.report.functions.size() == 2);
+        REQUIRE(atom::to_string(shaker.report.functions[0]) == "unused");
+        REQUIRE(atom::to_string(shaker.report.functions[1]) == "f");
+        REQUIRE(ast.body.size() == 8);
+    }
+
+    SECTION("functions a string names can be reached through a computed key") {
+        REQUIRE(ast.body[5]->as_function_declaration()->identifier == atom::intern("computed"));
+    }
+}
+
+TEST_CASE("ConstantFolder inlines small const functions", "[optimizer]") {
+    std::string source = R"(
+        const add = (a, b) => a + b;
+        const square = function(x) { return x * x; };
+        const fact = (n) => n < 2 ? 1 : n * fact(n - 1);
+        const counter = () => count++;
+        const before = (a, f) => a + f();
+        var sum = add(1, 2);
+        var area = square(side);
+        var rest = fact(3);
+        var counted = counter();
+        var nested = add(add(1, 2), 3);
+        var computed = add(side + 1, 2);
+        function f(add) { return add(1, 2); }
+        function g(n) { return add(n, 1) + add(side, 1); }
+        const first = (a, b) => a;
+        const swap = (a, b) => b - a;
+        var unused = first(1, missing);
+        var swapped = swap(1, 2);
+        function h(n, k) { return before(n, k) + before(1, k); }
+        const replaced = (a) => a;
+        replaced = add;
+        var called = replaced(1);
+        var declared = 2;
+        const pick = (c, a) => c ? a : 0;
+        var global = add(declared, 1);
+        var picked = pick(1, declared);
+    )";
+
+    lexer::TokenStream tokens(source);
+    parser::Parser p;
+    auto ast = p.parse(tokens);
+
+    ast::Arena nodes;
+    optimizer::ConstantFolder folder(nodes);
+    folder.inline_budget = 16;
+    folder.see_program(ast.body);
+    for (auto s: ast.body) {
+        folder.fold_top_level(s);
+    }
+
+    auto value = [&](size_t i) {
+        return ast.body[i]->as_expression_statement()->expression->as_variable_declaration()->value;
+    };
+
+    SECTION("bodies are substituted and folded with the arguments") {
+        REQUIRE(value(5)->type == ast::ExpressionType::NumberLiteral);
+        REQUIRE(value(5)->as_number_literal()->value == 3);
+    }
+
+    SECTION("each parameter has to be used once") {
+        // x * x would read side twice
+        REQUIRE(value(6)->type == ast::ExpressionType::Call);
+        // missing would not be read, so not throw
+        REQUIRE(value(15)->type == ast::ExpressionType::Call);
+        // literals can be read in any order
+        REQUIRE(value(16)->type == ast::ExpressionType::NumberLiteral);
+        REQUIRE(value(16)->as_number_literal()->value == 1);
+    }
+
+    SECTION("variables are arguments if they are local and read before a call") {
+        // the right side of a + f() runs first
+        auto body = ast.body[12]->as_function_declaration()->body->as_block()->body;
+        auto sum = body[0]->as_return()->argument->as_binary();
+        REQUIRE(sum->left->type == ast::ExpressionType::Binary);
+        REQUIRE(sum->left->as_binary()->left->as_identifier()->name == atom::intern("n"));
+        REQUIRE(sum->right->type == ast::ExpressionType::Call);
+
+        body = ast.body[17]->as_function_declaration()->body->as_block()->body;
+        sum = body[0]->as_return()->argument->as_binary();
+        REQUIRE(sum->left->type == ast::ExpressionType::Call);
+        REQUIRE(sum->right->type == ast::ExpressionType::Binary);
+    }
+
+    SECTION("globals are arguments once declared, if they are always read") {
+        REQUIRE(value(23)->type == ast::ExpressionType::Binary);
+        REQUIRE(value(24)->type == ast::ExpressionType::Call);
+    }
+
+    SECTION("const functions that are assigned to are called") {
+        REQUIRE(value(20)->type == ast::ExpressionType::Call);
+    }
+
+    SECTION("functions that are recursive or use other variables are called") {
+        REQUIRE(value(7)->type == ast::ExpressionType::Call);
+        REQUIRE(value(8)->type == ast::ExpressionType::Call);
+    }
+
+    SECTION("arguments are literals or local variables") {
+        REQUIRE(value(9)->type == ast::ExpressionType::NumberLiteral);
+        REQUIRE(value(9)->as_number_literal()->value == 6);
+        REQUIRE(value(10)->type == ast::ExpressionType::Call);
+    }
+
+    SECTION("names declared in a function hide const functions") {
+        auto body = ast.body[11]->as_function_declaration()->body->as_block()->body;
+        REQUIRE(body[0]->as_return()->argument->type == ast::ExpressionType::Call);
+    }
+}
@@ -4,8 +4,7 @@
 #include "../parser.h"
 
 ast::Program get_ast(std::string source) {
-    lexer::Lexer l;
-    auto tokens = l.get_tokens(source);
+    lexer::TokenStream tokens(source);
     parser::Parser p;
     return p.parse(tokens);
 }
@@ -82,12 +81,12 @@ TEST_CASE("Parser parses literals", "[parser][ast]") {
         auto expression = expression_statement->expression->as_object();
         REQUIRE(expression->properties.size() == 2);
 
-        auto x = expression->properties.find("x");
+        auto x = expression->properties.find(atom::intern("x"));
         REQUIRE(x != expression->properties.end());
         auto xn = x->second->as_number_literal();
         REQUIRE(xn->value == 123);
 
-        auto y = expression->properties.find("y");
+        auto y = expression->properties.find(atom::intern("y"));
         REQUIRE(y != expression->properties.end());
         auto yn = y->second->as_number_literal();
         REQUIRE(yn->value == 234);
@@ -112,7 +111,7 @@ TEST_CASE("Parser parses expressions", "[parser][ast]") {
         REQUIRE(ast.body.size() == 1);
         auto expression_statement = ast.body[0]->as_expression_statement();
         auto expression = expression_statement->expression->as_identifier();
-        REQUIRE(expression->name == "test");
+        REQUIRE(expression->name == atom::intern("test"));
     }
 
     SECTION("identifiers in parentheses") {
@@ -122,7 +121,7 @@ TEST_CASE("Parser parses expressions", "[parser][ast]") {
         REQUIRE(ast.body.size() == 1);
         auto expression_statement = ast.body[0]->as_expression_statement();
         auto expression = expression_statement->expression->as_identifier();
-        REQUIRE(expression->name == "test");
+        REQUIRE(expression->name == atom::intern("test"));
     }
 
     SECTION("binary expression with operands in parentheses") {
@@ -167,7 +166,7 @@ TEST_CASE("Parser parses expressions", "[parser][ast]") {
         auto expression_statement = ast.body[0]->as_expression_statement();
         auto expression = expression_statement->expression->as_variable_declaration();
         REQUIRE(expression->identifiers.size() == 1);
-        REQUIRE(expression->identifiers[0] == "x");
+        REQUIRE(expression->identifiers[0] == atom::intern("x"));
         REQUIRE(expression->type == ast::VariableType::Var);
         auto value = expression->value->as_number_literal();
         REQUIRE(value->value == 1);
@@ -181,7 +180,7 @@ TEST_CASE("Parser parses expressions", "[parser][ast]") {
         auto expression_statement = ast.body[0]->as_expression_statement();
         auto expression = expression_statement->expression->as_variable_declaration();
         REQUIRE(expression->identifiers.size() == 1);
-        REQUIRE(expression->identifiers[0] == "x");
+        REQUIRE(expression->identifiers[0] == atom::intern("x"));
         REQUIRE(expression->type == ast::VariableType::Var);
         REQUIRE(expression->value == nullptr);
     }
@@ -194,9 +193,9 @@ TEST_CASE("Parser parses expressions", "[parser][ast]") {
         auto expression_statement = ast.body[0]->as_expression_statement();
         auto expression = expression_statement->expression->as_variable_declaration();
         REQUIRE(expression->identifiers.size() == 3);
-        REQUIRE(expression->identifiers[0] == "x");
-        REQUIRE(expression->identifiers[1] == "y");
-        REQUIRE(expression->identifiers[2] == "z");
+        REQUIRE(expression->identifiers[0] == atom::intern("x"));
+        REQUIRE(expression->identifiers[1] == atom::intern("y"));
+        REQUIRE(expression->identifiers[2] == atom::intern("z"));
         REQUIRE(expression->type == ast::VariableType::Var);
         auto value = expression->value->as_number_literal();
         REQUIRE(value->value == 1);
@@ -212,8 +211,8 @@ TEST_CASE("Parser parses expressions", "[parser][ast]") {
 
         REQUIRE(expression->parameters.size() == 0);
 
-        auto body = expression->body->as_expression_statement();
-        auto value = body->expression->as_number_literal();
+        auto body = static_cast<ast::Expression*>(expression->body);
+        auto value = body->as_number_literal();
         REQUIRE(value->value == 123);
     }
 
@@ -227,7 +226,7 @@ TEST_CASE("Parser parses expressions", "[parser][ast]") {
 
         REQUIRE(expression->parameters.size() == 0);
 
-        auto block = expression->body->as_block();
+        auto block = static_cast<ast::Statement*>(expression->body)->as_block();
         REQUIRE(block->body.size() == 1);
         auto return_statement = block->body.at(0)->as_return();
         auto return_value = return_statement->argument->as_number_literal();
@@ -243,11 +242,11 @@ TEST_CASE("Parser parses expressions", "[parser][ast]") {
         auto expression = expression_statement->expression->as_arrow_function();
 
         REQUIRE(expression->parameters.size() == 2);
-        REQUIRE(expression->parameters.at(0) == "a");
-        REQUIRE(expression->parameters.at(1) == "b");
+        REQUIRE(expression->parameters.at(0) == atom::intern("a"));
+        REQUIRE(expression->parameters.at(1) == atom::intern("b"));
 
-        auto body = expression->body->as_expression_statement();
-        auto value = body->expression->as_number_literal();
+        auto body = static_cast<ast::Expression*>(expression->body);
+        auto value = body->as_number_literal();
         REQUIRE(value->value == 123);
     }
 
@@ -260,10 +259,10 @@ TEST_CASE("Parser parses expressions", "[parser][ast]") {
         auto expression = expression_statement->expression->as_arrow_function();
 
         REQUIRE(expression->parameters.size() == 1);
-        REQUIRE(expression->parameters.at(0) == "a");
+        REQUIRE(expression->parameters.at(0) == atom::intern("a"));
 
-        auto body = expression->body->as_expression_statement();
-        auto value = body->expression->as_number_literal();
+        auto body = static_cast<ast::Expression*>(expression->body);
+        auto value = body->as_number_literal();
         REQUIRE(value->value == 123);
     }
 
@@ -276,15 +275,15 @@ TEST_CASE("Parser parses expressions", "[parser][ast]") {
         auto declaration = expression_statement->expression->as_variable_declaration();
 
         REQUIRE(declaration->identifiers.size() == 1);
-        REQUIRE(declaration->identifiers.at(0) == "x");
+        REQUIRE(declaration->identifiers.at(0) == atom::intern("x"));
 
         auto func = declaration->value->as_arrow_function();
 
         REQUIRE(func->parameters.size() == 1);
-        REQUIRE(func->parameters.at(0) == "a");
+        REQUIRE(func->parameters.at(0) == atom::intern("a"));
 
-        auto body = func->body->as_expression_statement();
-        auto value = body->expression->as_number_literal();
+        auto body = static_cast<ast::Expression*>(func->body);
+        auto value = body->as_number_literal();
         REQUIRE(value->value == 123);
     }
 }
@@ -302,7 +301,7 @@ TEST_CASE("Parser parses statements", "[parser][ast]") {
         REQUIRE(ast.body.size() == 1);
         auto s = ast.body[0]->as_while();
         auto test = s->test->as_identifier();
-        REQUIRE(test->name == "test");
+        REQUIRE(test->name == atom::intern("test"));
         REQUIRE(s->body->type == ast::StatementType::Block);
     }
 
@@ -354,4 +353,159 @@ TEST_CASE("Parser parses statements", "[parser][ast]") {
         REQUIRE(s->consequent->type == ast::StatementType::Block);
         REQUIRE(s->alternative->type == ast::StatementType::Block);
     }
-}
\ No newline at end of file
+
+    SECTION("break and continue statements") {
+        auto source = R"(
+            while(test) {
+                break;
+                continue
+            }
+        )";
+        auto ast = get_ast(source);
+
+        auto body = ast.body[0]->as_while()->body->as_block()->body;
+        REQUIRE(body.size() == 2);
+        REQUIRE(body[0]->type == ast::StatementType::Break);
+        REQUIRE(body[1]->type == ast::StatementType::Continue);
+    }
+}
+TEST_CASE("Parser respects operator precedence", "[parser][ast]") {
+    auto expression_of = [](ast::Program &ast) {
+        REQUIRE(ast.body.size() == 1);
+        return ast.body[0]->as_expression_statement()->expression;
+    };
+
+    SECTION("multiplication binds tighter than addition") {
+        auto ast = get_ast("1 * 2 + 3;");
+        auto e = expression_of(ast)->as_binary();
+        REQUIRE(e->op == ast::Operator::Plus);
+        REQUIRE(e->left->as_binary()->op == ast::Operator::Multiply);
+        REQUIRE(e->right->as_number_literal()->value == 3);
+    }
+
+    SECTION("binary operators are left associative") {
+        auto ast = get_ast("a - b - c;");
+        auto e = expression_of(ast)->as_binary();
+        REQUIRE(e->op == ast::Operator::Minus);
+        REQUIRE(e->left->as_binary()->op == ast::Operator::Minus);
+        REQUIRE(e->right->as_identifier()->name == atom::intern("c"));
+    }
+
+    SECTION("exponentiation is right associative") {
+        auto ast = get_ast("2 ** 3 ** 2;");
+        auto e = expression_of(ast)->as_binary();
+        REQUIRE(e->left->as_number_literal()->value == 2);
+        REQUIRE(e->right->as_binary()->op == ast::Operator::Exponentiation);
+    }
+
+    SECTION("assignment is right associative") {
+        auto ast = get_ast("a = b = 1 + 2;");
+        auto e = expression_of(ast)->as_assignment();
+        auto right = e->right->as_assignment();
+        REQUIRE(right->right->as_binary()->op == ast::Operator::Plus);
+    }
+
+    SECTION("conditional binds looser than equality") {
+        auto ast = get_ast("a == b ? 1 : 2;");
+        auto e = expression_of(ast)->as_ternary();
+        REQUIRE(e->test->as_binary()->op == ast::Operator::EqualTo);
+    }
+
+    SECTION("unary operators bind tighter than binary operators") {
+        auto ast = get_ast("!a == b;");
+        auto e = expression_of(ast)->as_binary();
+        REQUIRE(e->left->as_unary()->op == ast::Operator::Not);
+    }
+
+    SECTION("prefix and postfix updates") {
+        auto ast = get_ast("++a + b++;");
+        auto e = expression_of(ast)->as_binary();
+        REQUIRE(e->left->as_update()->is_prefix);
+        REQUIRE_FALSE(e->right->as_update()->is_prefix);
+    }
+
+    SECTION("arrow functions as call arguments") {
+        auto ast = get_ast("f((a, b) => a + b, x => x, () => 1);");
+        auto e = expression_of(ast)->as_call();
+        REQUIRE(e->arguments.size() == 3);
+        REQUIRE(e->arguments[0]->as_arrow_function()->parameters.size() == 2);
+        REQUIRE(e->arguments[1]->as_arrow_function()->parameters.size() == 1);
+        REQUIRE(e->arguments[2]->as_arrow_function()->parameters.empty());
+    }
+
+    SECTION("new with a member expression callee") {
+        auto ast = get_ast("new a.B(1).c;");
+        auto e = expression_of(ast)->as_member();
+        auto n = e->object->as_new();
+        REQUIRE(n->callee->type == ast::ExpressionType::Member);
+        REQUIRE(n->arguments.size() == 1);
+    }
+}
+
+TEST_CASE("Parser yields top level statements one at a time", "[parser]") {
+    auto source = R"(
+        function f(a) { return a; }
+        let x = f(1);
+        if (x) { x = 2; }
+    )";
+
+    lexer::TokenStream tokens(source);
+    ast::Arena nodes;
+    parser::Parser p;
+    p.begin(tokens, nodes);
+
+    REQUIRE(p.parse_next_statement()->type == ast::StatementType::FunctionDeclaration);
+    REQUIRE(p.parse_next_statement()->type == ast::StatementType::Expression);
+    REQUIRE(p.parse_next_statement()->type == ast::StatementType::If);
+    REQUIRE(p.parse_next_statement() == nullptr);
+    REQUIRE(p.parse_next_statement() == nullptr);
+}
+
+TEST_CASE("Parser pre-parses function bodies when lazy", "[parser][ast]") {
+    std::string source = R"(
+        function f(a) { let g = () => { return [a, (1)]; }; a++; return g; }
+        var h = function () { return this["key"].value; };
+    )";
+
+    lexer::TokenStream tokens(source);
+    parser::Parser p(true);
+    auto ast = p.parse(tokens);
+
+    REQUIRE(ast.body.size() == 2);
+
+    auto f = ast.body[0]->as_function_declaration();
+    REQUIRE(f->parameters.size() == 1);
+    auto lazy = f->body->as_lazy_block();
+    REQUIRE(source.substr(lazy->begin, lazy->end - lazy->begin) ==
+            "{ let g = () => { return [a, (1)]; }; a++; return g; }");
+
+    auto h = ast.body[1]->as_expression_statement()->expression->as_variable_declaration();
+    REQUIRE(h->value->as_function()->body->type == ast::StatementType::LazyBlock);
+
+    SECTION("variables next to an assignment or update are recorded, not declarations") {
+        REQUIRE(lazy->assigned == std::vector<atom::Atom>{atom::intern("a")});
+    }
+
+    SECTION("names after a dot and strings are recorded as properties") {
+        auto properties = h->value->as_function()->body->as_lazy_block()->properties;
+        REQUIRE(properties.size() == 2);
+        REQUIRE(properties[0] == atom::intern("key"));
+        REQUIRE(properties[1] == atom::intern("value"));
+    }
+
+    SECTION("bodies are parsed on demand, once") {
+        ast::Arena nodes;
+        parser::Parser body_parser(true);
+        auto block = body_parser.parse_lazy_body(lazy, nodes);
+
+        REQUIRE(block->body.size() == 3);
+        REQUIRE(block->body[2]->type == ast::StatementType::Return);
+        REQUIRE(body_parser.parse_lazy_body(lazy, nodes) == block);
+
+        // functions nested in a lazy body are pre-parsed too
+        auto g = block->body[0]->as_expression_statement()->expression->as_variable_declaration();
+        auto inner = static_cast<ast::Statement*>(g->value->as_arrow_function()->body);
+        REQUIRE(inner->type == ast::StatementType::LazyBlock);
+        REQUIRE(body_parser.parse_lazy_body(inner->as_lazy_block(), nodes)->body.size() == 1);
+    }
+}
@@ -0,0 +1,223 @@
+#include "catch.hpp"
+
+#include "../lexer.h"
+#include "../parser.h"
+#include "../resolver.h"
+
+TEST_CASE("Resolver turns identifiers into slots", "[resolver]") {
+    std::string source = R"(
+        var g = 1;
+        function f(a, b) {
+            let c = a;
+            const inner = () => c + g + later;
+            var later = 2;
+            try {} catch (e) { e; }
+            return inner;
+        }
+    )";
+
+    lexer::TokenStream tokens(source);
+    parser::Parser p;
+    auto ast = p.parse(tokens);
+
+    ast::Arena nodes;
+    resolver::Resolver r(nodes);
+    for (auto s: ast.body) {
+        r.resolve_top_level(s);
+    }
+
+    auto local = [](const ast::Binding &binding, uint32_t slot) {
+        return binding.kind == ast::Binding::Kind::Local && binding.hops == 0 && binding.slot == slot;
+    };
+    auto captured = [](const ast::Binding &binding, uint16_t hops, uint32_t slot) {
+        return binding.kind == ast::Binding::Kind::Captured && binding.hops == hops && binding.slot == slot;
+    };
+
+    SECTION("top level declarations are globals") {
+        auto g = ast.body[0]->as_expression_statement()->expression->as_variable_declaration();
+        REQUIRE(g->bindings[0].kind == ast::Binding::Kind::Global);
+        REQUIRE(ast.body[1]->as_function_declaration()->binding.kind == ast::Binding::Kind::Global);
+    }
+
+    auto f = ast.body[1]->as_function_declaration();
+    auto body = f->body->as_block()->body;
+
+    SECTION("only captured variables are in the environment") {
+        // a, b, inner and the catch parameter on the stack, c and later in the environment
+        REQUIRE(f->scope->frame_size == 4);
+        REQUIRE(f->scope->environment_size == 2);
+
+        auto c = body[0]->as_expression_statement()->expression->as_variable_declaration();
+        REQUIRE(captured(c->bindings[0], 0, 0));
+        REQUIRE(local(c->value->as_identifier()->binding, 0));
+    }
+
+    SECTION("closures count the environments they cross") {
+        auto inner = body[1]->as_expression_statement()->expression->as_variable_declaration();
+        auto arrow = inner->value->as_arrow_function();
+        REQUIRE(arrow->scope->frame_size == 0);
+        REQUIRE(arrow->scope->environment_size == 0);
+
+        auto sum = arrow->body->type == ast::ASTNodeType::Expression
+                   ? static_cast<ast::Expression*>(arrow->body)->as_binary() : nullptr;
+        REQUIRE(sum != nullptr);
+
+        // (c + g) + later
+        auto left = sum->left->as_binary();
+        // the arrow has no environment, the one it was created in is the innermost
+        REQUIRE(captured(left->left->as_identifier()->binding, 0, 0));
+        REQUIRE(left->right->as_identifier()->binding.kind == ast::Binding::Kind::Global);
+        // declared after the closure
+        REQUIRE(captured(sum->right->as_identifier()->binding, 0, 1));
+    }
+
+    SECTION("catch parameters get a slot of their own") {
+        auto catch_clause = body[3]->as_trycatch();
+        REQUIRE(local(catch_clause->catch_binding, 3));
+
+        auto e = catch_clause->catch_body->as_block()->body[0]->as_expression_statement()->expression;
+        REQUIRE(local(e->as_identifier()->binding, 3));
+    }
+}
+
+TEST_CASE("Resolver only counts functions with environments", "[resolver]") {
+    std::string source = R"(
+        function outer(x) {
+            function keeps() {
+                var y = 2;
+                return () => x + y;
+            }
+            function passes() {
+                return () => x;
+            }
+        }
+    )";
+
+    lexer::TokenStream tokens(source);
+    parser::Parser p;
+    auto ast = p.parse(tokens);
+
+    ast::Arena nodes;
+    resolver::Resolver r(nodes);
+    r.resolve_top_level(ast.body[0]);
+
+    auto body = ast.body[0]->as_function_declaration()->body->as_block()->body;
+    auto arrow = [](ast::Statement* function) {
+        auto ret = function->as_function_declaration()->body->as_block()->body.back()->as_return();
+        return static_cast<ast::Expression*>(ret->argument->as_arrow_function()->body);
+    };
+
+    auto sum = arrow(body[0])->as_binary();
+    REQUIRE(sum->left->as_identifier()->binding.hops == 1);
+    REQUIRE(sum->right->as_identifier()->binding.hops == 0);
+
+    REQUIRE(arrow(body[1])->as_identifier()->binding.hops == 0);
+}
+
+TEST_CASE("Resolver captures what a pre-parsed body might use", "[resolver]") {
+    std::string source = R"(
+        function f(a, b) {
+            var c;
+            return function () { return a.b + c; };
+        }
+    )";
+
+    lexer::TokenStream tokens(source);
+    parser::Parser p(true);
+    auto ast = p.parse(tokens);
+    auto f = ast.body[0]->as_function_declaration();
+
+    ast::Arena nodes;
+    auto body = p.parse_lazy_body(f->body->as_lazy_block(), nodes);
+
+    resolver::Resolver r(nodes);
+    r.resolve_top_level(ast.body[0]);
+    r.resolve_body(body, f->scope);
+
+    // b is only a property name
+    REQUIRE(f->scope->variables[0].captured);
+    REQUIRE(!f->scope->variables[1].captured);
+    REQUIRE(f->scope->variables[2].captured);
+}
+
+TEST_CASE("Resolver gives the let and const of blocks variables of their own", "[resolver]") {
+    std::string source = R"(
+        function f() {
+            let x = 1;
+            { let x = 2; var y = x; }
+            return x + y;
+        }
+    )";
+
+    lexer::TokenStream tokens(source);
+    parser::Parser p;
+    auto ast = p.parse(tokens);
+
+    ast::Arena nodes;
+    resolver::Resolver r(nodes);
+    r.resolve_top_level(ast.body[0]);
+
+    auto body = ast.body[0]->as_function_declaration()->body->as_block()->body;
+    auto declaration = [](ast::Statement* s) {
+        return s->as_expression_statement()->expression->as_variable_declaration();
+    };
+
+    auto x = declaration(body[0])->bindings[0];
+    auto block = body[1]->as_block()->body;
+    auto shadow = declaration(block[0])->bindings[0];
+    REQUIRE(shadow.kind == ast::Binding::Kind::Local);
+    REQUIRE(shadow.slot != x.slot);
+    REQUIRE(declaration(block[1])->value->as_identifier()->binding.slot == shadow.slot);
+
+    // var still belongs to the function
+    auto sum = body[2]->as_return()->argument->as_binary();
+    REQUIRE(sum->left->as_identifier()->binding.slot == x.slot);
+    REQUIRE(sum->right->as_identifier()->binding.slot == declaration(block[1])->bindings[0].slot);
+}
+
+TEST_CASE("Resolver puts captured let and const in environments of their blocks", "[resolver]") {
+    std::string source = R"(
+        function f(g) {
+            let x = 1;
+            for (let i = 0; i < 3; i++) { let j = i; g(() => j + x); }
+            return x;
+        }
+    )";
+
+    lexer::TokenStream tokens(source);
+    parser::Parser p;
+    auto ast = p.parse(tokens);
+
+    ast::Arena nodes;
+    resolver::Resolver r(nodes);
+    r.resolve_top_level(ast.body[0]);
+
+    auto f = ast.body[0]->as_function_declaration();
+    auto body = f->body->as_block()->body;
+
+    auto x = body[0]->as_expression_statement()->expression->as_variable_declaration()->bindings[0];
+
+    // x is captured by the arrow, j is in an environment of the loop's body
+    REQUIRE(x.kind == ast::Binding::Kind::Captured);
+    REQUIRE(f->scope->environment_size == 1);
+
+    auto loop = body[1]->as_for();
+    REQUIRE(loop->scope->environment_size == 0);
+    auto block = loop->body->as_block();
+    REQUIRE(block->scope->environment_size == 1);
+    REQUIRE(block->scope->closures);
+
+    auto call = block->body[1]->as_expression_statement()->expression->as_call();
+    auto sum = static_cast<ast::Expression*>(call->arguments[0]->as_arrow_function()->body)->as_binary();
+    auto j = sum->left->as_identifier()->binding;
+    REQUIRE(j.kind == ast::Binding::Kind::Captured);
+    REQUIRE(j.hops == 0);
+    REQUIRE(j.slot == 0);
+    // past the block's environment to the function's
+    REQUIRE(sum->right->as_identifier()->binding.hops == 1);
+
+    auto ret = body[2]->as_return()->argument->as_identifier()->binding;
+    REQUIRE(ret.kind == ast::Binding::Kind::Captured);
+    REQUIRE(ret.hops == 0);
+    REQUIRE(ret.slot == x.slot);
+}